@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <cstdlib>
+
+#include "app-frame.hpp"
+
+namespace drachtio {
+
+  void AppFrame::appendVarint(std::string& s, uint64_t val) {
+    while (val >= 0x80) {
+      s.push_back(static_cast<char>((val & 0x7f) | 0x80)) ;
+      val >>= 7 ;
+    }
+    s.push_back(static_cast<char>(val)) ;
+  }
+
+  AppFrame::ParseResult_t AppFrame::readVarint(const char* data, size_t len, uint64_t& val, size_t& consumed) {
+    val = 0 ;
+    for (size_t i = 0; i < len && i < 10; i++) {
+      unsigned char c = static_cast<unsigned char>(data[i]) ;
+      val |= static_cast<uint64_t>(c & 0x7f) << (7 * i) ;
+      if (!(c & 0x80)) {
+        consumed = i + 1 ;
+        return PARSE_OK ;
+      }
+    }
+    return len >= 10 ? PARSE_ERROR : PARSE_INCOMPLETE ;
+  }
+
+  void AppFrame::add(Field_t field, const std::string& value) {
+    m_payload.push_back(static_cast<char>(field)) ;
+    appendVarint(m_payload, value.length()) ;
+    m_payload.append(value) ;
+  }
+
+  void AppFrame::add(Field_t field, uint64_t value) {
+    std::string v ;
+    appendVarint(v, value) ;
+    add(field, v) ;
+  }
+
+  void AppFrame::addMeta(const SipMsgData_t& meta) {
+    add(FIELD_SOURCE, meta.getSource()) ;
+    add(FIELD_BYTES, static_cast<uint64_t>(::strtoul(meta.getBytes().c_str(), NULL, 10))) ;
+    add(FIELD_PROTOCOL, meta.getProtocol()) ;
+    add(FIELD_ADDRESS, meta.getAddress()) ;
+    add(FIELD_PORT, static_cast<uint64_t>(::strtoul(meta.getPort().c_str(), NULL, 10))) ;
+    add(FIELD_TIME, meta.getTime()) ;
+  }
+
+  void AppFrame::encode(std::string& frame) const {
+    frame.clear() ;
+    frame.reserve(m_payload.length() + 13) ;
+    frame.push_back(static_cast<char>(MAGIC)) ;
+    frame.push_back(static_cast<char>(VERSION)) ;
+    frame.push_back(static_cast<char>(m_type)) ;
+    appendVarint(frame, m_payload.length()) ;
+    frame.append(m_payload) ;
+  }
+
+  AppFrame::ParseResult_t AppFrame::parse(const char* data, size_t len, AppFrame& frame, size_t& frameLen) {
+    if (len < 3) return PARSE_INCOMPLETE ;
+    if (static_cast<unsigned char>(data[0]) != MAGIC || static_cast<unsigned char>(data[1]) != VERSION) return PARSE_ERROR ;
+
+    unsigned char type = static_cast<unsigned char>(data[2]) ;
+    if (type < MSG_SIP || type > MSG_REQUEST) return PARSE_ERROR ;
+
+    uint64_t payloadLen ;
+    size_t n ;
+    ParseResult_t rc = readVarint(data + 3, len - 3, payloadLen, n) ;
+    if (PARSE_OK != rc) return rc ;
+    if (payloadLen > MAX_PAYLOAD_LEN) return PARSE_ERROR ;
+
+    size_t headerLen = 3 + n ;
+    if (len - headerLen < payloadLen) return PARSE_INCOMPLETE ;
+
+    frame.m_type = static_cast<MsgType_t>(type) ;
+    frame.m_fields.clear() ;
+
+    const char* p = data + headerLen ;
+    const char* end = p + payloadLen ;
+    while (p < end) {
+      Field_t field = static_cast<Field_t>(static_cast<unsigned char>(*p++)) ;
+      uint64_t fieldLen ;
+      if (PARSE_OK != readVarint(p, end - p, fieldLen, n)) return PARSE_ERROR ;
+      p += n ;
+      if (static_cast<uint64_t>(end - p) < fieldLen) return PARSE_ERROR ;
+      frame.m_fields.push_back(std::make_pair(field, std::string(p, fieldLen))) ;
+      p += fieldLen ;
+    }
+
+    frameLen = headerLen + payloadLen ;
+    return PARSE_OK ;
+  }
+
+  bool AppFrame::get(Field_t field, std::string& value) const {
+    for (const auto& f : m_fields) {
+      if (f.first == field) {
+        value = f.second ;
+        return true ;
+      }
+    }
+    return false ;
+  }
+
+  bool AppFrame::get(Field_t field, uint64_t& value) const {
+    std::string v ;
+    size_t n ;
+    return get(field, v) && PARSE_OK == readVarint(v.data(), v.length(), value, n) ;
+  }
+
+  void AppFrame::getAll(Field_t field, std::vector<std::string>& values) const {
+    for (const auto& f : m_fields) {
+      if (f.first == field) values.push_back(f.second) ;
+    }
+  }
+}
@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __APP_FRAME_HPP__
+#define __APP_FRAME_HPP__
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include "drachtio.h"
+
+namespace drachtio {
+
+  /**
+   * Binary framing for the app protocol, used on a connection once the app asks for it at authenticate.
+   *
+   * A frame is a fixed header -- magic (0xDB), version, message type -- followed by the payload length
+   * as a varint and then the payload: a sequence of fields, each a one byte tag, a varint length and
+   * the value.  Numeric fields hold a varint; all others hold the raw bytes, so nothing is escaped or
+   * tokenized on either side.
+   */
+  class AppFrame {
+  public:
+    static constexpr unsigned char MAGIC = 0xDB ;
+    static constexpr unsigned char VERSION = 1 ;
+    static constexpr size_t MAX_PAYLOAD_LEN = 16 * 1024 * 1024 ;
+
+    enum MsgType_t {
+      MSG_SIP = 1,          // sip request or response delivered to the app
+      MSG_RESPONSE = 2,     // response to a request from the app
+      MSG_CDR = 3,          // cdr event
+      MSG_REQUEST = 4       // request from the app
+    } ;
+
+    enum Field_t {
+      FIELD_MSG_ID = 1,
+      FIELD_IN_REPLY_TO,    // msg id of the request being answered
+      FIELD_STATUS,         // OK or NO
+      FIELD_DATA,           // additional response data
+      FIELD_TOKEN,          // repeated: request type and arguments, in order
+      FIELD_SOURCE,
+      FIELD_BYTES,          // varint
+      FIELD_PROTOCOL,
+      FIELD_ADDRESS,
+      FIELD_PORT,           // varint
+      FIELD_TIME,
+      FIELD_TRANSACTION_ID,
+      FIELD_DIALOG_ID,
+      FIELD_DEST_ADDRESS,
+      FIELD_DEST_PORT,      // varint
+      FIELD_CDR_META,
+      FIELD_SIP             // raw sip message
+    } ;
+
+    enum ParseResult_t {
+      PARSE_OK,
+      PARSE_INCOMPLETE,
+      PARSE_ERROR
+    } ;
+
+    AppFrame() : m_type(MSG_REQUEST) {}
+    AppFrame(MsgType_t type) : m_type(type) {}
+
+    MsgType_t getType(void) const { return m_type; }
+
+    void add(Field_t field, const std::string& value) ;
+    void add(Field_t field, uint64_t value) ;
+    void addMeta(const SipMsgData_t& meta) ;
+
+    void encode(std::string& frame) const ;
+
+    // parses one frame from the start of data; on PARSE_OK frameLen is the number of bytes consumed
+    static ParseResult_t parse(const char* data, size_t len, AppFrame& frame, size_t& frameLen) ;
+
+    bool get(Field_t field, std::string& value) const ;
+    bool get(Field_t field, uint64_t& value) const ;
+    void getAll(Field_t field, std::vector<std::string>& values) const ;
+
+    static void appendVarint(std::string& s, uint64_t val) ;
+    static ParseResult_t readVarint(const char* data, size_t len, uint64_t& val, size_t& consumed) ;
+
+  private:
+    MsgType_t m_type ;
+
+    // encoding writes fields straight into the payload; decoding collects them
+    std::string m_payload ;
+    std::vector< std::pair<Field_t, std::string> > m_fields ;
+  } ;
+}
+
+#endif
@@ -20,6 +20,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include <boost/variant.hpp>
+#include <boost/algorithm/string.hpp>
 #include <regex>
 
 #include  "hiredis.h"
@@ -150,6 +151,73 @@ namespace drachtio {
       }
     }
 
+    static redisContext* ConnectRedis(
+      const std::string& redisPassword,
+      const boost::asio::ip::tcp::endpoint& endpoint
+      ) {
+      struct timeval timeout = { 5, 0 };
+      auto ip = endpoint.address().to_string();
+      auto port = endpoint.port();
+      redisContext* c = redisConnectWithTimeout(ip.c_str(), port, timeout);
+      if (c == NULL || c->err) {
+        if (c) {
+          DR_LOG(log_error) << "Blacklist::ConnectRedis - Error: connecting to " << endpoint.address() << " " << c->errstr ;
+          redisFree(c);
+        } else {
+          DR_LOG(log_error) << "Blacklist::ConnectRedis - Error: connecting to " << endpoint.address() << " can't allocate redis context" ;
+        }
+        return NULL;
+      }
+      redisEnableKeepAlive(c);
+
+      if (redisPassword.length()) {
+        redisReply *reply = (redisReply *) redisCommand(c, "AUTH %s", redisPassword.c_str());
+        if (reply == NULL || reply->type == REDIS_REPLY_ERROR) {
+          DR_LOG(log_error) << "Blacklist::ConnectRedis - AUTH failed to " << endpoint.address() << " :" << 
+            (reply ? reply->str : c->errstr) ;
+          if (reply) freeReplyObject(reply);
+          redisFree(c);
+          return NULL;
+        }
+        freeReplyObject(reply);
+      }
+      return c;
+    }
+
+    /* load a set incrementally using SSCAN so we don't ask redis for the whole thing in one reply */
+    static bool ScanRedis(
+      redisContext* c,
+      const std::string& redisKey,
+      std::unordered_set<std::string>& ips
+      ) {
+      std::string cursor = "0";
+      do {
+        redisReply *reply = (redisReply *) redisCommand(c, "SSCAN %s %s COUNT 1000", redisKey.c_str(), cursor.c_str());
+        if (reply == NULL) {
+          DR_LOG(log_error) << "Blacklist::ScanRedis - Error: " << c->errstr ;
+          return false;
+        }
+        if (reply->type != REDIS_REPLY_ARRAY || reply->elements != 2 || 
+          reply->element[0]->type != REDIS_REPLY_STRING || reply->element[1]->type != REDIS_REPLY_ARRAY) {
+          if (reply->type == REDIS_REPLY_ERROR) {
+            DR_LOG(log_error) << "Blacklist::ScanRedis - Redis error " << reply->str ;
+          }
+          else {
+            DR_LOG(log_error) << "Blacklist::ScanRedis - unexpected reply type " << reply->type ;
+          }
+          freeReplyObject(reply);
+          return false;
+        }
+        cursor = reply->element[0]->str;
+        redisReply* members = reply->element[1];
+        for (int i = 0; i < members->elements; i++) {
+          if (members->element[i]->type == REDIS_REPLY_STRING) ips.insert(members->element[i]->str);
+        }
+        freeReplyObject(reply);
+      } while (cursor != "0");
+      return true;
+    }
+
     static bool QueryRedis(
       std::string redisPassword,
       std::string redisKey,
@@ -221,17 +289,21 @@ namespace drachtio {
       }
     }
     
-    Blacklist::Blacklist(std::string& redisAddress, unsigned int redisPort,  std::string& redisPassword, std::string& redisKey, unsigned int refreshSecs) :
+    Blacklist::Blacklist(std::string& redisAddress, unsigned int redisPort,  std::string& redisPassword, std::string& redisKey, unsigned int refreshSecs,
+      const std::string& redisChannel) :
       m_redisKey(redisKey),
       m_refreshSecs(refreshSecs),
+      m_redisChannel(redisChannel),
       m_redisAddress(redisAddress),
       m_redisPassword(redisPassword),
       m_redisPort(redisPort)
     {
     } 
-    Blacklist::Blacklist(std::string& sentinels, std::string& masterName,std::string& redisPassword, std::string& redisKey, unsigned int refreshSecs) :
+    Blacklist::Blacklist(std::string& sentinels, std::string& masterName,std::string& redisPassword, std::string& redisKey, unsigned int refreshSecs,
+      const std::string& redisChannel) :
       m_redisKey(redisKey),
       m_refreshSecs(refreshSecs),
+      m_redisChannel(redisChannel),
       m_redisPassword(redisPassword),
       m_sentinels(sentinels),
       m_masterName(masterName)
@@ -251,6 +323,15 @@ namespace drachtio {
       bool initialized = false;
       DR_LOG(log_debug) << "Blacklist thread id: " << std::this_thread::get_id()  ;
 
+      auto query = [this](const boost::asio::ip::tcp::endpoint& endpoint) -> bool {
+        if (!m_redisChannel.empty()) return subscribeRedis(endpoint);
+
+        std::unordered_set<std::string> ips;
+        if (!QueryRedis(m_redisPassword, m_redisKey, endpoint, ips)) return false;
+        replaceIps(ips);
+        return true;
+      };
+
       while (true) {
         unsigned int interval = m_refreshSecs;
 
@@ -320,15 +401,24 @@ namespace drachtio {
                   ec);
               for (boost::asio::ip::tcp::endpoint const& endpoint : results) {
                 DR_LOG(log_debug) << "Blacklist resolved to " << endpoint.address() ;
-                if (QueryRedis(m_redisPassword, m_redisKey, endpoint, m_ips)) initialized = true;
+                if (query(endpoint)) initialized = true;
                 break;
               }
             }
             else {
               boost::asio::ip::tcp::endpoint endpoint(ip_address, port);
               DR_LOG(log_debug) << "Connecting to redis at " << ip << ":" << port ;
-              if (QueryRedis(m_redisPassword, m_redisKey, endpoint, m_ips)) initialized = true;
+              if (query(endpoint)) initialized = true;
             }
+            if (initialized) break;
+          }
+
+          /* in incremental mode we only get here when the subscription was lost, so reconnect and reload */
+          if (!m_redisChannel.empty() && initialized) {
+            DR_LOG(log_notice) << "Blacklist::threadFunc - lost subscription to " << m_redisChannel << ", reconnecting" ;
+            initialized = false;
+            std::this_thread::sleep_for (std::chrono::seconds(5));
+            continue;
           }
           if (initialized) break;
         }
@@ -341,6 +431,85 @@ namespace drachtio {
       }
    }
 
+    void Blacklist::replaceIps(std::unordered_set<std::string>& ips) {
+      std::unique_lock<std::shared_mutex> lock(m_mutex);
+      m_ips.swap(ips);
+    }
+
+    /**
+     * messages published to the channel are of the form "add <ip> [<ip>..]" or "remove <ip> [<ip>..]"; 
+     * whoever maintains the set is expected to publish after each SADD / SREM
+     */
+    void Blacklist::updateIps(const char* payload) {
+      std::vector<std::string> tokens;
+      std::string str(payload);
+      boost::split(tokens, str, boost::is_any_of(" ,"), boost::token_compress_on);
+      if (tokens.size() < 2) {
+        DR_LOG(log_error) << "Blacklist::updateIps - invalid message: " << payload ;
+        return;
+      }
+      bool add = 0 == tokens[0].compare("add");
+      if (!add && 0 != tokens[0].compare("remove")) {
+        DR_LOG(log_error) << "Blacklist::updateIps - invalid message: " << payload ;
+        return;
+      }
+
+      std::unique_lock<std::shared_mutex> lock(m_mutex);
+      for (auto it = tokens.begin() + 1; it != tokens.end(); ++it) {
+        if (it->empty()) continue;
+        if (add) m_ips.insert(*it);
+        else m_ips.erase(*it);
+      }
+      DR_LOG(log_debug) << "Blacklist::updateIps - " << tokens[0] << " " << (tokens.size() - 1) << 
+        " IPs, blacklist now has " << m_ips.size() << " entries" ;
+    }
+
+    bool Blacklist::subscribeRedis(const boost::asio::ip::tcp::endpoint& endpoint) {
+      /* subscribe before loading the set so that no changes are missed while we scan */
+      redisContext* sub = ConnectRedis(m_redisPassword, endpoint);
+      if (!sub) return false;
+
+      redisReply *reply = (redisReply *) redisCommand(sub, "SUBSCRIBE %s", m_redisChannel.c_str());
+      if (reply == NULL || reply->type != REDIS_REPLY_ARRAY) {
+        DR_LOG(log_error) << "Blacklist::subscribeRedis - failed to subscribe to " << m_redisChannel << " " <<
+          (reply ? "" : sub->errstr) ;
+        if (reply) freeReplyObject(reply);
+        redisFree(sub);
+        return false;
+      }
+      freeReplyObject(reply);
+
+      redisContext* c = ConnectRedis(m_redisPassword, endpoint);
+      if (!c) {
+        redisFree(sub);
+        return false;
+      }
+      std::unordered_set<std::string> ips;
+      bool loaded = ScanRedis(c, m_redisKey, ips);
+      redisFree(c);
+      if (!loaded) {
+        redisFree(sub);
+        return false;
+      }
+      DR_LOG(log_info) << "Blacklist::subscribeRedis - loaded " << ips.size() << " IPs to blacklist, listening for changes on " << m_redisChannel ;
+      replaceIps(ips);
+
+      /* changes published while we were scanning are waiting for us on the subscriber connection */
+      void* r;
+      while (REDIS_OK == redisGetReply(sub, &r)) {
+        reply = (redisReply *) r;
+        if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 3 && 
+          reply->element[0]->type == REDIS_REPLY_STRING && 0 == strcmp(reply->element[0]->str, "message") &&
+          reply->element[2]->type == REDIS_REPLY_STRING) {
+          updateIps(reply->element[2]->str);
+        }
+        freeReplyObject(reply);
+      }
+      DR_LOG(log_error) << "Blacklist::subscribeRedis - Error: reading from " << endpoint.address() << " " << sub->errstr ;
+      redisFree(sub);
+      return true;
+    }
+
     void Blacklist::stop() {
       //m_thread.join() ;
     }
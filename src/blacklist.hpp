@@ -28,6 +28,7 @@ THE SOFTWARE.
 #include <unordered_set>
 #include <thread>
 #include <list>
+#include <shared_mutex>
 
 #include "drachtio.h"
 
@@ -37,8 +38,10 @@ namespace drachtio {
     
   class Blacklist {
   public:
-    Blacklist(string& redisAddress, unsigned int redisPort, string& redisPassword, string& redisKey, unsigned int refreshSecs = 3600);
-    Blacklist(string& sentinels, string& masterName,   string& redisPassword, string& redisKey, unsigned int refreshSecs = 3600);
+    Blacklist(string& redisAddress, unsigned int redisPort, string& redisPassword, string& redisKey, unsigned int refreshSecs = 3600,
+      const string& redisChannel = "");
+    Blacklist(string& sentinels, string& masterName,   string& redisPassword, string& redisKey, unsigned int refreshSecs = 3600,
+      const string& redisChannel = "");
     ~Blacklist();
     
     void start();
@@ -46,10 +49,19 @@ namespace drachtio {
   	void threadFunc(void) ;
 
     bool isBlackListed(const char* srcAddress) {
+      std::shared_lock<std::shared_mutex> lock(m_mutex);
       return m_ips.end() != m_ips.find(srcAddress);
     }
 
   private:
+    void replaceIps(std::unordered_set<std::string>& ips);
+    void updateIps(const char* payload);
+
+    /**
+     * incremental mode: subscribe to m_redisChannel, load the set with SSCAN, then 
+     * apply add/remove messages until the connection is lost
+     */
+    bool subscribeRedis(const boost::asio::ip::tcp::endpoint& endpoint);
 
     std::thread                     m_thread ;
     boost::asio::io_context         m_ioservice;
@@ -60,6 +72,8 @@ namespace drachtio {
     unsigned int                    m_redisPort;
     std::string&                    m_redisKey; 
     unsigned int                    m_refreshSecs;
+    std::string                     m_redisChannel;
+    std::shared_mutex               m_mutex;
     std::unordered_set<std::string> m_ips ;      
     std::unordered_set<std::string> m_replicas ;      
   } ;
@@ -1,31 +1,41 @@
+#include <cstring>
+#include <cerrno>
+
 #include "drachtio.h"
 #include "controller.hpp"
 #include "client-controller.hpp"
 #include "cdr.hpp"
 
+#define MAX_QUEUED_CDRS (100000)
+
 namespace drachtio {
-  
+
   std::shared_ptr<Cdr> Cdr::postCdr( std::shared_ptr<Cdr> pCdr, const string& encodedMessage ) {
     if( theOneAndOnlyController->getConfig()->generateCdrs() ) {
-      pCdr->stamp() ;
-      pCdr->setEncodedMessage( encodedMessage ) ;
-      shared_ptr<ClientController> pClientController = theOneAndOnlyController->getClientController() ;
-      client_ptr client = pClientController->selectClientForRequestOutsideDialog(pCdr->getRecordType()) ;
-      if( client ) {
-        string encodedMessage ;
-        string meta ;
+      std::shared_ptr<CdrWriter> pWriter = theOneAndOnlyController->getCdrWriter() ;
+      if( !pWriter ) return pCdr ;
 
-        pCdr->encodeMessage( encodedMessage ) ;
-        pCdr->encodeMetaData( meta ) ;
+      // don't encode anything nobody is going to read
+      std::shared_ptr<ClientController> pClientController = theOneAndOnlyController->getClientController() ;
+      if( !pWriter->hasFile() && !( pClientController && pClientController->hasCdrSubscribers() ) ) return pCdr ;
 
-        pClientController->getIOService().post( std:: bind(&BaseClient::sendCdrToClient, client, encodedMessage, meta ) ) ;
-      }
+      // only the encoding needs the msg_t, so it is the only work done on the sip thread
+      CdrRecord_t record ;
+      record.recordType = pCdr->m_recordType ;
+      record.agentRole = pCdr->m_agentRole ;
+      record.terminationReason = pCdr->m_terminationReason ;
+      record.eventTime = su_now() ;
+      record.source = pCdr->m_source ;
+      if( encodedMessage.length() > 0 ) record.encodedMessage = encodedMessage ;
+      else EncodeStackMessage( sip_object(pCdr->m_msg), record.encodedMessage ) ;
+
+      pWriter->post( std::move(record) ) ;
     }
     return pCdr ;
   }
 
 
-  Cdr::Cdr( msg_t* msg, const char* source, RecordType_t recordType, AgentRole_t agentRole ) : 
+  Cdr::Cdr( msg_t* msg, const char* source, RecordType_t recordType, AgentRole_t agentRole ) :
     m_msg(msg_ref_create(msg)), m_recordType(recordType), m_agentRole(agentRole), m_source(source),
     m_terminationReason(no_termination) {
 
@@ -34,49 +44,139 @@ namespace drachtio {
     msg_destroy( m_msg ) ;
   }
 
-  void Cdr::encodeMessage( string& encodedMessage ) {
-    if( m_encodedMessage.length() > 0 ) encodedMessage = m_encodedMessage ;
-    else EncodeStackMessage( sip_object(m_msg), encodedMessage ) ;
+  CdrAttempt::CdrAttempt( msg_t* msg, const char* source ) :
+    Cdr(msg, source, attempt_record, Cdr::role_undefined ) {
+
   }
-  void Cdr::encodeMetaData( string& metaData ) {
-    unsigned short second, minute, hour;
-    char time[64] ;
 
-    second = (unsigned short)(m_eventTime.tv_sec % 60);
-    minute = (unsigned short)((m_eventTime.tv_sec / 60) % 60);
-    hour = (unsigned short)((m_eventTime.tv_sec / 3600) % 24);
-    snprintf(time, sizeof(time), "%02u:%02u:%02u.%06lu", hour, minute, second, m_eventTime.tv_usec);
+  CdrStart::CdrStart( msg_t* msg, const char* source, AgentRole_t agentRole  ) :
+    Cdr(msg, source, start_record, agentRole ) {
 
-    metaData = "" ;
-    metaData += getRecordType() ;
-    metaData += "|" ;
-    metaData += m_source ;
-    metaData += "|" ;
-    metaData += time ;
+  }
 
-    if( start_record == Cdr::m_recordType ) {
-      metaData += "|" ;
-      metaData += getAgentRole() ;      
+  CdrStop::CdrStop( msg_t* msg, const char* source, TerminationReason_t  terminationReason ) :
+    Cdr(msg, source, stop_record, Cdr::role_undefined ) {
+      m_terminationReason = terminationReason ;
+  }
+
+
+  CdrWriter::CdrWriter( const string& filename ) : m_bStop(false), m_dropped(0), m_fp(NULL) {
+    if( !filename.empty() ) {
+      m_fp = fopen( filename.c_str(), "a" ) ;
+      if( !m_fp ) {
+        DR_LOG(log_error) << "CdrWriter::CdrWriter - unable to open cdr file " << filename << ": " << strerror(errno) ;
+      }
+      else {
+        DR_LOG(log_notice) << "CdrWriter::CdrWriter - writing cdrs to " << filename ;
+      }
     }
-    else if( stop_record == Cdr::m_recordType ) {
-      metaData += "|" ;
-      metaData += getTerminationReason() ;
+    std::thread t(&CdrWriter::threadFunc, this) ;
+    m_thread.swap( t ) ;
+  }
+
+  CdrWriter::~CdrWriter() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex) ;
+      m_bStop = true ;
     }
+    m_cond.notify_one() ;
+    if( m_thread.joinable() ) m_thread.join() ;
+    if( m_fp ) fclose( m_fp ) ;
   }
 
+  void CdrWriter::post( CdrRecord_t&& record ) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex) ;
+      if( m_queue.size() >= MAX_QUEUED_CDRS ) {
+        if( 0 == m_dropped++ % 1000 ) {
+          DR_LOG(log_error) << "CdrWriter::post - cdr queue is full, " << m_dropped << " cdrs discarded so far" ;
+        }
+        return ;
+      }
+      m_queue.push_back( std::move(record) ) ;
+    }
+    m_cond.notify_one() ;
+  }
 
-  CdrAttempt::CdrAttempt( msg_t* msg, const char* source ) : 
-    Cdr(msg, source, attempt_record, Cdr::role_undefined ) {
-    
+  void CdrWriter::threadFunc(void) {
+    std::vector<CdrRecord_t> batch ;
+    for(;;) {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex) ;
+        m_cond.wait( lock, [this] { return m_bStop || !m_queue.empty(); } ) ;
+        if( m_bStop && m_queue.empty() ) return ;
+        batch.swap( m_queue ) ;
+      }
+      try {
+        write( batch ) ;
+      } catch( std::exception& e ) {
+        DR_LOG(log_error) << "CdrWriter::threadFunc - error writing cdrs: " << e.what() ;
+      }
+      batch.clear() ;
+    }
   }
 
-  CdrStart::CdrStart( msg_t* msg, const char* source, AgentRole_t agentRole  ) : 
-    Cdr(msg, source, start_record, agentRole ) {
-    
+  void CdrWriter::write( std::vector<CdrRecord_t>& batch ) {
+    typedef std::vector< pair<string, string> > vecCdrs ;
+    std::unordered_map< client_ptr, std::shared_ptr<vecCdrs> > mapClient2Cdrs ;
+    std::shared_ptr<ClientController> pClientController = theOneAndOnlyController->getClientController() ;
+    string fileData ;
+
+    for( CdrRecord_t& record : batch ) {
+      string meta ;
+      encodeMetaData( record, meta ) ;
+
+      // same framing as the app protocol, so the file can be read back with the same parser
+      if( m_fp ) {
+        fileData.append( std::to_string( meta.length() + 2 + record.encodedMessage.length() ) ) ;
+        fileData.push_back( '#' ) ;
+        fileData.append( meta ) ;
+        fileData.append( DR_CRLF ) ;
+        fileData.append( record.encodedMessage ) ;
+      }
+
+      client_ptr client ;
+      if( pClientController ) client = pClientController->selectClientForRequestOutsideDialog( Cdr::getRecordType( record.recordType ) ) ;
+      if( client ) {
+        std::shared_ptr<vecCdrs>& cdrs = mapClient2Cdrs[client] ;
+        if( !cdrs ) cdrs = std::make_shared<vecCdrs>() ;
+        cdrs->push_back( make_pair( std::move(meta), std::move(record.encodedMessage) ) ) ;
+      }
+    }
+
+    if( m_fp && !fileData.empty() ) {
+      if( fileData.length() != fwrite( fileData.data(), 1, fileData.length(), m_fp ) || 0 != fflush( m_fp ) ) {
+        DR_LOG(log_error) << "CdrWriter::write - error writing to cdr file: " << strerror(errno) ;
+      }
+    }
+
+    for( auto& kv : mapClient2Cdrs ) {
+      pClientController->post( std::bind(&BaseClient::sendCdrsToClient, kv.first, kv.second) ) ;
+    }
   }
 
-  CdrStop::CdrStop( msg_t* msg, const char* source, TerminationReason_t  terminationReason ) : 
-    Cdr(msg, source, stop_record, Cdr::role_undefined ) {
-      m_terminationReason = terminationReason ;
+  void CdrWriter::encodeMetaData( const CdrRecord_t& record, string& metaData ) {
+    unsigned short second, minute, hour;
+    char time[64] ;
+
+    second = (unsigned short)(record.eventTime.tv_sec % 60);
+    minute = (unsigned short)((record.eventTime.tv_sec / 60) % 60);
+    hour = (unsigned short)((record.eventTime.tv_sec / 3600) % 24);
+    snprintf(time, sizeof(time), "%02u:%02u:%02u.%06lu", hour, minute, second, (unsigned long) record.eventTime.tv_usec);
+
+    metaData = Cdr::getRecordType( record.recordType ) ;
+    metaData += "|" ;
+    metaData += record.source ;
+    metaData += "|" ;
+    metaData += time ;
+
+    if( Cdr::start_record == record.recordType ) {
+      metaData += "|" ;
+      metaData += Cdr::getAgentRole( record.agentRole ) ;
+    }
+    else if( Cdr::stop_record == record.recordType ) {
+      metaData += "|" ;
+      metaData += Cdr::getTerminationReason( record.terminationReason ) ;
+    }
   }
 }
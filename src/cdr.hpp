@@ -23,6 +23,11 @@ THE SOFTWARE.
 #define __CDR_H__
 
 #include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
 
 #include <sofia-sip/msg.h>
 #include <sofia-sip/sip.h>
@@ -68,15 +73,15 @@ namespace drachtio {
         Cdr( msg_t* msg, const char* source, RecordType_t recordType, AgentRole_t agentRole ) ;
         ~Cdr() ;
 
-        const char* getRecordType() {
+        static const char* getRecordType( RecordType_t recordType ) {
             static const char * szRecordTypes[] = {
                 "cdr:attempt",
                 "cdr:start",
                 "cdr:stop"
             } ;
-            return szRecordTypes[ static_cast<int>(m_recordType) ] ;
+            return szRecordTypes[ static_cast<int>(recordType) ] ;
         }
-        const char* getAgentRole() {
+        static const char* getAgentRole( AgentRole_t agentRole ) {
             static const char * szRoles[] = {
                 "undefined",
                 "proxy-uac",
@@ -84,9 +89,9 @@ namespace drachtio {
                 "uac",
                 "uas",
             } ;
-            return szRoles[ static_cast<int>(m_agentRole) ] ;
+            return szRoles[ static_cast<int>(agentRole) ] ;
         }
-        const char* getTerminationReason() {
+        static const char* getTerminationReason( TerminationReason_t terminationReason ) {
             static const char * szReasons[] = {
                 "undefined",
                 "call-rejected",
@@ -96,25 +101,62 @@ namespace drachtio {
                 "system-initiated-termination",
                 "system-error-initiated-termination"
             } ;
-            return szReasons[ static_cast<int>(m_terminationReason) ] ;
+            return szReasons[ static_cast<int>(terminationReason) ] ;
         }
-
-        void encodeMessage( string& encodedMessage ) ;
-        void encodeMetaData( string& metaData ) ;
-        void stamp(void) { m_eventTime = su_now() ; }
-        void setEncodedMessage(const string& s) { m_encodedMessage = s ;}
         
     protected:
         msg_t*      m_msg ;
 
         RecordType_t   m_recordType ;
         AgentRole_t m_agentRole ;
-        su_time_t   m_eventTime ;
 
         TerminationReason_t m_terminationReason ;
 
-        string      m_encodedMessage ;
-        string      m_source ;
+        const char* m_source ;
+    } ;
+
+    /**
+     * what is kept of a cdr once it leaves the sip thread: the encoded sip message and 
+     * a few enums, rather than a reference to the whole msg_t
+     */
+    struct CdrRecord_t {
+        Cdr::RecordType_t recordType ;
+        Cdr::AgentRole_t agentRole ;
+        Cdr::TerminationReason_t terminationReason ;
+        su_time_t eventTime ;
+        const char* source ;        // "network" or "application"
+        string encodedMessage ;
+    } ;
+
+    /**
+     * formats cdrs on a thread of its own and hands them to the apps that want them, one post per app 
+     * for everything that queued up in the meantime; optionally also appends them to a local file
+     */
+    class CdrWriter {
+    public:
+        CdrWriter( const CdrWriter& ) = delete;
+
+        CdrWriter( const string& filename ) ;
+        ~CdrWriter() ;
+
+        void post( CdrRecord_t&& record ) ;
+
+        bool hasFile(void) const { return NULL != m_fp; }
+
+        static void encodeMetaData( const CdrRecord_t& record, string& metaData ) ;
+
+    private:
+        void threadFunc(void) ;
+        void write( std::vector<CdrRecord_t>& batch ) ;
+
+        std::thread m_thread ;
+        std::mutex m_mutex ;
+        std::condition_variable m_cond ;
+        std::vector<CdrRecord_t> m_queue ;
+        bool m_bStop ;
+        unsigned int m_dropped ;
+
+        FILE* m_fp ;
     } ;
 
 
@@ -33,6 +33,24 @@ THE SOFTWARE.
 
 static string emptyString;
 
+#define TLS_SESSION_LIFETIME_SECS (3600)
+#define TLS_SESSION_CACHE_SIZE (4096)
+
+namespace {
+    /* called by openssl when a session is established, or a ticket is received after the handshake (tls 1.3) */
+    int onNewTlsSession(SSL* ssl, SSL_SESSION* session) {
+        if (SSL_is_server(ssl)) return 0 ;  // the internal cache holds its own reference
+
+        const string* key = static_cast<const string*>(SSL_get_app_data(ssl)) ;
+        drachtio::ClientController* pClientController = 
+            static_cast<drachtio::ClientController*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl))) ;
+        if (!key || !pClientController) return 0 ;
+
+        pClientController->storeTlsSession(*key, session) ;
+        return 1 ;
+    }
+}
+
 namespace drachtio {
     
     // simple tcp server
@@ -59,7 +77,20 @@ namespace drachtio {
         m_endpoint_tls(boost::asio::ip::make_address(address.c_str()), tlsPort),
         m_acceptor_tls(m_ioservice, m_endpoint_tls), 
         m_context(boost::asio::ssl::context::sslv23),
-        m_tcpPort(tcpPort), m_tlsPort(tlsPort) {
+        m_tcpPort(tcpPort), m_tlsPort(tlsPort), m_queueDepth(0), m_pendingWriteBytes(0), m_bHasCdrSubscribers(false), m_selectionPolicy(selection_round_robin),
+        m_poolTimer(m_ioservice), m_bPoolTimerArmed(false) {
+
+        const string& policy = m_pController->getAppSelectionPolicy() ;
+        if( 0 == policy.compare("least-transactions") ) m_selectionPolicy = selection_least_transactions ;
+        else if( 0 == policy.compare("least-write-bytes") ) m_selectionPolicy = selection_least_write_bytes ;
+        else if( 0 == policy.compare("weighted") ) m_selectionPolicy = selection_weighted ;
+        else if( 0 == policy.compare("power-of-two") ) m_selectionPolicy = selection_power_of_two ;
+        else if( !policy.empty() && 0 != policy.compare("round-robin") ) {
+            DR_LOG(log_error) << "ClientController::ClientController - unknown app selection policy " << policy << ", using round-robin" ;
+        }
+        if( selection_round_robin != m_selectionPolicy ) {
+            DR_LOG(log_info) << "ClientController::ClientController - app selection policy: " << policy ;
+        }
 
         if (0 != tlsPort) {
             m_context.set_options(
@@ -87,6 +118,18 @@ namespace drachtio {
 
             //m_context.set_verify_mode(boost::asio::ssl::verify_none);
         }
+
+        // session resumption: tickets and a session id cache for apps connecting to us, and 
+        // the last session from each app we connect out to
+        SSL_CTX* ctx = m_context.native_handle() ;
+        SSL_CTX_set_app_data(ctx, this) ;
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_BOTH) ;
+        SSL_CTX_sess_set_cache_size(ctx, TLS_SESSION_CACHE_SIZE) ;
+        SSL_CTX_set_timeout(ctx, TLS_SESSION_LIFETIME_SECS) ;
+        SSL_CTX_set_session_id_context(ctx, (const unsigned char *) "drachtio", 8) ;
+        SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET) ;
+        SSL_CTX_sess_set_new_cb(ctx, onNewTlsSession) ;
+
         DR_LOG(log_debug) << "ClientController::ClientController done setting tls options: ";
     }
 
@@ -130,6 +173,11 @@ namespace drachtio {
     }
     void ClientController::leave( client_ptr client ) {
         m_clients.erase( client ) ;
+        if( client->isPooled() ) removePooledConnection( client ) ;
+        {
+            std::lock_guard<std::mutex> l( m_lock ) ;
+            releaseOwnedIds_nolock( client ) ;
+        }
         time_t duration = client->getConnectionDuration();
         DR_LOG(log_info) << "ClientController::leave - Removed client, connection duration " << std::dec << 
             duration << " seconds, count of connected clients is now: " << m_clients.size()  ;
@@ -142,6 +190,18 @@ namespace drachtio {
       }
     }
     void ClientController::outboundReady( client_ptr client, const string& transactionId ) {
+      if( client->isPooled() ) {
+        mapPoolKey2OutboundPool::iterator it = m_mapOutboundPools.find( client->getPoolKey() ) ;
+        if( m_mapOutboundPools.end() == it || 0 == it->second.connecting.erase( client ) ) {
+          DR_LOG(log_debug) << "ClientController::outboundReady - closing pooled connection to retired target " << client->getPoolKey() ;
+          client->close() ;
+          return ;
+        }
+        DR_LOG(log_debug) << "ClientController::outboundReady - pooled connection to " << client->getPoolKey() << " is ready" ;
+        it->second.idle.push_back( std::make_pair( client, std::chrono::steady_clock::now() ) ) ;
+        reportOutboundPoolStats() ;
+        return ;
+      }
       int rc = m_pController->getPendingRequestController()->routeNewRequestToClient(client, transactionId) ;
       if( rc ) {
         DR_LOG(log_error) << "ClientController::outboundReady - error routing over outbound connection transactionId: " << transactionId ;
@@ -149,6 +209,26 @@ namespace drachtio {
       }
     }
 
+    void ClientController::pooledConnectionFailed( client_ptr client ) {
+      DR_LOG(log_info) << "ClientController::pooledConnectionFailed - unable to open pooled connection to " << client->getPoolKey() ;
+      removePooledConnection( client ) ;
+    }
+
+    void ClientController::removePooledConnection( client_ptr client ) {
+      mapPoolKey2OutboundPool::iterator it = m_mapOutboundPools.find( client->getPoolKey() ) ;
+      if( m_mapOutboundPools.end() == it ) return ;
+
+      OutboundPool_t& pool = it->second ;
+      pool.connecting.erase( client ) ;
+      for( auto itIdle = pool.idle.begin(); itIdle != pool.idle.end(); ++itIdle ) {
+        if( itIdle->first == client ) {
+          pool.idle.erase( itIdle ) ;
+          break ;
+        }
+      }
+      reportOutboundPoolStats() ;
+    }
+
     void ClientController::addNamedService( client_ptr client, string& strAppName ) {
         //TODO: should we be locking here?  need to review entire locking strategy for this class
         client_weak_ptr p( client ) ;
@@ -180,15 +260,236 @@ namespace drachtio {
     }
 
     void ClientController::makeOutboundConnection( const string& transactionId, const string& host, const string& port, const string& transport ) {
+        // called from the http threads; the connection (and the resolver cache) belong to the io thread
+        post([this, transactionId, host, port, transport]() {
+            unsigned int poolMin = m_pController->getOutboundPoolMin() ;
+            if( 0 == poolMin ) {
+                connectOutbound( transactionId, host, port, transport, emptyString ) ;
+                return ;
+            }
+
+            string key = transport + ":" + host + ":" + port ;
+            mapPoolKey2OutboundPool::iterator it = m_mapOutboundPools.find( key ) ;
+            bool bNewPool = m_mapOutboundPools.end() == it ;
+            if( bNewPool ) {
+                DR_LOG(log_info) << "ClientController::makeOutboundConnection - creating connection pool for " << key ;
+                it = m_mapOutboundPools.insert( mapPoolKey2OutboundPool::value_type( key, OutboundPool_t() ) ).first ;
+                it->second.host = host ;
+                it->second.port = port ;
+                it->second.transport = transport ;
+                it->second.target = poolMin ;
+            }
+            OutboundPool_t& pool = it->second ;
+            pool.lastUsed = std::chrono::steady_clock::now() ;
+
+            if( !pool.idle.empty() ) {
+                // most recently authenticated first, so the oldest spares are the ones that age out
+                client_ptr client = pool.idle.back().first ;
+                pool.idle.pop_back() ;
+                STATS_COUNTER_INCREMENT(STATS_COUNTER_APP_OUTBOUND_POOL, {{"result", "hit"}})
+                DR_LOG(log_debug) << "ClientController::makeOutboundConnection - using pooled connection to " << key ;
+                client->assignTransaction( transactionId ) ;
+                outboundReady( client, transactionId ) ;
+            }
+            else {
+                // calls are arriving faster than the pool refills: keep more spares, up to the max
+                STATS_COUNTER_INCREMENT(STATS_COUNTER_APP_OUTBOUND_POOL, {{"result", "miss"}})
+                if( !bNewPool ) pool.target = std::min( pool.target + 1, std::max( poolMin, m_pController->getOutboundPoolMax() ) ) ;
+                connectOutbound( transactionId, host, port, transport, emptyString ) ;
+            }
+
+            for( unsigned int n = pool.idle.size() + pool.connecting.size(); n < pool.target; n++ ) {
+                pool.connecting.insert( connectOutbound( emptyString, host, port, transport, key ) ) ;
+            }
+            reportOutboundPoolStats() ;
+
+            if( !m_bPoolTimerArmed ) {
+                m_bPoolTimerArmed = true ;
+                m_poolTimer.expires_after( std::chrono::seconds(5) ) ;
+                m_poolTimer.async_wait( std::bind( &ClientController::sweepOutboundPools, shared_from_this(), std::placeholders::_1 ) ) ;
+            }
+        }) ;
+    }
+
+    client_ptr ClientController::connectOutbound( const string& transactionId, const string& host, const string& port, 
+        const string& transport, const string& poolKey ) {
+        client_ptr new_session ;
         if (0 == transport.compare("tls")) {
-            Client<ssl_socket_t, ssl_socket_t::lowest_layer_type>* p =  new Client<ssl_socket_t, ssl_socket_t::lowest_layer_type>( m_ioservice, m_context, *this, transactionId, host, port ) ;
-            client_ptr new_session(p) ;
-            p->async_connect() ;
+            new_session.reset( new Client<ssl_socket_t, ssl_socket_t::lowest_layer_type>( m_ioservice, m_context, *this, transactionId, host, port ) ) ;
         }
         else {
-            Client<socket_t>* p =  new Client<socket_t>( m_ioservice, *this, transactionId, host, port ) ;
-            client_ptr new_session(p) ;
-            p->async_connect() ;
+            new_session.reset( new Client<socket_t>( m_ioservice, *this, transactionId, host, port ) ) ;
+        }
+        new_session->setPoolKey( poolKey ) ;
+        new_session->async_connect() ;
+        return new_session ;
+    }
+
+    void ClientController::resumeTlsSession( SSL* ssl, const string& key ) {
+        SSL_set_app_data( ssl, &key ) ;
+
+        mapHostPort2TlsSession::iterator it = m_mapTlsSessions.find( key ) ;
+        if( m_mapTlsSessions.end() == it ) return ;
+
+        SSL_SESSION* session = it->second->second.get() ;
+        bool expired = SSL_SESSION_get_time( session ) + SSL_SESSION_get_timeout( session ) < time(NULL) ;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+        expired = expired || !SSL_SESSION_is_resumable( session ) ;
+#endif
+        if( expired ) {
+            m_tlsSessionLru.erase( it->second ) ;
+            m_mapTlsSessions.erase( it ) ;
+            return ;
+        }
+        DR_LOG(log_debug) << "ClientController::resumeTlsSession - offering cached tls session to " << key ;
+        SSL_set_session( ssl, session ) ;
+    }
+
+    void ClientController::storeTlsSession( const string& key, SSL_SESSION* session ) {
+        mapHostPort2TlsSession::iterator it = m_mapTlsSessions.find( key ) ;
+        if( m_mapTlsSessions.end() != it ) {
+            m_tlsSessionLru.erase( it->second ) ;
+            m_mapTlsSessions.erase( it ) ;
+        }
+        m_tlsSessionLru.emplace_front( key, std::shared_ptr<SSL_SESSION>( session, SSL_SESSION_free ) ) ;
+        m_mapTlsSessions[key] = m_tlsSessionLru.begin() ;
+
+        // when full, only the session stored longest ago is given up
+        if( m_tlsSessionLru.size() > TLS_SESSION_CACHE_SIZE ) {
+            DR_LOG(log_debug) << "ClientController::storeTlsSession - outbound tls session cache is full, dropping session for " << 
+                m_tlsSessionLru.back().first ;
+            m_mapTlsSessions.erase( m_tlsSessionLru.back().first ) ;
+            m_tlsSessionLru.pop_back() ;
+        }
+    }
+
+    void ClientController::sweepOutboundPools( const boost::system::error_code& ec ) {
+        if( ec ) return ;
+
+        auto now = std::chrono::steady_clock::now() ;
+        std::chrono::seconds idleTimeout( m_pController->getOutboundPoolIdleTimeout() ) ;
+        unsigned int poolMin = m_pController->getOutboundPoolMin() ;
+
+        for( mapPoolKey2OutboundPool::iterator it = m_mapOutboundPools.begin(); it != m_mapOutboundPools.end(); ) {
+            OutboundPool_t& pool = it->second ;
+
+            // nothing has been routed here for a while: retire the pool (connections still opening are closed once ready)
+            if( now - pool.lastUsed > idleTimeout ) {
+                DR_LOG(log_info) << "ClientController::sweepOutboundPools - closing " << pool.idle.size() << 
+                    " idle connection(s) to unused target " << it->first ;
+                for( auto& idle : pool.idle ) idle.first->close() ;
+                it = m_mapOutboundPools.erase( it ) ;
+                continue ;
+            }
+
+            // shrink back toward the min when spares go unused
+            while( !pool.idle.empty() && pool.idle.size() + pool.connecting.size() > poolMin && 
+                now - pool.idle.front().second > idleTimeout ) {
+                pool.idle.front().first->close() ;
+                pool.idle.pop_front() ;
+                if( pool.target > poolMin ) pool.target-- ;
+            }
+
+            // top up, including after connections failed or were closed by the app
+            for( unsigned int n = pool.idle.size() + pool.connecting.size(); n < pool.target; n++ ) {
+                pool.connecting.insert( connectOutbound( emptyString, pool.host, pool.port, pool.transport, it->first ) ) ;
+            }
+            ++it ;
+        }
+        reportOutboundPoolStats() ;
+
+        m_bPoolTimerArmed = !m_mapOutboundPools.empty() ;
+        if( m_bPoolTimerArmed ) {
+            m_poolTimer.expires_after( std::chrono::seconds(5) ) ;
+            m_poolTimer.async_wait( std::bind( &ClientController::sweepOutboundPools, shared_from_this(), std::placeholders::_1 ) ) ;
+        }
+    }
+
+    void ClientController::reportOutboundPoolStats() {
+        if (!theOneAndOnlyController->getStatsCollector().enabled()) return ;
+        size_t idle = 0 ;
+        for( const auto& kv : m_mapOutboundPools ) idle += kv.second.idle.size() ;
+        STATS_GAUGE_SET(STATS_GAUGE_APP_OUTBOUND_POOL_IDLE, idle)
+    }
+
+    void ClientController::resolveOutbound( const string& host, const string& port, resolve_handler handler ) {
+        string key = host + ":" + port ;
+        auto now = std::chrono::steady_clock::now() ;
+
+        mapHostPort2Resolved::iterator it = m_mapResolved.find( key ) ;
+        if( m_mapResolved.end() != it ) {
+            if( now < it->second.expires ) {
+                DR_LOG(log_debug) << "ClientController::resolveOutbound - using cached addresses for " << key ;
+                return handler( boost::system::error_code(), it->second.results ) ;
+            }
+            m_mapResolved.erase( it ) ;
+        }
+
+        mapHostPort2PendingResolve::iterator itPending = m_mapPendingResolves.find( key ) ;
+        if( m_mapPendingResolves.end() != itPending ) {
+            DR_LOG(log_debug) << "ClientController::resolveOutbound - waiting on lookup already in progress for " << key ;
+            itPending->second.handlers.push_back( handler ) ;
+            return ;
+        }
+
+        DR_LOG(log_debug) << "ClientController::resolveOutbound - resolving " << key ;
+        PendingResolve_t& pending = m_mapPendingResolves[key] ;
+        pending.handlers.push_back( handler ) ;
+        pending.resolver = std::make_shared<boost::asio::ip::tcp::resolver>( m_ioservice ) ;
+        pending.timer = std::make_shared<boost::asio::steady_timer>( m_ioservice ) ;
+
+        // cancelling the resolver completes the lookup with operation_aborted
+        std::weak_ptr<boost::asio::ip::tcp::resolver> weakResolver = pending.resolver ;
+        pending.timer->expires_after( std::chrono::milliseconds( m_pController->getOutboundDnsTimeout() ) ) ;
+        pending.timer->async_wait( [key, weakResolver](const boost::system::error_code& ec) {
+            if( ec ) return ;
+            std::shared_ptr<boost::asio::ip::tcp::resolver> resolver = weakResolver.lock() ;
+            if( resolver ) {
+                DR_LOG(log_warning) << "ClientController::resolveOutbound - timed out resolving " << key ;
+                resolver->cancel() ;
+            }
+        }) ;
+
+        pending.resolver->async_resolve( host, port, std::bind( &ClientController::resolveComplete, shared_from_this(), key,
+            std::placeholders::_1, std::placeholders::_2 ) ) ;
+    }
+
+    void ClientController::resolveComplete( const string& key, const boost::system::error_code& ec,
+        const boost::asio::ip::tcp::resolver::results_type& results ) {
+
+        mapHostPort2PendingResolve::iterator it = m_mapPendingResolves.find( key ) ;
+        if( m_mapPendingResolves.end() == it ) return ;
+
+        std::vector<resolve_handler> handlers ;
+        handlers.swap( it->second.handlers ) ;
+        it->second.timer->cancel() ;
+        m_mapPendingResolves.erase( it ) ;
+
+        boost::system::error_code err = ec ;
+        if( boost::asio::error::operation_aborted == err ) err = boost::asio::error::timed_out ;
+        else if( !err && results.empty() ) err = boost::asio::error::host_not_found ;
+
+        unsigned int ttl = m_pController->getOutboundDnsCacheTtl() ;
+        if( !err && ttl > 0 ) {
+            auto now = std::chrono::steady_clock::now() ;
+
+            // targets are typically a handful of app servers, but don't let stale names pile up
+            if( m_mapResolved.size() >= 1024 ) {
+                for( mapHostPort2Resolved::iterator itCache = m_mapResolved.begin(); itCache != m_mapResolved.end(); ) {
+                    if( itCache->second.expires <= now ) itCache = m_mapResolved.erase( itCache ) ;
+                    else ++itCache ;
+                }
+            }
+            if( m_mapResolved.size() < 1024 ) {
+                ResolvedAddress_t resolved = { results, now + std::chrono::seconds( ttl ) } ;
+                m_mapResolved[key] = resolved ;
+            }
+        }
+
+        DR_LOG(log_debug) << "ClientController::resolveComplete - " << key << ": " << (err ? err.message() : "resolved") <<
+            ", notifying " << handlers.size() << " waiting connection(s)" ;
+        for( resolve_handler& handler : handlers ) {
+            handler( err, results ) ;
         }
     }
 
@@ -217,6 +518,8 @@ namespace drachtio {
         RequestSpecifier spec( client ) ;
         std::lock_guard<std::mutex> l( m_lock ) ;
         m_request_types.insert( map_of_request_types::value_type(verb, spec)) ;  
+        client->getOwnedIds().verbs.insert( verb ) ;
+        updateCdrSubscribers_nolock() ;
         DR_LOG(log_debug) << "Added client for " << verb << " requests"  ;
 
         //initialize the offset if this is the first client registering for that verb
@@ -229,34 +532,42 @@ namespace drachtio {
 
 
     bool ClientController::no_longer_wants_requests( client_ptr client, const string& verb ) {
-        RequestSpecifier spec( client ) ;
         std::lock_guard<std::mutex> l( m_lock ) ;
-        // Remove all instances of this client for this verb
-        for (map_of_request_types::iterator it = m_request_types.begin(); it != m_request_types.end(); ) {
-            if (it->second.client() == client) {
+        // Remove all instances of this client for this verb (and any disconnected clients found along the way)
+        pair<map_of_request_types::iterator,map_of_request_types::iterator> range = m_request_types.equal_range( verb ) ;
+        for (map_of_request_types::iterator it = range.first; it != range.second; ) {
+            client_ptr c = it->second.client() ;
+            if (!c || c == client) {
                 it = m_request_types.erase(it);
             }
             else {
                 ++it;
             }
         }
+        client->getOwnedIds().verbs.erase( verb ) ;
+        updateCdrSubscribers_nolock() ;
         DR_LOG(log_debug) << "Removed client for " << verb << " requests"  ;
 
         //TODO: validate the verb is supported
         return true ;  
     }
 
-    client_ptr ClientController::selectClientForRequestOutsideDialog(const char* keyword, const char* tag) {
-        string method_name = keyword ;
-        transform(method_name.begin(), method_name.end(), method_name.begin(), ::tolower);
+    void ClientController::updateCdrSubscribers_nolock() {
+        m_bHasCdrSubscribers = m_request_types.count( Cdr::getRecordType( Cdr::attempt_record ) ) > 0 ||
+            m_request_types.count( Cdr::getRecordType( Cdr::start_record ) ) > 0 ||
+            m_request_types.count( Cdr::getRecordType( Cdr::stop_record ) ) > 0 ;
+    }
 
-        /* round robin select a client that has registered for this request type (and, optionally, tag)*/
+    client_ptr ClientController::selectClientForRequestOutsideDialog(const char* keyword, const char* tag) {
         std::lock_guard<std::mutex> l( m_lock ) ;
         client_ptr client ;
-        string matchId ;
-        pair<map_of_request_types::iterator,map_of_request_types::iterator> pair = m_request_types.equal_range(method_name) ;
-        unsigned int nPossibles = std::distance(pair.first, pair.second) ;
-        if( 0 == nPossibles ) {
+
+        m_selectionVerb.assign( keyword ) ;
+        transform(m_selectionVerb.begin(), m_selectionVerb.end(), m_selectionVerb.begin(), ::tolower);
+        const string& method_name = m_selectionVerb ;
+
+        pair<map_of_request_types::iterator,map_of_request_types::iterator> range = m_request_types.equal_range(method_name) ;
+        if( range.first == range.second ) {
             if( 0 == method_name.find("cdr") ) {
                 DR_LOG(log_debug) << "No connected clients found to handle incoming " << method_name << " request"  ;
             }
@@ -266,50 +577,82 @@ namespace drachtio {
            return client ;           
         }
 
-        unsigned int nOffset = 0 ;
-        map_of_request_type_offsets::const_iterator itOffset = m_map_of_request_type_offsets.find(method_name) ;
-        if( m_map_of_request_type_offsets.end() != itOffset ) {
-            unsigned int i = itOffset->second;
-            if( i < nPossibles ) nOffset = i ;
-            else nOffset = 0;
-        }
-        DR_LOG(log_debug) << "ClientController::selectClientForRequestOutsideDialog - there are " << nPossibles << 
-            " possible clients, we are starting with offset " << nOffset  ;
-
-        m_map_of_request_type_offsets.erase(itOffset) ;
-        m_map_of_request_type_offsets.insert(map_of_request_type_offsets::value_type(method_name, nOffset + 1)) ;
-
-        unsigned int nTries = 0 ;
-        map_of_request_types::iterator it = pair.first ;
-        std::advance(it, nOffset) ;
-        do {
-            if (it == pair.second) it = pair.first;
-    
-            RequestSpecifier& spec = it->second ;
-            client = spec.client() ;
-            if (!client) {
+        /* gather the clients that registered for this request type (and, optionally, tag) */
+        std::vector<client_ptr>& candidates = m_selectionCandidates ;
+        candidates.clear() ;
+        for( map_of_request_types::iterator it = range.first; it != range.second; ) {
+            client_ptr c = it->second.client() ;
+            if( !c ) {
                 DR_LOG(log_debug) << "ClientController::route_request_outside_dialog - Removing disconnected client while iterating"  ;
                 it = m_request_types.erase( it ) ;
-                //pair = m_request_types.equal_range(method_name) ;
-                //nOffset = 0 ;
-                //nPossibles = std::distance( pair.first, pair.second ) ;
-            }
-            else if (tag && !client->hasTag(tag)) {
-                DR_LOG(log_debug) << "ClientController::route_request_outside_dialog - client at offset " << nOffset << " does not support tag " << tag;
-                client = NULL;
-                it++;
+                continue ;
             }
+            if( !tag || c->hasTag(tag) ) candidates.push_back( c ) ;
             else {
-                DR_LOG(log_debug) << "ClientController::route_request_outside_dialog - Selected client at offset " << nOffset  ;                
+                DR_LOG(log_debug) << "ClientController::route_request_outside_dialog - client does not support tag " << tag;
             }
-            nPossibles--;
-        } while( !client && nPossibles > 0 ) ;
-
-        if( !client ) {
+            ++it ;
+        }
+        if( candidates.empty() ) {
             DR_LOG(log_info) << "ClientController::route_request_outside_dialog - No clients found to handle incoming " << method_name << " request"  ;
             return client ;
         }
- 
+
+        // the round robin offset also decides which of several equally loaded clients goes first
+        unsigned int& offset = m_map_of_request_type_offsets[method_name] ;
+        unsigned int nStart = offset++ % candidates.size() ;
+        unsigned int nSelected = nStart ;
+
+        switch( m_selectionPolicy ) {
+            case selection_least_transactions:
+            case selection_least_write_bytes:
+            {
+                uint64_t least = UINT64_MAX ;
+                for( unsigned int n = 0; n < candidates.size(); n++ ) {
+                    unsigned int i = (nStart + n) % candidates.size() ;
+                    uint64_t load = selection_least_transactions == m_selectionPolicy ?
+                        candidates[i]->getOwnedIds().netTransactions.size() : candidates[i]->getPendingWriteBytes() ;
+                    if( load < least ) {
+                        least = load ;
+                        nSelected = i ;
+                    }
+                }
+                break ;
+            }
+            case selection_weighted:
+            {
+                uint64_t total = 0 ;
+                for( const client_ptr& c : candidates ) total += c->getWeight() ;
+                uint64_t r = rand() % total ;
+                for( unsigned int i = 0; i < candidates.size(); i++ ) {
+                    if( r < candidates[i]->getWeight() ) {
+                        nSelected = i ;
+                        break ;
+                    }
+                    r -= candidates[i]->getWeight() ;
+                }
+                break ;
+            }
+            case selection_power_of_two:
+            {
+                if( candidates.size() < 2 ) break ;
+                unsigned int i = rand() % candidates.size() ;
+                unsigned int j = rand() % (candidates.size() - 1) ;
+                if( j >= i ) j++ ;
+                size_t loadI = candidates[i]->getOwnedIds().netTransactions.size() ;
+                size_t loadJ = candidates[j]->getOwnedIds().netTransactions.size() ;
+                if( loadI != loadJ ) nSelected = loadI < loadJ ? i : j ;
+                else nSelected = candidates[i]->getPendingWriteBytes() <= candidates[j]->getPendingWriteBytes() ? i : j ;
+                break ;
+            }
+            default:
+                break ;
+        }
+
+        DR_LOG(log_debug) << "ClientController::selectClientForRequestOutsideDialog - selected client " << nSelected << 
+            " of " << candidates.size() << " for " << method_name ;
+        client = candidates[nSelected] ;
+        candidates.clear() ;
         return client ;
     }
     bool ClientController::route_ack_request_inside_dialog( const string& rawSipMsg, const SipMsgData_t& meta, nta_incoming_t* prack, 
@@ -325,7 +668,7 @@ namespace drachtio {
         }
 
         void (BaseClient::*fn)(const string&, const string&, const string&, const SipMsgData_t&) = &BaseClient::sendSipMessageToClient;
-        m_ioservice.post( std::bind(fn, client, transactionId, dialogId, rawSipMsg, meta) ) ;
+        post( std::bind(fn, client, transactionId, dialogId, rawSipMsg, meta) ) ;
 
         this->removeNetTransaction( inviteTransactionId ) ;
         DR_LOG(log_debug) << "ClientController::route_ack_request_inside_dialog - removed incoming invite transaction, map size is now: " << m_mapNetTransactions.size() << " request"  ;
@@ -346,7 +689,7 @@ namespace drachtio {
  
         DR_LOG(log_debug) << "ClientController::route_response_inside_invite - sending response to client"  ;
         void (BaseClient::*fn)(const string&, const string&, const string&, const SipMsgData_t&) = &BaseClient::sendSipMessageToClient;
-        m_ioservice.post( std::bind(fn, client, transactionId, dialogId, rawSipMsg, meta) ) ;
+        post( std::bind(fn, client, transactionId, dialogId, rawSipMsg, meta) ) ;
 
         return true ;
     }
@@ -376,7 +719,7 @@ namespace drachtio {
         if (string::npos == transactionId.find("unsolicited")) this->addNetTransaction( client, transactionId ) ;
  
         void (BaseClient::*fn)(const string&, const string&, const string&, const SipMsgData_t&) = &BaseClient::sendSipMessageToClient;
-        m_ioservice.post( std::bind(fn, client, transactionId, dialogId, rawSipMsg, meta) ) ;
+        post( std::bind(fn, client, transactionId, dialogId, rawSipMsg, meta) ) ;
 
         // if this is a BYE from the network, it ends the dialog 
         if( isBye || isFinalNotifyForSubscribe) {
@@ -399,7 +742,7 @@ namespace drachtio {
         }
 
         void (BaseClient::*fn)(const string&, const string&, const string&, const SipMsgData_t&) = &BaseClient::sendSipMessageToClient;
-        m_ioservice.post( std::bind(fn, client, transactionId, dialogId, rawSipMsg, meta) ) ;
+        post( std::bind(fn, client, transactionId, dialogId, rawSipMsg, meta) ) ;
 
         string method_name = sip->sip_cseq->cs_method_name ;
         if( sip->sip_status->st_status >= 200 ) {
@@ -417,7 +760,10 @@ namespace drachtio {
         std::lock_guard<std::mutex> l( m_lock ) ;
         mapId2Client::iterator it = m_mapNetTransactions.find( transactionId ) ;
         if( m_mapNetTransactions.end() != it ) {
-            m_mapDialogs.insert( mapId2Client::value_type(dialogId, it->second ) ) ;
+            client_ptr owner = it->second.lock() ;
+            if( m_mapDialogs.insert( mapId2Client::value_type(dialogId, it->second ) ).second && owner ) {
+                owner->getOwnedIds().dialogs.insert( dialogId ) ;
+            }
             DR_LOG(log_info) << "ClientController::addDialogForTransaction - added dialog (uas), now tracking: " << 
                 m_mapDialogs.size() << " dialogs and " << m_mapNetTransactions.size() << " net transactions"  ;
          }
@@ -427,7 +773,9 @@ namespace drachtio {
             if( m_mapDialogs.end() == itDialog ) {
                 mapId2Client::iterator itApp = m_mapAppTransactions.find( transactionId ) ;
                 if( m_mapAppTransactions.end() != itApp ) {
+                    client_ptr owner = itApp->second.lock() ;
                     m_mapDialogs.insert( mapId2Client::value_type(dialogId, itApp->second ) ) ;
+                    if( owner ) owner->getOwnedIds().dialogs.insert( dialogId ) ;
                     DR_LOG(log_info) << "ClientController::addDialogForTransaction - added dialog (uac), now tracking: " << 
                         m_mapDialogs.size() << " dialogs and " << m_mapAppTransactions.size() << " app transactions"  ;
                 }
@@ -485,6 +833,7 @@ namespace drachtio {
         const string& body ) {
 
         addApiRequest( client, clientMsgId )  ;
+        m_pController->getRequestTracer().mark( transactionId, RequestTracer::STAGE_PARSED ) ;
         bool rc = m_pController->getDialogController()->respondToSipRequest( clientMsgId, transactionId, startLine, headers, body ) ;
         return rc ;               
     }   
@@ -517,7 +866,7 @@ namespace drachtio {
         if( string::npos == additionalResponseData.find("|continue") ) {
             removeApiRequest( clientMsgId ) ;
         }
-        m_ioservice.post( std::bind(&BaseClient::sendApiResponseToClient, client, clientMsgId, responseText, additionalResponseData) ) ;
+        post( std::bind(&BaseClient::sendApiResponseToClient, client, clientMsgId, responseText, additionalResponseData) ) ;
         return true ;                
     }
     
@@ -525,10 +874,15 @@ namespace drachtio {
         std::lock_guard<std::mutex> l( m_lock ) ;
         mapId2Client::iterator it = m_mapDialogs.find( dialogId ) ;
         if( m_mapDialogs.end() == it ) {
-            DR_LOG(log_warning) << "ClientController::removeDialog - dialog not found: " << dialogId  ;
+            // expected for dialogs whose app disconnected, since leave() releases everything the app owned
+            DR_LOG(log_debug) << "ClientController::removeDialog - dialog not found (app may have disconnected): " << dialogId  ;
+            m_mapDialogId2Appname.erase( dialogId ) ;
             return ;
         }
+        client_ptr owner = it->second.lock() ;
+        if( owner ) owner->getOwnedIds().dialogs.erase( dialogId ) ;
         m_mapDialogs.erase( it ) ;
+        m_mapDialogId2Appname.erase( dialogId ) ;
         DR_LOG(log_info) << "ClientController::removeDialog - after removing dialogs count is now: " << m_mapDialogs.size()  ;
     }
     client_ptr ClientController::findClientForDialog( const string& dialogId ) {
@@ -596,77 +950,173 @@ namespace drachtio {
     }
     void ClientController::removeAppTransaction( const string& transactionId ) {
         std::lock_guard<std::mutex> l( m_lock ) ;
-        m_mapAppTransactions.erase( transactionId ) ;        
+        mapId2Client::iterator it = m_mapAppTransactions.find( transactionId ) ;
+        if( m_mapAppTransactions.end() != it ) {
+            client_ptr owner = it->second.lock() ;
+            if( owner ) owner->getOwnedIds().appTransactions.erase( transactionId ) ;
+            m_mapAppTransactions.erase( it ) ;
+        }
         DR_LOG(log_debug) << "ClientController::removeAppTransaction: transactionId " << transactionId << "; size: " << m_mapAppTransactions.size()  ;
     }
     void ClientController::removeNetTransaction( const string& transactionId ) {
         std::lock_guard<std::mutex> l( m_lock ) ;
-        m_mapNetTransactions.erase( transactionId ) ;        
+        mapId2Client::iterator it = m_mapNetTransactions.find( transactionId ) ;
+        if( m_mapNetTransactions.end() != it ) {
+            client_ptr owner = it->second.lock() ;
+            if( owner ) owner->getOwnedIds().netTransactions.erase( transactionId ) ;
+            m_mapNetTransactions.erase( it ) ;
+        }
         DR_LOG(log_debug) << "ClientController::removeNetTransaction: transactionId " << transactionId << "; size: " << m_mapNetTransactions.size()  ;
     }
     void ClientController::removeApiRequest( const string& clientMsgId ) {
         std::lock_guard<std::mutex> l( m_lock ) ;
-        m_mapApiRequests.erase( clientMsgId ) ;   
+        mapId2Client::iterator it = m_mapApiRequests.find( clientMsgId ) ;
+        if( m_mapApiRequests.end() != it ) {
+            client_ptr owner = it->second.lock() ;
+            if( owner ) owner->getOwnedIds().apiRequests.erase( clientMsgId ) ;
+            m_mapApiRequests.erase( it ) ;
+        }
         DR_LOG(log_debug) << "ClientController::removeApiRequest: clientMsgId " << clientMsgId << "; size: " << m_mapApiRequests.size()  ;
     }
     void ClientController::addAppTransaction( client_ptr client, const string& transactionId ) {
         std::lock_guard<std::mutex> l( m_lock ) ;
-        m_mapAppTransactions.insert( make_pair( transactionId, client ) ) ;        
+        if( m_mapAppTransactions.insert( make_pair( transactionId, client ) ).second ) {
+            client->getOwnedIds().appTransactions.insert( transactionId ) ;
+        }
         DR_LOG(log_debug) << "ClientController::addAppTransaction: transactionId " << transactionId << "; size: " << m_mapAppTransactions.size()  ;
     }
     void ClientController::addNetTransaction( client_ptr client, const string& transactionId ) {
         std::lock_guard<std::mutex> l( m_lock ) ;
-        m_mapNetTransactions.insert( make_pair( transactionId, client ) ) ;        
+        if( m_mapNetTransactions.insert( make_pair( transactionId, client ) ).second ) {
+            client->getOwnedIds().netTransactions.insert( transactionId ) ;
+        }
         DR_LOG(log_debug) << "ClientController::addNetTransaction: transactionId " << transactionId << "; size: " << m_mapNetTransactions.size()  ;
     }
     void ClientController::addApiRequest( client_ptr client, const string& clientMsgId ) {
         std::lock_guard<std::mutex> l( m_lock ) ;
-        m_mapApiRequests.insert( make_pair( clientMsgId, client ) ) ;        
+        if( m_mapApiRequests.insert( make_pair( clientMsgId, client ) ).second ) {
+            client->getOwnedIds().apiRequests.insert( clientMsgId ) ;
+        }
         DR_LOG(log_debug) << "ClientController::addApiRequest: clientMsgId " << clientMsgId << "; size: " << m_mapApiRequests.size()  ;
     }
 
-    void ClientController::logStorageCount(bool bDetail) {
-        std::lock_guard<std::mutex> lock(m_lock) ;
+    unsigned int ClientController::getMaxOutstandingTransactions(void) {
+        std::lock_guard<std::mutex> l( m_lock ) ;
+        size_t most = 0 ;
+        for( auto& kv : m_request_types ) {
+            client_ptr client = kv.second.client() ;
+            if( client ) most = std::max( most, client->getOwnedIds().netTransactions.size() ) ;
+        }
+        return most ;
+    }
 
-        DR_LOG(bDetail ? log_info : log_debug) << "ClientController storage counts"  ;
-        DR_LOG(bDetail ? log_info : log_debug) << "----------------------------------"  ;
-        DR_LOG(bDetail ? log_info : log_debug) << "m_clients size:                                                  " << m_clients.size()  ;
-        DR_LOG(bDetail ? log_info : log_debug) << "m_services size:                                                 " << m_services.size()  ;
-        DR_LOG(bDetail ? log_info : log_debug) << "m_request_types size:                                            " << m_request_types.size()  ;
-        DR_LOG(bDetail ? log_info : log_debug) << "m_map_of_request_type_offsets size:                              " << m_map_of_request_type_offsets.size()  ;
-        DR_LOG(bDetail ? log_info : log_debug) << "m_mapDialogs size:                                               " << m_mapDialogs.size()  ;
-        if (bDetail) {
-            for (const auto& kv : m_mapDialogs) {
-                DR_LOG(bDetail ? log_info : log_debug) << "    dialog id: " << std::hex << (kv.first).c_str();
+    unsigned int ClientController::releaseIds( mapId2Client& m, std::unordered_set<string>& ids, const client_ptr& client ) {
+        unsigned int count = 0 ;
+        for( const string& id : ids ) {
+            mapId2Client::iterator it = m.find( id ) ;
+            if( m.end() != it && it->second.lock() == client ) {
+                m.erase( it ) ;
+                count++ ;
             }
         }
+        ids.clear() ;
+        return count ;
+    }
+
+    void ClientController::releaseOwnedIds_nolock( client_ptr client ) {
+        BaseClient::OwnedIds_t& owned = client->getOwnedIds() ;
+
+        unsigned int nDialogs = releaseIds( m_mapDialogs, owned.dialogs, client ) ;
+        unsigned int nTransactions = releaseIds( m_mapAppTransactions, owned.appTransactions, client ) +
+            releaseIds( m_mapNetTransactions, owned.netTransactions, client ) ;
+        unsigned int nApiRequests = releaseIds( m_mapApiRequests, owned.apiRequests, client ) ;
 
-        DR_LOG(bDetail ? log_info : log_debug) << "m_mapNetTransactions size:                                       " << m_mapNetTransactions.size()  ;
-        if (bDetail) {
-            for (const auto& kv : m_mapNetTransactions) {
-                DR_LOG(bDetail ? log_info : log_debug) << "    transaction id: " << std::hex << (kv.first).c_str();
+        for( const string& verb : owned.verbs ) {
+            pair<map_of_request_types::iterator,map_of_request_types::iterator> range = m_request_types.equal_range( verb ) ;
+            for( map_of_request_types::iterator it = range.first; it != range.second; ) {
+                client_ptr c = it->second.client() ;
+                if( !c || c == client ) it = m_request_types.erase( it ) ;
+                else ++it ;
             }
         }
-        DR_LOG(bDetail ? log_info : log_debug) << "m_mapAppTransactions size:                                       " << m_mapAppTransactions.size()  ;
-        if (bDetail) {
-            for (const auto& kv : m_mapAppTransactions) {
-                DR_LOG(bDetail ? log_info : log_debug) << "    transaction id: " << std::hex << (kv.first).c_str();
+        owned.verbs.clear() ;
+        updateCdrSubscribers_nolock() ;
+
+        DR_LOG(log_debug) << "ClientController::releaseOwnedIds_nolock - released " << nDialogs << " dialogs, " << 
+            nTransactions << " transactions and " << nApiRequests << " api requests" ;
+    }
+
+    void ClientController::post(std::function<void()> fn) {
+        m_queueDepth++ ;
+        m_ioservice.post([this, fn = std::move(fn)]() {
+            m_queueDepth-- ;
+            if (!theOneAndOnlyController->getStatsCollector().enabled()) return fn() ;
+
+            auto start = std::chrono::steady_clock::now() ;
+            fn() ;
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start ;
+            STATS_HISTOGRAM_OBSERVE_NOCHECK(STATS_HISTOGRAM_APP_HANDLER_TIME, elapsed.count())
+        }) ;
+    }
+
+    void ClientController::logStorageCount(bool bDetail) {
+        size_t nClients, nServices, nRequestTypes, nRequestTypeOffsets, nOutboundPools ;
+        std::vector<string> dialogs, netTransactions, appTransactions, apiRequests, dialogAppnames ;
+        size_t nDialogs, nNetTransactions, nAppTransactions, nApiRequests, nDialogAppnames ;
+
+        // copy what we need under the lock, and do the (slow) logging after releasing it
+        {
+            std::lock_guard<std::mutex> lock(m_lock) ;
+            nClients = m_clients.size() ;
+            nServices = m_services.size() ;
+            nRequestTypes = m_request_types.size() ;
+            nRequestTypeOffsets = m_map_of_request_type_offsets.size() ;
+            nOutboundPools = m_mapOutboundPools.size() ;
+            nDialogs = m_mapDialogs.size() ;
+            nNetTransactions = m_mapNetTransactions.size() ;
+            nAppTransactions = m_mapAppTransactions.size() ;
+            nApiRequests = m_mapApiRequests.size() ;
+            nDialogAppnames = m_mapDialogId2Appname.size() ;
+            if (bDetail) {
+                for (const auto& kv : m_mapDialogs) dialogs.push_back(kv.first) ;
+                for (const auto& kv : m_mapNetTransactions) netTransactions.push_back(kv.first) ;
+                for (const auto& kv : m_mapAppTransactions) appTransactions.push_back(kv.first) ;
+                for (const auto& kv : m_mapApiRequests) apiRequests.push_back(kv.first) ;
+                for (const auto& kv : m_mapDialogId2Appname) dialogAppnames.push_back(kv.first) ;
             }
         }
-        DR_LOG(bDetail ? log_info : log_debug) << "m_mapApiRequests size:                                           " << m_mapApiRequests.size()  ;
-        if (bDetail) {
-            for (const auto& kv : m_mapApiRequests) {
-                DR_LOG(bDetail ? log_info : log_debug) << "    client msg id: " << std::hex << (kv.first).c_str();
-            }
+
+        DR_LOG(bDetail ? log_info : log_debug) << "ClientController storage counts"  ;
+        DR_LOG(bDetail ? log_info : log_debug) << "----------------------------------"  ;
+        DR_LOG(bDetail ? log_info : log_debug) << "m_clients size:                                                  " << nClients  ;
+        DR_LOG(bDetail ? log_info : log_debug) << "m_services size:                                                 " << nServices  ;
+        DR_LOG(bDetail ? log_info : log_debug) << "m_request_types size:                                            " << nRequestTypes  ;
+        DR_LOG(bDetail ? log_info : log_debug) << "m_map_of_request_type_offsets size:                              " << nRequestTypeOffsets  ;
+        DR_LOG(bDetail ? log_info : log_debug) << "m_mapDialogs size:                                               " << nDialogs  ;
+        DR_LOG(bDetail ? log_info : log_debug) << "m_mapOutboundPools size:                                         " << nOutboundPools  ;
+        DR_LOG(bDetail ? log_info : log_debug) << "m_mapDialogId2Appname size:                                      " << nDialogAppnames  ;
+        for (const auto& id : dialogs) {
+            DR_LOG(log_info) << "    dialog id: " << std::hex << id.c_str();
         }
-        DR_LOG(bDetail ? log_info : log_debug) << "m_mapDialogId2Appname size:                                      " << m_mapDialogId2Appname.size()  ;
-        if (bDetail) {
-            for (const auto& kv : m_mapDialogId2Appname) {
-                DR_LOG(bDetail ? log_info : log_debug) << "    dialog id: " << std::hex << (kv.first).c_str();
-            }
+
+        DR_LOG(bDetail ? log_info : log_debug) << "m_mapNetTransactions size:                                       " << nNetTransactions  ;
+        for (const auto& id : netTransactions) {
+            DR_LOG(log_info) << "    transaction id: " << std::hex << id.c_str();
+        }
+        DR_LOG(bDetail ? log_info : log_debug) << "m_mapAppTransactions size:                                       " << nAppTransactions  ;
+        for (const auto& id : appTransactions) {
+            DR_LOG(log_info) << "    transaction id: " << std::hex << id.c_str();
+        }
+        DR_LOG(bDetail ? log_info : log_debug) << "m_mapApiRequests size:                                           " << nApiRequests  ;
+        for (const auto& id : apiRequests) {
+            DR_LOG(log_info) << "    client msg id: " << std::hex << id.c_str();
+        }
+        DR_LOG(bDetail ? log_info : log_debug) << "m_mapDialogId2Appname size:                                      " << nDialogAppnames  ;
+        for (const auto& id : dialogAppnames) {
+            DR_LOG(log_info) << "    dialog id: " << std::hex << id.c_str();
         }
 
-        STATS_GAUGE_SET(STATS_GAUGE_CLIENT_APP_CONNECTIONS, m_clients.size())
+        STATS_GAUGE_SET(STATS_GAUGE_CLIENT_APP_CONNECTIONS, nClients)
 
     }
     std::shared_ptr<SipDialogController> ClientController::getDialogController(void) {
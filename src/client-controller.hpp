@@ -30,6 +30,12 @@ THE SOFTWARE.
 #include <unordered_map>
 #include <mutex>
 #include <thread>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <list>
 
 #include <sofia-sip/nta.h>
 #include <sofia-sip/sip.h>
@@ -68,6 +74,7 @@ namespace drachtio {
     void leave( client_ptr client ) ;
     void outboundFailed( const string& transactionId ) ;
     void outboundReady( client_ptr client, const string& transactionId ) ;
+    void pooledConnectionFailed( client_ptr client ) ;
 
     void addNamedService( client_ptr client, string& strAppName ) ;
 
@@ -90,6 +97,16 @@ namespace drachtio {
     client_ptr findClientForApiRequest( const string& clientMsgId ) ;
 
     void makeOutboundConnection( const string& transactionId, const string& host, const string& port, const string& transport ) ;
+
+    // tls sessions from outbound app connections, offered again on the next connection to the same host:port;
+    // key must remain valid for the life of the connection, as new sessions are stored under it once issued
+    void resumeTlsSession( SSL* ssl, const string& key ) ;
+    void storeTlsSession( const string& key, SSL_SESSION* session ) ;
+
+    typedef std::function<void(const boost::system::error_code&, const boost::asio::ip::tcp::resolver::results_type&)> resolve_handler ;
+
+    /* resolve host:port for an outbound connection without blocking the io thread; must be called on the io thread */
+    void resolveOutbound( const string& host, const string& port, resolve_handler handler ) ;
     void selectClientForTag(const string& transactionId, const string& tag);
 
     bool sendRequestInsideDialog( client_ptr client, const string& clientMsgId, const string& dialogId, const string& startLine, const string& headers, const string& body, string& transactionId ) ;
@@ -121,10 +138,34 @@ namespace drachtio {
 
     boost::asio::io_context& getIOService(void) { return m_ioservice ;}
 
+    /* run a handler on the io thread, tracking how many are waiting and how long each takes */
+    void post(std::function<void()> fn) ;
+    int getQueueDepth(void) { return m_queueDepth; }
+
+    /* bytes queued for writing to all apps */
+    void writeQueued( size_t bytes ) { m_pendingWriteBytes += bytes; }
+    void writeCompleted( size_t bytes ) { m_pendingWriteBytes -= bytes; }
+    uint64_t getPendingWriteBytes(void) { return m_pendingWriteBytes; }
+
+    /* whether any app has asked for cdrs; checked without the lock before a cdr is encoded */
+    bool hasCdrSubscribers(void) const { return m_bHasCdrSubscribers; }
+
+    /* most incoming transactions outstanding on any one app that is taking new requests */
+    unsigned int getMaxOutstandingTransactions(void) ;
+
     std::shared_ptr<SipDialogController> getDialogController(void) ;
 
     //void sendSipMessageToClient( client_ptr client, const string& transactionId, const string& rawSipMsg, const SipMsgData_t& meta );
 
+    // how an app is chosen among those that registered for a request type
+    enum SelectionPolicy_t {
+      selection_round_robin = 0,
+      selection_least_transactions,   // fewest outstanding incoming transactions
+      selection_least_write_bytes,    // least data queued to write to the app
+      selection_weighted,             // random, in proportion to the weight the app authenticated with
+      selection_power_of_two          // fewer outstanding transactions of two apps chosen at random
+    } ;
+
   protected:
 
     class RequestSpecifier {
@@ -148,12 +189,24 @@ namespace drachtio {
     void stop() ;
 
     client_ptr findClientForDialog_nolock( const string& dialogId ) ;
+    void releaseOwnedIds_nolock( client_ptr client ) ;
+    void updateCdrSubscribers_nolock(void) ;
+
+    void resolveComplete( const string& key, const boost::system::error_code& ec, const boost::asio::ip::tcp::resolver::results_type& results ) ;
+
+    client_ptr connectOutbound( const string& transactionId, const string& host, const string& port, const string& transport, const string& poolKey ) ;
+    void removePooledConnection( client_ptr client ) ;
+    void sweepOutboundPools( const boost::system::error_code& ec ) ;
+    void reportOutboundPoolStats(void) ;
 
     DrachtioController*         m_pController ;
     std::thread                 m_thread ;
     std::mutex                m_lock ;
 
     boost::asio::io_context m_ioservice;
+    std::atomic<int>        m_queueDepth ;
+    std::atomic<uint64_t>   m_pendingWriteBytes ;
+    std::atomic<bool>       m_bHasCdrSubscribers ;
     boost::asio::ip::tcp::endpoint  m_endpoint_tcp;
     boost::asio::ip::tcp::acceptor  m_acceptor_tcp ;
     boost::asio::ip::tcp::endpoint  m_endpoint_tls;
@@ -173,7 +226,14 @@ namespace drachtio {
     typedef std::unordered_map<string,unsigned int> map_of_request_type_offsets ;
     map_of_request_type_offsets m_map_of_request_type_offsets ;
 
+    SelectionPolicy_t m_selectionPolicy ;
+
+    // scratch space for selectClientForRequestOutsideDialog, reused under m_lock to avoid allocating per request
+    string m_selectionVerb ;
+    std::vector<client_ptr> m_selectionCandidates ;
+
     typedef std::unordered_map<string,client_weak_ptr> mapId2Client ;
+    static unsigned int releaseIds( mapId2Client& m, std::unordered_set<string>& ids, const client_ptr& client ) ;
     mapId2Client m_mapDialogs ;
     mapId2Client m_mapAppTransactions ;
     mapId2Client m_mapNetTransactions ;
@@ -181,6 +241,44 @@ namespace drachtio {
 
     typedef std::unordered_map<string,string> mapDialogId2Appname ;
     mapDialogId2Appname m_mapDialogId2Appname ;
+
+    // outbound connection dns results, keyed by host:port; only accessed on the io thread
+    struct ResolvedAddress_t {
+      boost::asio::ip::tcp::resolver::results_type results ;
+      std::chrono::steady_clock::time_point expires ;
+    } ;
+    typedef std::unordered_map<string,ResolvedAddress_t> mapHostPort2Resolved ;
+    mapHostPort2Resolved m_mapResolved ;
+
+    // lookups in progress; concurrent requests for the same host:port wait on a single lookup
+    struct PendingResolve_t {
+      std::shared_ptr<boost::asio::ip::tcp::resolver> resolver ;
+      std::shared_ptr<boost::asio::steady_timer> timer ;
+      std::vector<resolve_handler> handlers ;
+    } ;
+    typedef std::unordered_map<string,PendingResolve_t> mapHostPort2PendingResolve ;
+    mapHostPort2PendingResolve m_mapPendingResolves ;
+
+    // authenticated outbound connections waiting for a request, keyed by transport:host:port; only accessed on the io thread
+    struct OutboundPool_t {
+      string host ;
+      string port ;
+      string transport ;
+      std::deque< std::pair<client_ptr, std::chrono::steady_clock::time_point> > idle ;
+      std::unordered_set<client_ptr> connecting ;
+      unsigned int target ;
+      std::chrono::steady_clock::time_point lastUsed ;
+    } ;
+    typedef std::unordered_map<string,OutboundPool_t> mapPoolKey2OutboundPool ;
+    mapPoolKey2OutboundPool m_mapOutboundPools ;
+    boost::asio::steady_timer m_poolTimer ;
+    bool m_bPoolTimerArmed ;
+
+    // outbound tls sessions for resumption, keyed by host:port, most recently stored first
+    typedef std::list< pair<string, std::shared_ptr<SSL_SESSION> > > TlsSessionLru_t ;
+    typedef std::unordered_map< string, TlsSessionLru_t::iterator > mapHostPort2TlsSession ;
+    TlsSessionLru_t m_tlsSessionLru ;
+    mapHostPort2TlsSession m_mapTlsSessions ;
       
   } ;
 
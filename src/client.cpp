@@ -92,20 +92,34 @@ namespace drachtio {
     // BaseClient
     BaseClient::BaseClient(ClientController& controller) :
         m_controller( controller ),  
-        m_state(initial), m_buffer(12228), m_nMessageLength(0) {
+        m_state(initial), m_framing(framing_text), m_buffer(12228), m_nMessageLength(0), m_weight(1), m_pendingWriteBytes(0), 
+        m_bOutbound(false) {
             time(&m_tConnect);
     }
     BaseClient::BaseClient(ClientController& controller, 
         const string& transactionId, 
         const string& host, const string& port) :
         m_controller( controller ), 
-        m_transactionId(transactionId), m_host(host), m_port(port),
-        m_state(initial), m_buffer(12228), m_nMessageLength(0) {
+        m_bOutbound(true), m_transactionId(transactionId), m_host(host), m_port(port),
+        m_state(initial), m_framing(framing_text), m_buffer(12228), m_nMessageLength(0), m_weight(1), m_pendingWriteBytes(0) {
             time(&m_tConnect);
     }
 
+    void BaseClient::writeQueued( size_t bytes ) {
+        m_pendingWriteBytes += bytes ;
+        m_controller.writeQueued( bytes ) ;
+    }
+    void BaseClient::writeCompleted( size_t bytes ) {
+        m_pendingWriteBytes -= bytes ;
+        m_controller.writeCompleted( bytes ) ;
+    }
+
     BaseClient::~BaseClient() {
       DR_LOG(log_debug) << "BaseClient::~BaseClient";
+
+      // anything still counted was queued but never written; give it back to the global backlog
+      uint64_t pending = m_pendingWriteBytes ;
+      if( pending ) m_controller.writeCompleted( pending ) ;
     }
 
     std::shared_ptr<SipDialogController> BaseClient::getDialogController() {
@@ -119,8 +133,29 @@ namespace drachtio {
         vector<string>tokens ;
         splitTokens( meta, tokens) ;
 
+        return processClientMessage( tokens, startLine, headers, body, msgResponse ) ;
+    }
+
+    bool BaseClient::processClientMessage( const AppFrame& frame, string& msgResponse ) {
+        vector<string> tokens ;
+        string msgId, sipMsg, startLine, headers, body ;
+
+        if( AppFrame::MSG_REQUEST != frame.getType() || !frame.get( AppFrame::FIELD_MSG_ID, msgId ) ) {
+            DR_LOG(log_error) << "Client::processClientMessage - invalid binary message of type " << frame.getType() ;
+            return false ;
+        }
+        tokens.push_back( msgId ) ;
+        frame.getAll( AppFrame::FIELD_TOKEN, tokens ) ;
+        if( frame.get( AppFrame::FIELD_SIP, sipMsg ) ) splitSipMsg( sipMsg, startLine, headers, body ) ;
+
+        return processClientMessage( tokens, startLine, headers, body, msgResponse ) ;
+    }
+
+    bool BaseClient::processClientMessage( vector<string>& tokens, const string& startLine, const string& headers, const string& body, 
+        string& msgResponse ) {
+
         if( tokens.size() < 2 ) {
-            DR_LOG(log_error) << "Client::processClientMessage - invalid message: " << msg  ;
+            DR_LOG(log_error) << "Client::processClientMessage - invalid message: " << boost::algorithm::join(tokens, "|")  ;
             createResponseMsg( tokens[0], msgResponse, false, "Invalid message format" ) ;
             return false ;
         }
@@ -147,14 +182,25 @@ namespace drachtio {
         }
         else if( 0 == tokens[1].compare("authenticate")) {
             string secret = tokens[2] ;
-            if (tokens.size() > 3) {
-                string tags = tokens[3];
-                vector<string> strs;
-                boost::split(strs, tags, boost::is_any_of(","));
-                for (vector<string>::iterator it = strs.begin(); it != strs.end(); ++it) {
-                    m_tags.insert(*it);
+            bool bBinaryFraming = false ;
+            for (unsigned int i = 3; i < tokens.size(); i++) {
+                if (0 == tokens[i].compare("framing=binary")) {
+                    bBinaryFraming = true ;
+                }
+                else if (0 == tokens[i].find("weight=")) {
+                    int weight = ::atoi(tokens[i].c_str() + 7) ;
+                    m_weight = weight > 0 ? weight : 1 ;
+                    DR_LOG(log_debug) << "Client::processAuthentication - client weight " << m_weight ;
+                }
+                else if (3 == i && !tokens[i].empty()) {
+                    string tags = tokens[3];
+                    vector<string> strs;
+                    boost::split(strs, tags, boost::is_any_of(","));
+                    for (vector<string>::iterator it = strs.begin(); it != strs.end(); ++it) {
+                        m_tags.insert(*it);
+                    }
+                    DR_LOG(log_debug) << "Client::processAuthentication - added tags " << tags ;
                 }
-                DR_LOG(log_debug) << "Client::processAuthentication - added tags " << tags ;
             }
             DR_LOG(log_debug) << "Client::processAuthentication - validating secret " << secret  ;
             if( !theOneAndOnlyController->isSecret( secret ) ) {
@@ -169,6 +215,12 @@ namespace drachtio {
                 string hostports = boost::algorithm::join(hps, ",") ;
                 string localHostports = boost::algorithm::join(local_hps, ",") ;
                 string response = hostports + "|" + DRACHTIO_VERSION + "|" + localHostports ;
+                if (bBinaryFraming) {
+                    // the response itself still goes out as text, so clients can tell whether we understood the request
+                    DR_LOG(log_debug) << "Client::processAuthentication - client requested binary framing" ;
+                    response += "|framing=binary" ;
+                    m_framing = framing_binary_accepted ;
+                }
                 createResponseMsg( tokens[0], msgResponse, true, response.c_str()) ;
                 DR_LOG(log_debug) << "Client::processAuthentication - secret validated successfully: " << secret ;
                 return true ;
@@ -257,6 +309,11 @@ namespace drachtio {
         return true ;
     }
 
+    void BaseClient::outboundFailed() {
+        if( isPooled() ) m_controller.pooledConnectionFailed( shared_from_this() ) ;
+        else m_controller.outboundFailed( m_transactionId ) ;
+    }
+
     bool BaseClient::readMessageLength(unsigned int& len) {
         bool continueOn = true ;
         std::array<char, 6> ch ;
@@ -291,16 +348,48 @@ namespace drachtio {
     void BaseClient::sendSipMessageToClient( const string& transactionId, const string& dialogId, const string& rawSipMsg, const SipMsgData_t& meta ) {
         string strUuid, s ;
         generateUuid( strUuid ) ;
+
+        if( framing_binary == m_framing ) {
+            AppFrame frame( AppFrame::MSG_SIP ) ;
+            frame.add( AppFrame::FIELD_MSG_ID, strUuid ) ;
+            frame.addMeta( meta ) ;
+            frame.add( AppFrame::FIELD_TRANSACTION_ID, transactionId ) ;
+            frame.add( AppFrame::FIELD_DIALOG_ID, dialogId ) ;
+            frame.add( AppFrame::FIELD_SIP, rawSipMsg ) ;
+            frame.encode( s ) ;
+            return send( s ) ;
+        }
+
         meta.toMessageFormat(s) ;
 
         send(strUuid + "|sip|" + s + "|" + transactionId + "|" + dialogId + "|" + DR_CRLF + rawSipMsg) ;
     }
 
     void BaseClient::sendSipMessageToClient( const string& transactionId, const string& rawSipMsg, const SipMsgData_t& meta ) {
-        string strUuid, s ;
+        RequestTracer& tracer = theOneAndOnlyController->getRequestTracer() ;
+        tracer.mark( transactionId, RequestTracer::STAGE_DISPATCHED ) ;
+
+        string strUuid, s, strMsg ;
         generateUuid( strUuid ) ;
+
+        if( framing_binary == m_framing ) {
+            AppFrame frame( AppFrame::MSG_SIP ) ;
+            frame.add( AppFrame::FIELD_MSG_ID, strUuid ) ;
+            frame.addMeta( meta ) ;
+            frame.add( AppFrame::FIELD_TRANSACTION_ID, transactionId ) ;
+            if (meta.getDestAddress().length() > 0) {
+                frame.add( AppFrame::FIELD_DEST_ADDRESS, meta.getDestAddress() ) ;
+                frame.add( AppFrame::FIELD_DEST_PORT, static_cast<uint64_t>( ::strtoul( meta.getDestPort().c_str(), NULL, 10 ) ) ) ;
+            }
+            frame.add( AppFrame::FIELD_SIP, rawSipMsg ) ;
+            frame.encode( strMsg ) ;
+            if (tracer.enabled()) send(strMsg, transactionId) ;
+            else send(strMsg) ;
+            return ;
+        }
+
         meta.toMessageFormat(s) ;
-        string strMsg = strUuid + "|sip|" + s + "|" + transactionId + "||" ;
+        strMsg = strUuid + "|sip|" + s + "|" + transactionId + "||" ;
         if (meta.getDestAddress().length() > 0) {
             strMsg += meta.getDestAddress();
             strMsg += "|";
@@ -311,19 +400,46 @@ namespace drachtio {
         strMsg += rawSipMsg;
 
         //send(strUuid + "|sip|" + s + "|" + transactionId + "||" + DR_CRLF + rawSipMsg) ;
-        send(strMsg) ;
+        if (tracer.enabled()) send(strMsg, transactionId) ;
+        else send(strMsg) ;
     }
 
     void BaseClient::sendCdrToClient( const string& rawSipMsg, const string& meta ) {
         string strUuid, s ;
         generateUuid( strUuid ) ;
 
+        if( framing_binary == m_framing ) {
+            AppFrame frame( AppFrame::MSG_CDR ) ;
+            frame.add( AppFrame::FIELD_MSG_ID, strUuid ) ;
+            frame.add( AppFrame::FIELD_CDR_META, meta ) ;
+            frame.add( AppFrame::FIELD_SIP, rawSipMsg ) ;
+            frame.encode( s ) ;
+            return send( s ) ;
+        }
+
         send(strUuid + "|" + meta + DR_CRLF + rawSipMsg) ;
     }
 
+    // each entry is cdr metadata and the encoded sip message
+    void BaseClient::sendCdrsToClient( std::shared_ptr< const std::vector< std::pair<string, string> > > cdrs ) {
+        for( const auto& cdr : *cdrs ) sendCdrToClient( cdr.second, cdr.first ) ;
+    }
+
     void BaseClient::sendApiResponseToClient( const string& clientMsgId, const string& responseText, const string& additionalResponseText ) {
         string strUuid ;
         generateUuid( strUuid ) ;
+
+        if( framing_binary == m_framing ) {
+            string msg ;
+            AppFrame frame( AppFrame::MSG_RESPONSE ) ;
+            frame.add( AppFrame::FIELD_MSG_ID, strUuid ) ;
+            frame.add( AppFrame::FIELD_IN_REPLY_TO, clientMsgId ) ;
+            frame.add( AppFrame::FIELD_STATUS, responseText ) ;
+            if( !additionalResponseText.empty() ) frame.add( AppFrame::FIELD_DATA, additionalResponseText ) ;
+            frame.encode( msg ) ;
+            return send( msg ) ;
+        }
+
         string msg = strUuid + "|response|" + clientMsgId + "|" ;
         msg.append( responseText ) ;
         if( !additionalResponseText.empty() ) {
@@ -336,6 +452,16 @@ namespace drachtio {
     void BaseClient::createResponseMsg(const string& msgId, string& msg, bool ok, const char* szReason ) {
         string strUuid ;
         generateUuid( strUuid ) ;
+
+        if( framing_binary == m_framing ) {
+            AppFrame frame( AppFrame::MSG_RESPONSE ) ;
+            frame.add( AppFrame::FIELD_MSG_ID, strUuid ) ;
+            frame.add( AppFrame::FIELD_IN_REPLY_TO, msgId ) ;
+            frame.add( AppFrame::FIELD_STATUS, string( ok ? "OK" : "NO" ) ) ;
+            if( szReason ) frame.add( AppFrame::FIELD_DATA, string( szReason ) ) ;
+            frame.encode( msg ) ;
+            return ;
+        }
         msg = strUuid + "|response|" + msgId + "|" ;
         msg.append( ok ? "OK" : "NO") ;
         if( szReason ) {
@@ -344,22 +470,73 @@ namespace drachtio {
         }
     }
 
+    bool BaseClient::processBinaryFrames() {
+        while( !m_buffer.empty() ) {
+            AppFrame frame ;
+            size_t frameLen = 0 ;
+            AppFrame::ParseResult_t rc = AppFrame::parse( m_buffer.linearize(), m_buffer.size(), frame, frameLen ) ;
+            if( AppFrame::PARSE_INCOMPLETE == rc ) {
+                // make room for the rest of a frame larger than the buffer
+                if( m_buffer.full() ) m_buffer.set_capacity( std::min( m_buffer.capacity() * 2, AppFrame::MAX_PAYLOAD_LEN + 16 ) ) ;
+                break ;
+            }
+            if( AppFrame::PARSE_ERROR == rc ) {
+                DR_LOG(log_error) << "Client::processBinaryFrames - client sent an invalid binary frame"  ;
+                m_controller.leave( shared_from_this() ) ;
+                return false ;
+            }
+            m_buffer.erase_begin( frameLen ) ;
+
+            string msgResponse ;
+            bool bContinue = true ;
+            try {
+                bContinue = processClientMessage( frame, msgResponse ) ;
+            } catch( std::runtime_error& err ) {
+                DR_LOG(log_error) << "Client::processBinaryFrames - Error processing client message: " << err.what()  ;
+                m_controller.leave( shared_from_this() ) ;
+                return false ;
+            }
+            if( !msgResponse.empty() ) send( msgResponse ) ;
+            if( !bContinue ) {
+                DR_LOG(log_error) << "Client::processBinaryFrames - disconnecting client due to error processing client message" ;
+                m_controller.leave( shared_from_this() ) ;
+                return false ;
+            }
+        }
+        return true ;
+    }
+
     // Client (member functions)
 
     template<typename T, typename S>
     void Client<T,S>::read_handler( const boost::system::error_code& ec, std::size_t bytes_transferred ) {
 
         if( ec ) {
-            DR_LOG(log_error) << "Client::read_handler - bouncing client due to error reading: " << ec ;
+            if( boost::asio::error::operation_aborted == ec ) {
+                DR_LOG(log_debug) << "Client::read_handler - connection closed locally" ;
+            }
+            else {
+                DR_LOG(log_error) << "Client::read_handler - bouncing client due to error reading: " << ec ;
+            }
             m_controller.leave( shared_from_this() ) ;
             return ;
         }
 
+        if (theOneAndOnlyController->getRequestTracer().enabled()) RequestTracer::arrived() ;
+
         //DR_LOG(log_debug) << "Client::read_handler read raw message of " << bytes_transferred << " bytes: " << std::string(m_readBuf.begin(), m_readBuf.begin() + bytes_transferred) << endl ;
 
         /* append the data to our in-process buffer */
+        if( framing_binary == m_framing && m_buffer.reserve() < bytes_transferred ) {
+            m_buffer.set_capacity( m_buffer.size() + bytes_transferred ) ;
+        }
         m_buffer.insert( m_buffer.end(), m_readBuf.begin(),  m_readBuf.begin() + bytes_transferred ) ;
 
+        if( framing_binary == m_framing ) {
+            if( !processBinaryFrames() ) return ;
+            goto read_again ;
+        }
+
         /* if we're starting a new message, parse the message length */
         if( 0 == m_nMessageLength ) {
 
@@ -392,19 +569,7 @@ namespace drachtio {
             }
 
             /* send response if indicated */
-            if( !msgResponse.empty() ) {
-                int len = std::size(msgResponse);
-                auto forthelifeofsend = std::make_shared<std::string>(
-                    std::to_string(len) + std::string("#") + msgResponse
-                );
-
-                auto self(shared_from_this());
-                DR_LOG(log_debug) << "Sending response: " << *forthelifeofsend << endl ;
-                boost::asio::async_write( m_sock, boost::asio::buffer( *forthelifeofsend ), 
-                    [self, forthelifeofsend](const boost::system::error_code& ec, std::size_t bytes_transferred) {
-                        DR_LOG(log_debug) << "Client::read_handler - wrote " << bytes_transferred << " bytes: " << ec  ;
-                    } );
-            }
+            if( !msgResponse.empty() ) send( msgResponse ) ;
             if( !bContinue ) {
                  DR_LOG(log_error) << "Client::read_handler - disconnecting client due to error processing client message" ;
                 m_controller.leave( shared_from_this() ) ;
@@ -418,6 +583,14 @@ namespace drachtio {
 
             /* reload for next message */
             m_buffer.erase_begin( m_nMessageLength ) ;
+
+            /* the app asked for binary framing at authenticate: everything after that response is binary */
+            if( framing_binary_accepted == m_framing ) {
+                m_framing = framing_binary ;
+                m_nMessageLength = 0 ;
+                if( !processBinaryFrames() ) return ;
+                break ;
+            }
             if( m_buffer.size() ) {
                 DR_LOG(log_debug) << "Client::read_handler processing follow-on message in read buffer, remaining bytes to process: " << m_buffer.size()  ;
                 try {
@@ -444,6 +617,12 @@ read_again:
        
     }
 
+    template<typename T, typename S>
+    void Client<T,S>::close() {
+        boost::system::error_code ec ;
+        m_sock.lowest_layer().close( ec ) ;
+    }
+
     template<typename T, typename S>
     void Client<T,S>::write_handler( const boost::system::error_code& ec, std::size_t bytes_transferred ) {
         DR_LOG(log_debug) << "Client::write_handler - wrote " << bytes_transferred << " bytes: " << ec  ;
@@ -451,6 +630,11 @@ read_again:
 
     template<typename T, typename S>
     void Client<T,S>::send( const string& str ) {
+        send( str, string() ) ;
+    }
+
+    template<typename T, typename S>
+    void Client<T,S>::send( const string& str, const string& transactionId ) {
         int len = std::size(str);
 
         if (0 == len) {
@@ -458,15 +642,84 @@ read_again:
             return;
         }
 
-        auto forthelifeofsend = std::make_shared<std::string>(
-            std::to_string(len) + std::string("#") + str
-        );
+        if( theOneAndOnlyController->getAppBatchWindow() > 0 ) {
+            size_t nPrior = m_batch.length() ;
+            if( framing_binary != m_framing ) {
+                m_batch.append( std::to_string(len) ) ;
+                m_batch.push_back( '#' ) ;
+            }
+            m_batch.append( str ) ;
+            writeQueued( m_batch.length() - nPrior ) ;
+            m_batchCount++ ;
+            if( !transactionId.empty() ) m_batchTransactionIds.push_back( transactionId ) ;
+
+            if( m_batch.length() >= theOneAndOnlyController->getAppBatchMaxBytes() ) {
+                flushBatch() ;
+            }
+            else if( !m_bBatchTimerArmed ) {
+                auto self(shared_from_this());
+                m_bBatchTimerArmed = true ;
+                m_batchTimer.expires_after( std::chrono::milliseconds( theOneAndOnlyController->getAppBatchWindow() ) ) ;
+                m_batchTimer.async_wait( [this, self](const boost::system::error_code& ec) {
+                    m_bBatchTimerArmed = false ;
+                    flushBatch() ;
+                } ) ;
+            }
+            return ;
+        }
+
+        auto forthelifeofsend = framing_binary == m_framing ? std::make_shared<std::string>( str ) :
+            std::make_shared<std::string>( std::to_string(len) + std::string("#") + str ) ;
 
         auto self(shared_from_this());
         DR_LOG(log_debug) << "Sending: " << *forthelifeofsend << endl ;
+        writeQueued( forthelifeofsend->length() ) ;
         boost::asio::async_write( m_sock, boost::asio::buffer( *forthelifeofsend ), 
-            [self, forthelifeofsend](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+            [this, self, forthelifeofsend, transactionId](const boost::system::error_code& ec, std::size_t bytes_transferred) {
                 DR_LOG(log_debug) << "Client::send - wrote " << bytes_transferred << " bytes: " << ec  ;
+                writeCompleted( forthelifeofsend->length() ) ;
+                if (!ec && !transactionId.empty()) {
+                    theOneAndOnlyController->getRequestTracer().mark( transactionId, RequestTracer::STAGE_SENT ) ;
+                }
+            } );
+    }
+
+    template<typename T, typename S>
+    void Client<T,S>::flushBatch() {
+        // one write at a time; anything queued meanwhile goes out when it completes
+        if( m_bWriteInProgress || m_batch.empty() ) return ;
+
+        auto forthelifeofsend = std::make_shared<std::string>() ;
+        forthelifeofsend->swap( m_batch ) ;
+        auto transactionIds = std::make_shared< vector<string> >() ;
+        transactionIds->swap( m_batchTransactionIds ) ;
+
+        STATS_HISTOGRAM_OBSERVE(STATS_HISTOGRAM_APP_WRITE_BATCH, m_batchCount)
+        DR_LOG(log_debug) << "Client::flushBatch - sending " << m_batchCount << " messages in " << forthelifeofsend->length() << " bytes" ;
+        m_batchCount = 0 ;
+        m_bWriteInProgress = true ;
+
+        auto self(shared_from_this());
+        boost::asio::async_write( m_sock, boost::asio::buffer( *forthelifeofsend ), 
+            [this, self, forthelifeofsend, transactionIds](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+                DR_LOG(log_debug) << "Client::flushBatch - wrote " << bytes_transferred << " bytes: " << ec  ;
+                writeCompleted( forthelifeofsend->length() ) ;
+                m_bWriteInProgress = false ;
+                if( ec ) {
+                    // the connection is gone; whatever was batched meanwhile will never be written
+                    writeCompleted( m_batch.length() ) ;
+                    m_batch.clear() ;
+                    m_batchTransactionIds.clear() ;
+                    m_batchCount = 0 ;
+                    return ;
+                }
+
+                for( const string& transactionId : *transactionIds ) {
+                    theOneAndOnlyController->getRequestTracer().mark( transactionId, RequestTracer::STAGE_SENT ) ;
+                }
+
+                // the window already elapsed while we were writing, or the batch filled up
+                if( !m_bBatchTimerArmed || m_batch.length() >= theOneAndOnlyController->getAppBatchMaxBytes() ) flushBatch() ;
             } );
     }
 
@@ -475,7 +728,7 @@ read_again:
     template<>
     Client<socket_t>::Client(boost::asio::io_context& io_context, ClientController& controller) :
         BaseClient(controller),
-        m_sock(io_context) {
+        m_sock(io_context), m_batchTimer(io_context) {
     }
 
     template<>
@@ -483,7 +736,7 @@ read_again:
         const string& transactionId, const string& host, 
         const string& port ) :
         BaseClient(controller, transactionId, host, port),
-        m_sock(io_context) {
+        m_sock(io_context), m_batchTimer(io_context) {
 
     }
 
@@ -504,12 +757,17 @@ read_again:
 
     template<>
     void Client<socket_t>::async_connect() {
-        boost::asio::ip::tcp::resolver::query query(m_host, m_port) ;
-        boost::asio::ip::tcp::resolver resolver(m_controller.getIOService());
-        tcp::resolver::iterator endpointIterator = resolver.resolve(query);
-        tcp::endpoint endpoint = *endpointIterator;
+        std::shared_ptr<BaseClient> self = shared_from_this() ;
+        m_controller.resolveOutbound(m_host, m_port, [this, self](const boost::system::error_code& ec, const tcp::resolver::results_type& results) {
+            if( ec ) {
+                DR_LOG(log_warning) << "Client::async_connect tcp - unable to resolve " << m_host << ":" << m_port << ": " << ec.message() ;
+                return outboundFailed();
+            }
+            tcp::resolver::iterator endpointIterator = results.begin();
+            tcp::endpoint endpoint = *endpointIterator;
 
-        m_sock.async_connect(endpoint, std::bind(&BaseClient::connect_handler, shared_from_this(), std::placeholders::_1, ++endpointIterator));
+            m_sock.async_connect(endpoint, std::bind(&BaseClient::connect_handler, self, std::placeholders::_1, ++endpointIterator));
+        }) ;
     }
 
     template<>
@@ -539,7 +797,7 @@ read_again:
         else {
             // final failure
             DR_LOG(log_warning) << "Client::connect_handler tcp - unable to connect to " << m_host << ":" << m_port ;
-            m_controller.outboundFailed(m_transactionId);
+            outboundFailed();
         }
     }
 
@@ -548,14 +806,14 @@ read_again:
     template<>
     Client<ssl_socket_t, ssl_socket_t::lowest_layer_type>::Client(boost::asio::io_context& io_context, boost::asio::ssl::context& context, ClientController& controller) :
         BaseClient(controller),
-        m_sock(io_context, context) {
+        m_sock(io_context, context), m_batchTimer(io_context) {
     }
 
     template<>
     Client<ssl_socket_t, ssl_socket_t::lowest_layer_type>::Client( boost::asio::io_context& io_context, boost::asio::ssl::context& context, ClientController& controller,
         const string& transactionId, const string& host, const string& port ) :
         BaseClient(controller, transactionId, host, port),
-        m_sock(io_context, context) {
+        m_sock(io_context, context), m_batchTimer(io_context) {
 
         m_sock.set_verify_mode(boost::asio::ssl::verify_none);
     }
@@ -568,6 +826,7 @@ read_again:
 
         setTcpKeepAlive(m_sock.lowest_layer().native_handle());
 
+        m_tHandshakeStart = std::chrono::steady_clock::now() ;
         m_sock.async_handshake(boost::asio::ssl::stream_base::server,
             std::bind(&BaseClient::handle_handshake, shared_from_this(),
             std::placeholders::_1));
@@ -575,12 +834,17 @@ read_again:
 
     template<>
     void Client<ssl_socket_t, ssl_socket_t::lowest_layer_type>::async_connect() {
-        boost::asio::ip::tcp::resolver::query query(m_host, m_port) ;
-        boost::asio::ip::tcp::resolver resolver(m_controller.getIOService());
-        tcp::resolver::iterator endpointIterator = resolver.resolve(query);
-        tcp::endpoint endpoint = *endpointIterator;
+        std::shared_ptr<BaseClient> self = shared_from_this() ;
+        m_controller.resolveOutbound(m_host, m_port, [this, self](const boost::system::error_code& ec, const tcp::resolver::results_type& results) {
+            if( ec ) {
+                DR_LOG(log_warning) << "Client::async_connect tls - unable to resolve " << m_host << ":" << m_port << ": " << ec.message() ;
+                return outboundFailed();
+            }
+            tcp::resolver::iterator endpointIterator = results.begin();
+            tcp::endpoint endpoint = *endpointIterator;
 
-        m_sock.lowest_layer().async_connect(endpoint, std::bind(&BaseClient::connect_handler, shared_from_this(), std::placeholders::_1, ++endpointIterator));
+            m_sock.lowest_layer().async_connect(endpoint, std::bind(&BaseClient::connect_handler, self, std::placeholders::_1, ++endpointIterator));
+        }) ;
     }
 
     template<>
@@ -590,11 +854,16 @@ read_again:
                 ":" << m_sock.lowest_layer().remote_endpoint().port() ;
 
             m_controller.join( shared_from_this() ) ;
+
+            // offer the session from our last connection to this app, if we have one
+            m_tlsSessionKey = m_host + ":" + m_port ;
+            m_controller.resumeTlsSession( m_sock.native_handle(), m_tlsSessionKey ) ;
+
+            m_tHandshakeStart = std::chrono::steady_clock::now() ;
             m_sock.async_handshake(boost::asio::ssl::stream_base::client, std::bind(&BaseClient::handle_handshake, shared_from_this(), std::placeholders::_1));
         }
         else if( endpointIterator != tcp::resolver::iterator() ) {
-            DR_LOG(log_debug) << "Client::connect_handler tls - failed to connect to "  << m_sock.lowest_layer().remote_endpoint().address().to_string() << 
-                ":" << m_sock.lowest_layer().remote_endpoint().port() ;
+            DR_LOG(log_debug) << "Client::connect_handler tls - failed to connect to " << m_host << ":" << m_port << ", trying next address" ;
             m_sock.lowest_layer().close() ;
             tcp::endpoint endpoint = *endpointIterator;
             m_sock.lowest_layer().async_connect(endpoint, std::bind(&BaseClient::connect_handler, shared_from_this(), std::placeholders::_1, ++endpointIterator));
@@ -602,18 +871,25 @@ read_again:
         else {
             // final failure
             DR_LOG(log_warning) << "Client::connect_handler tls - unable to connect to " << m_host << ":" << m_port ;
-            m_controller.outboundFailed(m_transactionId);
+            outboundFailed();
         }
     }
 
     template<>
     void Client<ssl_socket_t, ssl_socket_t::lowest_layer_type>::handle_handshake(const boost::system::error_code& ec) {
+        const char* direction = isOutbound() ? "outbound" : "inbound" ;
         if (!ec) {
-            DR_LOG(log_debug) << "Client::handle_handshake - TLS handshake succeeded ";
+            bool resumed = SSL_session_reused( m_sock.native_handle() ) ;
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_tHandshakeStart ;
+            DR_LOG(log_debug) << "Client::handle_handshake - TLS handshake succeeded (" << (resumed ? "resumed" : "full") << 
+                ") in " << elapsed.count() << " secs";
+            STATS_COUNTER_INCREMENT(STATS_COUNTER_APP_TLS_HANDSHAKES, {{"direction", direction}, {"type", resumed ? "resumed" : "full"}})
+            STATS_HISTOGRAM_OBSERVE(STATS_HISTOGRAM_APP_TLS_HANDSHAKE_TIME, elapsed.count(), {{"direction", direction}, {"type", resumed ? "resumed" : "full"}})
             m_sock.async_read_some(boost::asio::buffer(m_readBuf),
                 std::bind( &BaseClient::read_handler, shared_from_this(), std::placeholders::_1, std::placeholders::_2 ) ) ;
         }
         else {
+            STATS_COUNTER_INCREMENT(STATS_COUNTER_APP_TLS_HANDSHAKES, {{"direction", direction}, {"type", "failed"}})
             m_controller.leave( shared_from_this() ) ;
             DR_LOG(log_error) << "Client::handle_handshake - TLS handshake failed: " << ec.message() << " (" << ec << ")" ;
         }
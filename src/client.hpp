@@ -26,11 +26,15 @@ THE SOFTWARE.
 #include <unordered_set>
 #include <array>
 #include <thread>
+#include <chrono>
+#include <atomic>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/circular_buffer.hpp>
 
+#include "app-frame.hpp"
+
 #include <time.h>
 
 namespace drachtio {
@@ -61,34 +65,74 @@ namespace drachtio {
 
         virtual void handle_handshake(const boost::system::error_code& ec) = 0;
 
+        virtual void close() = 0;
+
 
         bool processClientMessage( const string& msg, string& msgResponse ) ;
+        bool processClientMessage( const AppFrame& frame, string& msgResponse ) ;
         void sendSipMessageToClient( const string& transactionId, const string& dialogId, const string& rawSipMsg, const SipMsgData_t& meta ) ;
         void sendSipMessageToClient( const string& transactionId, const string& rawSipMsg, const SipMsgData_t& meta ) ;
         void sendCdrToClient( const string& rawSipMsg, const string& meta ) ;
+        void sendCdrsToClient( std::shared_ptr< const std::vector< std::pair<string, string> > > cdrs ) ;
         void sendApiResponseToClient( const string& clientMsgId, const string& responseText, const string& additionalResponseText ) ;
 
         bool getAppName( string& strAppName ) { strAppName = m_strAppName; return !strAppName.empty(); }
-        bool isOutbound(void) const { return !m_transactionId.empty(); }
+        bool isOutbound(void) const { return m_bOutbound; }
+
+        // outbound connections opened ahead of time sit in a pool until handed a request
+        bool isPooled(void) const { return !m_poolKey.empty(); }
+        const string& getPoolKey(void) const { return m_poolKey; }
+        void setPoolKey(const string& poolKey) { m_poolKey = poolKey; }
+        void assignTransaction(const string& transactionId) { m_transactionId = transactionId; m_poolKey.clear(); }
         bool hasTag(const char* tag) const { return m_tags.find(tag) != m_tags.end(); }
 
+        // load indicators used when selecting an app for a new request
+        unsigned int getWeight(void) const { return m_weight; }
+        uint64_t getPendingWriteBytes(void) const { return m_pendingWriteBytes; }
+
         int getConnectionDuration(void) const { 
             return time(NULL) - m_tConnect; 
         }
+
+        // ids this client owns in the ClientController maps, so they can all be released when it leaves;
+        // guarded by the ClientController lock
+        struct OwnedIds_t {
+            std::unordered_set<string> dialogs ;
+            std::unordered_set<string> appTransactions ;
+            std::unordered_set<string> netTransactions ;
+            std::unordered_set<string> apiRequests ;
+            std::unordered_set<string> verbs ;
+        } ;
+        OwnedIds_t& getOwnedIds(void) { return m_ownedIds; }
     protected:
         virtual void send( const string& str ) = 0 ;  
+        virtual void send( const string& str, const string& transactionId ) = 0 ;  
 
         enum state {
             initial = 0,
             authenticated,
         } ;
+
+        enum framing {
+            framing_text = 0,
+            framing_binary_accepted,    // switches to binary once the authenticate response is sent
+            framing_binary
+        } ;
+
+        bool processClientMessage( vector<string>& tokens, const string& startLine, const string& headers, const string& body, 
+            string& msgResponse ) ;
+        bool processBinaryFrames(void) ;
     
         bool readMessageLength( unsigned int& len ) ;
+        void writeQueued( size_t bytes ) ;
+        void writeCompleted( size_t bytes ) ;
+        void outboundFailed(void) ;
         void createResponseMsg( const string& msgId, string& msg, bool ok = true, const char* szReason = NULL ) ;
         std::shared_ptr<SipDialogController> getDialogController(void);
 
         ClientController& m_controller ;
         state m_state ;
+        framing m_framing ;
 
         std::array<char, 8192> m_readBuf ;
         boost::circular_buffer<char> m_buffer ;
@@ -98,15 +142,25 @@ namespace drachtio {
         typedef std::unordered_set<string> set_of_tags ;
         set_of_tags m_tags;
 
+        unsigned int m_weight ;
+        std::atomic<uint64_t> m_pendingWriteBytes ;
+
         // outbound connections
+        bool m_bOutbound ;
         string m_transactionId ;
         string m_host ;
         string m_port ;
+        string m_poolKey ;
+        string m_tlsSessionKey ;
+
+        std::chrono::steady_clock::time_point m_tHandshakeStart ;
 
         string m_strRemoteAddress;
         unsigned int m_nRemotePort;
 
         time_t m_tConnect ;
+
+        OwnedIds_t m_ownedIds ;
     };
 
 	template <typename T, typename S = T> 
@@ -130,15 +184,27 @@ namespace drachtio {
 
         void handle_handshake(const boost::system::error_code& ec);
 
+        void close();
+
         void start(); 
 
         T& socket() { return m_sock; }
 
     protected:
         void send( const string& str );  
+        void send( const string& str, const string& transactionId );  
+        void flushBatch(void) ;
 
         T m_sock;
 
+        // messages held for a single write when batching is enabled
+        boost::asio::steady_timer m_batchTimer ;
+        bool m_bBatchTimerArmed = false ;
+        bool m_bWriteInProgress = false ;
+        string m_batch ;
+        unsigned int m_batchCount = 0 ;
+        vector<string> m_batchTransactionIds ;
+
     private:
         Client();  // prohibited
 
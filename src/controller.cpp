@@ -115,6 +115,9 @@ namespace {
     void watchdogTimerHandler(su_root_magic_t *p, su_timer_t *timer, su_timer_arg_t *arg) {
         theOneAndOnlyController->processWatchdogTimer() ;
     }
+    void loopTimerHandler(su_root_magic_t *p, su_timer_t *timer, su_timer_arg_t *arg) {
+        theOneAndOnlyController->processLoopTimer() ;
+    }
             
 	/* sofia logging is redirected to this function */
 	static void __sofiasip_logger_func(void *logarg, char const *fmt, va_list ap) {
@@ -178,14 +181,16 @@ namespace {
                         nta_incoming_t* irq,
                         sip_t const *sip) {
         
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_IN, {{"method", sip->sip_request->rq_method_name}})
+        drachtio::SofiaCallbackTimer t("leg") ;
+        STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_IN, sip->sip_request->rq_method, sip->sip_request->rq_method_name)
         return controller->processRequestInsideDialog( leg, irq, sip ) ;
     }
     int stateless_callback(nta_agent_magic_t *controller,
                     nta_agent_t *agent,
                     msg_t *msg,
                     sip_t *sip) {
-        if( sip && sip->sip_request ) STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_IN, {{"method", sip->sip_request->rq_method_name}})
+        drachtio::SofiaCallbackTimer t("stateless") ;
+        if( sip && sip->sip_request ) STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_IN, sip->sip_request->rq_method, sip->sip_request->rq_method_name)
         return controller->processMessageStatelessly( msg, sip ) ;
     }
 
@@ -291,7 +296,12 @@ namespace drachtio {
         m_current_severity_threshold(log_none), m_nSofiaLoglevel(-1), m_bIsOutbound(false), m_bConsoleLogging(false),
         m_nHomerPort(0), m_nHomerId(0), m_mtu(0), m_bAggressiveNatDetection(false), m_bMemoryDebug(false),
         m_nPrometheusPort(0), m_strPrometheusAddress("0.0.0.0"), m_tcpKeepaliveSecs(UINT16_MAX), m_bDumpMemory(false),
-        m_minTlsVersion(0), m_bDisableNatDetection(false), m_pBlacklist(nullptr), m_bAlwaysSend180(false), 
+        m_minTlsVersion(0), m_bDisableNatDetection(false), m_pBlacklist(nullptr), m_pHepExporter(nullptr), m_bAlwaysSend180(false), 
+        m_loopTimer(nullptr), m_suMsgBacklog(0), m_bReloadOverloadThresholds(false), m_requestTraceSampleRate(0),
+        m_httpMaxConnectionsPerHost(0), m_httpRouteCacheTtl(-1), m_httpHandlerThreads(0),
+        m_outboundDnsCacheTtl(-1), m_outboundDnsTimeout(0),
+        m_outboundPoolMin(0), m_outboundPoolMax(0), m_outboundPoolIdleTimeout(0),
+        m_appBatchWindow(0), m_appBatchMaxBytes(0),
         m_bGloballyReadableLogs(false), m_bTlsVerifyClientCert(false), m_bRejectRegisterWithNoRealm(false) {
 
         getEnv();
@@ -327,6 +337,41 @@ namespace drachtio {
         if( 0 == m_requestRouter.getCountOfRoutes() ) {
           m_Config->getRequestRouter( m_requestRouter ) ;
         }
+        if( 0 == m_httpMaxConnectionsPerHost ) {
+          m_httpMaxConnectionsPerHost = m_Config->getHttpMaxConnectionsPerHost() ;
+        }
+        // 0 turns the cache off, so only a negative value means it was not set
+        if( m_httpRouteCacheTtl < 0 ) {
+          m_httpRouteCacheTtl = m_Config->getHttpRouteCacheTtl() ;
+        }
+        if( 0 == m_httpHandlerThreads ) {
+          m_httpHandlerThreads = m_Config->getHttpHandlerThreads() ;
+        }
+        // 0 turns the cache off, so only a negative value means it was not set
+        if( m_outboundDnsCacheTtl < 0 ) {
+          m_outboundDnsCacheTtl = m_Config->getOutboundDnsCacheTtl() ;
+        }
+        if( 0 == m_outboundDnsTimeout ) {
+          m_outboundDnsTimeout = m_Config->getOutboundDnsTimeout() ;
+        }
+        if( 0 == m_outboundPoolMin ) {
+          m_outboundPoolMin = m_Config->getOutboundPoolMin() ;
+        }
+        if( 0 == m_outboundPoolMax ) {
+          m_outboundPoolMax = m_Config->getOutboundPoolMax() ;
+        }
+        if( 0 == m_outboundPoolIdleTimeout ) {
+          m_outboundPoolIdleTimeout = m_Config->getOutboundPoolIdleTimeout() ;
+        }
+        if( 0 == m_appBatchWindow ) {
+          m_appBatchWindow = m_Config->getAppBatchWindow() ;
+        }
+        if( 0 == m_appBatchMaxBytes ) {
+          m_appBatchMaxBytes = m_Config->getAppBatchMaxBytes() ;
+        }
+        if( m_strAppSelectionPolicy.empty() ) {
+          m_strAppSelectionPolicy = m_Config->getAppSelectionPolicy() ;
+        }
         
         return true ;
         
@@ -348,11 +393,7 @@ namespace drachtio {
     }
     void DrachtioController::handleSigTerm( int signal ) {
         DR_LOG(log_notice) << "Received SIGTERM; exiting after dumping stats.."  ;
-        this->printStats(m_bMemoryDebug || m_bDumpMemory) ;
-        m_pDialogController->logStorageCount() ;
-        m_pClientController->logStorageCount() ;
-        m_pPendingRequestController->logStorageCount() ;
-        m_pProxyController->logStorageCount() ;
+        this->logStats(this->snapshotStats(m_bMemoryDebug || m_bDumpMemory)) ;
         nta_agent_destroy(m_nta);
         exit(0);
     }
@@ -393,6 +434,7 @@ namespace drachtio {
                 DR_LOG(log_notice) << "sofia loglevel set to " <<  sofiaLoglevel;
 
                 this->installConfig() ;
+                m_bReloadOverloadThresholds = true ;
             }
         }
         else {
@@ -400,6 +442,13 @@ namespace drachtio {
         }
     }
 
+    // long options that have run out of single letters
+    enum {
+        OPT_APP_BATCH_MAX_BYTES = 256,
+        OPT_APP_SELECTION_POLICY,
+        OPT_HOMER_SAMPLE
+    } ;
+
     bool DrachtioController::parseCmdArgs( int argc, char* argv[] ) {        
         int c ;
         string port ;
@@ -437,6 +486,7 @@ namespace drachtio {
                 {"stdout",    no_argument, 0, 'b'},
                 {"homer",    required_argument, 0, 'y'},
                 {"homer-id",    required_argument, 0, 'z'},
+                {"homer-sample",    required_argument, 0, OPT_HOMER_SAMPLE},
                 {"key-file", required_argument, 0, 'A'},
                 {"cert-file", required_argument, 0, 'B'},
                 {"chain-file", required_argument, 0, 'C'},
@@ -461,6 +511,19 @@ namespace drachtio {
                 {"blacklist-redis-sentinels", required_argument, 0, 'V'},
                 {"blacklist-redis-master", required_argument, 0, 'W'},
                 {"blacklist-redis-password", required_argument, 0, 'X'},
+                {"blacklist-redis-channel", required_argument, 0, 'Y'},
+                {"request-trace-sample-rate", required_argument, 0, 'Z'},
+                {"http-max-connections-per-host", required_argument, 0, 'e'},
+                {"http-route-cache-ttl", required_argument, 0, 'g'},
+                {"http-handler-threads", required_argument, 0, 'j'},
+                {"outbound-dns-cache-ttl", required_argument, 0, 'k'},
+                {"outbound-dns-timeout", required_argument, 0, 'q'},
+                {"outbound-pool-min", required_argument, 0, 'o'},
+                {"outbound-pool-max", required_argument, 0, 'r'},
+                {"outbound-pool-idle-timeout", required_argument, 0, 't'},
+                {"app-batch-window", required_argument, 0, 'w'},
+                {"app-batch-max-bytes", required_argument, 0, OPT_APP_BATCH_MAX_BYTES},
+                {"app-selection-policy", required_argument, 0, OPT_APP_SELECTION_POLICY},
                 {"version",    no_argument, 0, 'v'},
                 {0, 0, 0, 0}
             };
@@ -692,6 +755,48 @@ namespace drachtio {
                 case 'X':
                     m_redisPassword= optarg;
                     break;
+                case 'Y':
+                    m_redisChannel = optarg;
+                    break;
+                case 'Z':
+                    m_requestTraceSampleRate = ::atoi(optarg);
+                    break;
+                case 'e':
+                    m_httpMaxConnectionsPerHost = ::atoi(optarg);
+                    break;
+                case 'g':
+                    m_httpRouteCacheTtl = ::atoi(optarg);
+                    break;
+                case 'j':
+                    m_httpHandlerThreads = ::atoi(optarg);
+                    break;
+                case 'k':
+                    m_outboundDnsCacheTtl = ::atoi(optarg);
+                    break;
+                case 'q':
+                    m_outboundDnsTimeout = ::atoi(optarg);
+                    break;
+                case 'o':
+                    m_outboundPoolMin = ::atoi(optarg);
+                    break;
+                case 'r':
+                    m_outboundPoolMax = ::atoi(optarg);
+                    break;
+                case 't':
+                    m_outboundPoolIdleTimeout = ::atoi(optarg);
+                    break;
+                case 'w':
+                    m_appBatchWindow = ::atoi(optarg);
+                    break;
+                case OPT_APP_BATCH_MAX_BYTES:
+                    m_appBatchMaxBytes = ::atoi(optarg);
+                    break;
+                case OPT_APP_SELECTION_POLICY:
+                    m_strAppSelectionPolicy = optarg;
+                    break;
+                case OPT_HOMER_SAMPLE:
+                    m_strHomerSample = optarg;
+                    break;
                 case 'v':
                     cout << DRACHTIO_VERSION << endl ;
                     exit(0) ;
@@ -745,12 +850,16 @@ namespace drachtio {
         cerr << "Options:" << endl << endl ;
         cerr << "    --address                          Bind to the specified address for application connections (default: 0.0.0.0)" << endl ;
         cerr << "    --aggressive-nat-detection         take presence of 'nat=yes' in Record-Route or Contact hdr as an indicator a remote server is behind a NAT" << endl ;
+        cerr << "    --app-batch-window                 milliseconds to hold messages to an app so they go out in a single write (default: 0, disabled)" << endl ;
+        cerr << "    --app-batch-max-bytes              write a batch of app messages as soon as it reaches this size (default: 65536)" << endl ;
+        cerr << "    --app-selection-policy             how to pick an app for a new request: round-robin, least-transactions, least-write-bytes, weighted or power-of-two (default: round-robin)" << endl ;
         cerr << "    --blacklist-redis-address          address of redis server that contains a set with blacklisted IPs" << endl;
         cerr << "    --blacklist-redis-port             port for redis server containing blacklisted IPs" << endl;
         cerr << "    --blacklist-redis-key              key for a redis set that contains blacklisted IPs" << endl;
         cerr << "    --blacklist-refresh-secs           how often to check for new blacklisted IPs" << endl;
         cerr << "    --blacklist-redis-sentinels        comma-separated list of redis sentinels in ip:port format" << endl;
         cerr << "    --blacklist-redis-password         password for redis server, if required" << endl;
+        cerr << "    --blacklist-redis-channel          redis pub/sub channel with blacklist changes; if provided the set is loaded once and then updated incrementally" << endl;
         cerr << "    --daemon                           Run the process as a daemon background process" << endl ;
         cerr << "    --cert-file                        TLS certificate file" << endl ;
         cerr << "    --chain-file                       TLS certificate chain file" << endl ;
@@ -760,16 +869,26 @@ namespace drachtio {
         cerr << "-f, --file                             Path to configuration file (default /etc/drachtio.conf.xml)" << endl ;
         cerr << "    --homer                            ip:port of homer/sipcapture agent" << endl ;
         cerr << "    --homer-id                         homer agent id to use in HEP messages to identify this server" << endl ;
+        cerr << "    --homer-sample                     which messages to send to homer: all, invite (INVITE dialogs only) or N (1 in N calls) (default: all)" << endl ;
         cerr << "    --http-handler                     http(s) URL to optionally send routing request to for new incoming sip request" << endl ;
         cerr << "    --http-method                      method to use with http-handler: GET (default) or POST" << endl ;
+        cerr << "    --http-max-connections-per-host    max connections to open to an http-handler host; requests are multiplexed over HTTP/2 where possible (default: 0, no limit)" << endl ;
+        cerr << "    --http-handler-threads             number of threads making http-handler requests; each request goes to the least busy (default: 1)" << endl ;
+        cerr << "    --http-route-cache-ttl             seconds to cache http-handler routing decisions by method, request uri and source address (default: 0, disabled)" << endl ;
         cerr << "    --key-file                         TLS key file" << endl ;
         cerr << "-l  --loglevel                         Log level (choices: notice, error, warning, info, debug)" << endl ;
         cerr << "    --local-net                        CIDR for local subnet (e.g. \"10.132.0.0/20\")" << endl ;
         cerr << "    --memory-debug                     enable verbose debugging of memory allocations (do not turn on in production)" << endl ;
         cerr << "    --mtu                              max packet size for UDP (default: system-defined mtu)" << endl ;
+        cerr << "    --outbound-dns-cache-ttl           seconds to cache resolved addresses of outbound app connections (default: 30, 0 disables)" << endl ;
+        cerr << "    --outbound-dns-timeout             milliseconds to wait for dns resolution of an outbound app connection (default: 2000)" << endl ;
+        cerr << "    --outbound-pool-min                spare authenticated connections to keep open to each outbound app target (default: 0, disabled)" << endl ;
+        cerr << "    --outbound-pool-max                max spare connections to an outbound app target when calls arrive faster than the pool refills (default: 8)" << endl ;
+        cerr << "    --outbound-pool-idle-timeout       seconds before closing surplus spare connections, or all of them if the target is unused (default: 60)" << endl ;
         cerr << "-p, --port                             TCP port to listen on for application connections (default 9022)" << endl ;
         cerr << "    --prometheus-scrape-port           The port (or host:port) to listen on for Prometheus.io metrics scrapes" << endl ;
         cerr << "    --reject-register-with-no-realm    reject with a 403 any REGISTER that has an IP address in the sip uri host" << endl ;
+        cerr << "    --request-trace-sample-rate        log the per-stage timing of 1 in every N new incoming requests (default: 0, disabled)" << endl ;
         cerr << "    --secret                           The shared secret to use for authenticating application connections" << endl ;
         cerr << "    --sofia-loglevel                   Log level of internal sip stack (choices: 0-9)" << endl ;
         cerr << "    --external-ip                      External IP address to use in SIP messaging" << endl ;
@@ -808,6 +927,8 @@ namespace drachtio {
         if (p && ::atoi(p) > 0) m_nHomerPort = ::atoi(p);
         p = std::getenv("DRACHTIO_HOMER_ID");
         if (p && ::atoi(p) > 0) m_nHomerId = ::atoi(p);
+        p = std::getenv("DRACHTIO_HOMER_SAMPLE");
+        if (p) m_strHomerSample = p;
         p = std::getenv("DRACHTIO_HTTP_HANDLER_URI");
         if (p) {
             m_requestRouter.clearRoutes();
@@ -876,6 +997,58 @@ namespace drachtio {
         if (p) {
             m_redisRefreshSecs = boost::lexical_cast<unsigned int>(p); ;
         }
+        p = std::getenv("DRACHTIO_BLACKLIST_REDIS_CHANNEL");
+        if (p) {
+            m_redisChannel = p;
+        }
+        p = std::getenv("DRACHTIO_REQUEST_TRACE_SAMPLE_RATE");
+        if (p) {
+            m_requestTraceSampleRate = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_HTTP_MAX_CONNECTIONS_PER_HOST");
+        if (p) {
+            m_httpMaxConnectionsPerHost = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_HTTP_ROUTE_CACHE_TTL");
+        if (p) {
+            m_httpRouteCacheTtl = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_HTTP_HANDLER_THREADS");
+        if (p) {
+            m_httpHandlerThreads = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_OUTBOUND_DNS_CACHE_TTL");
+        if (p) {
+            m_outboundDnsCacheTtl = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_OUTBOUND_DNS_TIMEOUT");
+        if (p) {
+            m_outboundDnsTimeout = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_OUTBOUND_POOL_MIN");
+        if (p) {
+            m_outboundPoolMin = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_OUTBOUND_POOL_MAX");
+        if (p) {
+            m_outboundPoolMax = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_OUTBOUND_POOL_IDLE_TIMEOUT");
+        if (p) {
+            m_outboundPoolIdleTimeout = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_APP_BATCH_WINDOW");
+        if (p) {
+            m_appBatchWindow = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_APP_BATCH_MAX_BYTES");
+        if (p) {
+            m_appBatchMaxBytes = ::atoi(p);
+        }
+        p = std::getenv("DRACHTIO_APP_SELECTION_POLICY");
+        if (p) {
+            m_strAppSelectionPolicy = p;
+        }
         p = std::getenv("DRACHTIO_USER_AGENT_OPTIONS_AUTO_RESPOND");
         if (p) {
             m_strUserAgentAutoAnswerOptions = p;
@@ -1083,7 +1256,12 @@ namespace drachtio {
       this->logConfig() ;
 
         DR_LOG(log_debug) << "DrachtioController::run: Main thread id: " << std::this_thread::get_id() ;
-        if (m_bMemoryDebug) DR_LOG(log_notice) << "DrachtioController::run: memory debugging is ON...only use for non-production configurations" ;
+        if (m_bMemoryDebug) {
+            DR_LOG(log_notice) << "DrachtioController::run: memory debugging is ON...only use for non-production configurations" ;
+
+            // track outstanding json allocations; must be installed before anything is allocated through jansson
+            json_set_alloc_funcs(my_json_malloc, my_json_free);
+        }
 
        /* open admin connection */
         string adminAddress ;
@@ -1182,22 +1360,38 @@ namespace drachtio {
         unsigned int hepVersion;
         unsigned int capturePort ;
         if (!m_strHomerAddress.empty()) {
-            captureString = "udp:" + m_strHomerAddress + ":" + boost::lexical_cast<std::string>(m_nHomerPort) + 
-                ";hep=3;capture_id=" + boost::lexical_cast<std::string>(m_nHomerId);
-            DR_LOG(log_notice) << "DrachtioController::run - sipcapture/Homer enabled: " << captureString;            
+            captureServer = m_strHomerAddress;
+            capturePort = m_nHomerPort;
+            captureId = m_nHomerId;
+            hepVersion = 3;
         }
         else if (m_Config->getCaptureServer(captureServer, capturePort, captureId, hepVersion)) {
             if (hepVersion < 1 || hepVersion > 3) {
                 DR_LOG(log_error) << "DrachtioController::run invalid hep-version " << hepVersion <<
                     "; must be between 1 and 3 inclusive";
+                captureServer.clear();
+            }
+        }
+        if (m_strHomerSample.empty()) m_strHomerSample = m_Config->getCaptureSample();
+
+        // sofia still captures HEPv3 from the message buffer, but to our relay on the loopback interface, which batches it on to Homer;
+        // older versions (or if the relay can not be set up) are sent by sofia directly
+        if (!captureServer.empty() && 3 == hepVersion) {
+            m_pHepExporter = new HepExporter(captureServer, capturePort, captureId, m_strHomerSample);
+            if (!m_pHepExporter->start()) {
+                delete m_pHepExporter;
+                m_pHepExporter = nullptr;
             }
             else {
-                captureString = "udp:" + captureServer + ":" + boost::lexical_cast<std::string>(capturePort) + 
-                    ";hep=" + boost::lexical_cast<std::string>(hepVersion) +
-                    ";capture_id=" + boost::lexical_cast<std::string>(captureId);
-                DR_LOG(log_notice) << "DrachtioController::run - sipcapture/Homer enabled: " << captureString;
+                captureString = m_pHepExporter->getCaptureString();
+                DR_LOG(log_notice) << "DrachtioController::run - sipcapture/Homer enabled through the HEP relay: " << captureString;
             }
-
+        }
+        if (!captureServer.empty() && !m_pHepExporter) {
+            captureString = "udp:" + captureServer + ":" + boost::lexical_cast<std::string>(capturePort) + 
+                ";hep=" + boost::lexical_cast<std::string>(hepVersion) +
+                ";capture_id=" + boost::lexical_cast<std::string>(captureId);
+            DR_LOG(log_notice) << "DrachtioController::run - sipcapture/Homer enabled: " << captureString;
         }
 
         if (m_strUserAgentAutoAnswerOptions.empty()) {
@@ -1218,18 +1412,19 @@ namespace drachtio {
                 m_redisPort = redisPort;
                 m_redisKey = redisKey;
                 m_redisRefreshSecs = redisRefreshSecs;
+                m_Config->getBlacklistChannel(m_redisChannel);
             }
         }
         if (m_redisAddress.length() && m_redisKey.length()) {
             DR_LOG(log_notice) << "DrachtioController::run - blacklist is in redis " << m_redisAddress << ":" << m_redisPort 
                 << ", key is " << m_redisKey;
-            m_pBlacklist = new Blacklist(m_redisAddress, m_redisPort, m_redisPassword, m_redisKey, m_redisRefreshSecs);
+            m_pBlacklist = new Blacklist(m_redisAddress, m_redisPort, m_redisPassword, m_redisKey, m_redisRefreshSecs, m_redisChannel);
             m_pBlacklist->start();
         }
         else if (m_redisSentinels.length() && m_redisMaster.length() &&  m_redisKey.length()) {
             DR_LOG(log_notice) << "DrachtioController::run - blacklist is in redis, using sentinels " << m_redisSentinels 
                 << ", key is " << m_redisKey;
-            m_pBlacklist = new Blacklist(m_redisSentinels, m_redisMaster, m_redisPassword, m_redisKey, m_redisRefreshSecs);
+            m_pBlacklist = new Blacklist(m_redisSentinels, m_redisMaster, m_redisPassword, m_redisKey, m_redisRefreshSecs, m_redisChannel);
             m_pBlacklist->start();
         }
         else {
@@ -1248,6 +1443,14 @@ namespace drachtio {
         }
         initStats();
 
+        if (0 == m_requestTraceSampleRate) m_requestTraceSampleRate = m_Config->getRequestTraceSampleRate();
+        m_requestTracer.enable(m_statsCollector.enabled(), m_requestTraceSampleRate);
+        if (m_requestTraceSampleRate > 0) {
+            DR_LOG(log_notice) << "logging per-stage timing for 1 in every " << m_requestTraceSampleRate << " new incoming requests";
+        }
+
+        configureOverloadControl() ;
+
         // tcp keepalive
         if (UINT16_MAX == m_tcpKeepaliveSecs) {
             m_tcpKeepaliveSecs = m_Config->getTcpKeepalive();
@@ -1370,6 +1573,7 @@ namespace drachtio {
         m_pDialogController = std::make_shared<SipDialogController>( this, &m_clone ) ;
         m_pProxyController = std::make_shared<SipProxyController>( this, &m_clone ) ;
         m_pPendingRequestController = std::make_shared<PendingRequestController>( this ) ;
+        m_pCdrWriter = std::make_shared<CdrWriter>( m_Config->getCdrFile() ) ;
 
         // set sip timers
         unsigned int t1, t2, t4, t1x64 ;
@@ -1386,9 +1590,16 @@ namespace drachtio {
         /* sofia event loop */
         DR_LOG(log_notice) << "Starting sofia event loop in main thread: " <<  std::this_thread::get_id()  ;
 
-        /* start a timer */
+        /* start a timer, with a thread to do the logging for it */
+        std::thread t(&DrachtioController::watchdogThreadFunc, this) ;
+        m_watchdogThread.swap( t ) ;
         m_timer = su_timer_create( su_root_task(m_root), 30000) ;
         su_timer_set_for_ever(m_timer, watchdogTimerHandler, this) ;
+
+        /* sample event loop lag and queue depths once a second; always running, since a reload may turn on overload control */
+        m_loopTimer = su_timer_create( su_root_task(m_root), 1000) ;
+        m_loopTimerExpires = std::chrono::steady_clock::now() + std::chrono::milliseconds(1000) ;
+        su_timer_set(m_loopTimer, loopTimerHandler, this) ;
  
         su_root_run( m_root ) ;
         DR_LOG(log_notice) << "Sofia event loop ended"  ;
@@ -1405,6 +1616,8 @@ namespace drachtio {
     }
     int DrachtioController::processMessageStatelessly( msg_t* msg, sip_t* sip ) {
         int rc = 0 ;
+        if (m_requestTracer.enabled()) RequestTracer::arrived();
+
         if (m_pBlacklist) {
             string host;
             getSourceAddressForMsg(msg, host);
@@ -1412,6 +1625,20 @@ namespace drachtio {
                 return -1;
             }
         }
+
+        // answer keepalive OPTIONS matching a configured rule before doing any other work
+        if (sip->sip_request && sip_method_options == sip->sip_request->rq_method && sip->sip_to && !sip->sip_to->a_tag) {
+            const OptionsResponder& responder = m_Config->getOptionsResponder() ;
+            if (!responder.empty() && sip_sanity_check(sip) >= 0) {
+                const OptionsResponder::Rule_t* rule = responder.match( msg_addr(msg), sip ) ;
+                if (rule) {
+                    STATS_COUNTER_INCREMENT(STATS_COUNTER_OPTIONS_AUTO_ANSWERED, {{"rule", rule->name}})
+                    STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip_method_options, "OPTIONS", 200)
+                    nta_msg_treply( m_nta, msg, 200, NULL, SIPTAG_HEADER_STR(responder.getResponseHeaders().c_str()), TAG_END() ) ;
+                    return -1 ;
+                }
+            }
+        }
         DR_LOG(log_debug) << "processMessageStatelessly - incoming message with call-id " << sip->sip_call_id->i_id <<
             " does not match an existing call leg, processed in thread " << std::this_thread::get_id()  ;
 
@@ -1430,61 +1657,33 @@ namespace drachtio {
             // sofia sanity check on message format
             if( sip_sanity_check(sip) < 0 ) {
                 DR_LOG(log_error) << "DrachtioController::processMessageStatelessly: invalid incoming request message; discarding call-id " << sip->sip_call_id->i_id ;
-                STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {{"method", sip->sip_request->rq_method_name},{"code", "400"}})
+                STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name, 400)
                 nta_msg_treply( m_nta, msg, 400, NULL, TAG_END() ) ;
                 return -1 ;
             }
 
             // spammer check
             string action, tcpAction ;
-            DrachtioConfig::mapHeader2Values& mapSpammers =  m_Config->getSpammers( action, tcpAction );
-            if( mapSpammers.size() > 0 ) {
+            const SpammerMatcher& spammers =  m_Config->getSpammerMatcher( action, tcpAction );
+            if( !spammers.empty() ) {
                 if( 0 == strcmp( tpn->tpn_proto, "tcp") || 0 == strcmp( tpn->tpn_proto, "ws") || 0 == strcmp( tpn->tpn_proto, "wss") ) {
                     if( tcpAction.length() > 0 ) {
                         action = tcpAction ;
                     }
                 }
 
-                try {
-                    for( DrachtioConfig::mapHeader2Values::iterator it = mapSpammers.begin(); mapSpammers.end() != it; ++it ) {
-                        string hdrName = it->first ;
-                        vector<string> vecValue = it->second ;
-
-                        // currently limited to looking at User-Agent, From, and To
-                        if( 0 == hdrName.compare("user-agent") && sip->sip_user_agent && sip->sip_user_agent->g_string ) {
-                            for( std::vector<string>::iterator it = vecValue.begin(); it != vecValue.end(); ++it ) {
-                                if( NULL != strstr( sip->sip_user_agent->g_string, (*it).c_str() ) ) {
-                                    throw runtime_error(sip->sip_user_agent->g_string) ;
-                                }
-                            }
-                        }
-                        if( 0 == hdrName.compare("to") && sip->sip_to && sip->sip_to->a_url->url_user ) {
-                            for( std::vector<string>::iterator it = vecValue.begin(); it != vecValue.end(); ++it ) {
-                                if( NULL != strstr( sip->sip_to->a_url->url_user, (*it).c_str() ) ) {
-                                    throw runtime_error(sip->sip_to->a_url->url_user) ;
-                                }
-                            }
-                        }
-                        if( 0 == hdrName.compare("from") && sip->sip_from && sip->sip_from->a_url->url_user ) {
-                            for( std::vector<string>::iterator it = vecValue.begin(); it != vecValue.end(); ++it ) {
-                                if( NULL != strstr( sip->sip_from->a_url->url_user, (*it).c_str() ) ) {
-                                    throw runtime_error(sip->sip_from->a_url->url_user) ;
-                                }
-                            }
-                        }
-                    }
-                } catch( runtime_error& err ) {
+                const char* what = spammers.match( sip ) ;
+                if( what ) {
                     nta_incoming_t* irq = nta_incoming_create( m_nta, NULL, msg, sip, NTATAG_TPORT(tp), TAG_END() ) ;
                     if (sip->sip_request->rq_method != sip_method_ack) {
                         const char* remote_host = nta_incoming_remote_host(irq);
                         const char *remote_port = nta_incoming_remote_port(irq);
-                        const char* what = err.what();
-                        if (remote_host && remote_port && what) {
+                        if (remote_host && remote_port) {
                             DR_LOG(log_notice) << "DrachtioController::processMessageStatelessly: detected potential spammer from " <<
                                 nta_incoming_remote_host(irq) << ":" << nta_incoming_remote_port(irq)  << 
-                                " due to header value: " << err.what()  ;
+                                " due to header value: " << what  ;
                         }
-                        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {{"method", sip->sip_request->rq_method_name},{"code", "603"}})
+                        STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name, 603)
                         nta_incoming_treply( irq, 603, "Decline", TAG_END() ) ;
                         nta_incoming_destroy(irq) ;   
 
@@ -1532,7 +1731,7 @@ namespace drachtio {
                   std::regex ipRegex("^(?:[0-9]{1,3}\\.){3}[0-9]{1,3}$");
                   if (std::regex_match(sip->sip_request->rq_url->url_host, ipRegex)) {
                     DR_LOG(log_info) << "DrachtioController::processMessageStatelessly: rejecting REGISTER with no realm" ;
-                    STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {{"method", "REGISTER"},{"code", "403"}})
+                    STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip_method_register, "REGISTER", 403)
                     nta_msg_treply( m_nta, msg, 403, NULL, TAG_END() ) ;
                     return -1 ;
                   }
@@ -1556,6 +1755,14 @@ namespace drachtio {
                             return ret ;
                         }
 
+                        if (!m_overloadController.admit()) {
+                            DR_LOG(log_info) << "rejecting new " << sip->sip_request->rq_method_name << " due to overload: " << sip->sip_call_id->i_id ;
+                            STATS_COUNTER_INCREMENT(STATS_COUNTER_OVERLOAD_REJECTED, {{"method", sip->sip_request->rq_method_name}})
+                            STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name, 503)
+                            nta_msg_treply( m_nta, msg, 503, NULL, SIPTAG_RETRY_AFTER_STR(m_overloadController.getRetryAfter()), TAG_END() ) ;
+                            return -1 ;
+                        }
+
                         if( sip_method_invite == sip->sip_request->rq_method ) {
                           if (-1 == nta_msg_treply( m_nta, msg_ref_create( msg ), 100, NULL, TAG_END() )) {
                             DR_LOG(log_info) << "failed sending 100 Trying: " << sip->sip_call_id->i_id  ;
@@ -1616,17 +1823,17 @@ namespace drachtio {
                             client_ptr client = m_pClientController->findClientForNetTransaction(p->getTransactionId()); 
                             if(client) {
                                 void (BaseClient::*fn)(const string&, const string&, const SipMsgData_t&) = &BaseClient::sendSipMessageToClient;
-                                m_pClientController->getIOService().post( std::bind(fn, client, p->getTransactionId(), encodedMessage, meta)) ;
+                                m_pClientController->post( std::bind(fn, client, p->getTransactionId(), encodedMessage, meta)) ;
                             }
 
-                            STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {{"method", sip->sip_request->rq_method_name},{"code", "200"}})
+                            STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name, 200)
                             nta_msg_treply( m_nta, msg, 200, NULL, TAG_END() ) ;  
                             p->cancel() ;
-                            STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {{"method", "INVITE"},{"code", "487"}})
+                            STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip_method_invite, "INVITE", 487)
                             nta_msg_treply( m_nta, msg_dup(p->getMsg()), 487, NULL, TAG_END() ) ;
                         }
                         else {
-                            STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {{"method", sip->sip_request->rq_method_name},{"code", "481"}})
+                            STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name, 481)
                             nta_msg_treply( m_nta, msg, 481, NULL, TAG_END() ) ;                              
                         }
                     }
@@ -1634,7 +1841,7 @@ namespace drachtio {
                     
                     case sip_method_update:
                     case sip_method_bye:
-                        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {{"method", sip->sip_request->rq_method_name},{"code", "481"}})
+                        STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name, 481)
                         nta_msg_treply( m_nta, msg, 481, NULL, TAG_END() ) ;   
                         break;                           
 
@@ -1809,48 +2016,44 @@ namespace drachtio {
 
     void DrachtioController::cacheTportForSubscription( const char* user, const char* host, int expires, tport_t* tp ) {
         string uri ;
-        std::shared_ptr<UaInvalidData> pUa = std::make_shared<UaInvalidData>(user, host, expires, tp) ;
-        pUa->getUri( uri ) ;
-
-        std::pair<mapUri2InvalidData::iterator, bool> ret = m_mapUri2InvalidData.insert( mapUri2InvalidData::value_type( uri, pUa) );  
-        if( ret.second == false ) {
-            mapUri2InvalidData::iterator it = ret.first ;
-            pUa = it->second;
-            //*(it->second) = *pUa ;
+        UaInvalidData::makeUri( user, host, uri ) ;
+
+        mapUri2InvalidData::iterator it = m_mapUri2InvalidData.find( uri ) ;
+        if( m_mapUri2InvalidData.end() != it ) {
+            std::shared_ptr<UaInvalidData> pUa = it->second;
+            DR_LOG(log_info) << "DrachtioController::cacheTportForSubscription extending " << uri << " by " << expires << "secs" ;
             pUa->extendExpires(expires);
             pUa->setTport(tp);
+            m_registrationExpiryWheel.schedule( pUa.get() ) ;
             DR_LOG(log_debug) << "DrachtioController::cacheTportForSubscription updated "  << uri << ", expires: " << expires << 
                 " tport: " << (void*) tp << ", count is now: " << m_mapUri2InvalidData.size();
         }
         else {
-            std::shared_ptr<UaInvalidData> p = (ret.first)->second ;
+            std::shared_ptr<UaInvalidData> pUa = std::make_shared<UaInvalidData>(expires, tp) ;
+            it = m_mapUri2InvalidData.emplace( uri, pUa ).first ;
+            pUa->setUri( &it->first ) ;
+            m_registrationExpiryWheel.schedule( pUa.get() ) ;
             DR_LOG(log_info) << "DrachtioController::cacheTportForSubscription added "  << uri << 
                 ", tport:" << (void *) tp << ", expires: " << expires << ", count is now: " << m_mapUri2InvalidData.size();
         }
     }
     void DrachtioController::flushTportForSubscription( const char* user, const char* host ) {
-        string uri = "" ;
-        if (user) {
-            uri.append(user) ;
-            uri.append("@") ;
-        }
-        uri.append(host) ;
+        string uri ;
+        UaInvalidData::makeUri( user, host, uri ) ;
 
         mapUri2InvalidData::iterator it = m_mapUri2InvalidData.find( uri ) ;
         if( m_mapUri2InvalidData.end() != it ) {
+            // a caller may still hold the entry, so it must not keep pointing at the key
+            m_registrationExpiryWheel.unschedule( it->second.get() ) ;
+            it->second->setUri( nullptr ) ;
             m_mapUri2InvalidData.erase( it ) ;
         }
         DR_LOG(log_info) << "DrachtioController::flushTportForSubscription "  << uri <<  ", count is now: " << m_mapUri2InvalidData.size();
     }
     std::shared_ptr<UaInvalidData> DrachtioController::findTportForSubscription( const char* user, const char* host ) {
         std::shared_ptr<UaInvalidData> p ;
-        string uri = "" ;
-
-        if (user) {
-            uri.append(user) ;
-            uri.append("@") ;
-        }
-        uri.append(host) ;
+        string uri ;
+        UaInvalidData::makeUri( user, host, uri ) ;
 
         mapUri2InvalidData::iterator it = m_mapUri2InvalidData.find( uri ) ;
         if( m_mapUri2InvalidData.end() != it ) {
@@ -1905,7 +2108,7 @@ namespace drachtio {
     std::ostringstream msg ;
     json_t *root;
     json_error_t error;
-    root = json_loads(body.c_str(), 0, &error);
+    root = json_loadb(body.data(), body.size(), 0, &error);
 
     DR_LOG(log_debug) << "DrachtioController::httpCallRoutingComplete thread id " << std::this_thread::get_id() << 
       " transaction id " << transactionId << " response: (" << response_code << ") " << body ; 
@@ -2102,8 +2305,8 @@ namespace drachtio {
     selectInboundConnectionForTag(transactionId, val);
   }
 
-    void DrachtioController::printStats(bool bDetail) {
-       bool bMemoryDebug = m_bMemoryDebug || m_bDumpMemory;
+    std::shared_ptr<WatchdogSnapshot_t> DrachtioController::snapshotStats(bool bDetail) {
+       std::shared_ptr<WatchdogSnapshot_t> snapshot = std::make_shared<WatchdogSnapshot_t>(bDetail) ;
 
        usize_t irq_hash = -1, orq_hash = -1, leg_hash = -1;
        usize_t irq_used = -1, orq_used = -1, leg_used = -1 ;
@@ -2154,142 +2357,196 @@ namespace drachtio {
                                 NTATAG_S_TOUT_RESPONSE_REF(tout_response),
                            TAG_END()) ;
        
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "size of hash table for server-side transactions                  " << dec << irq_hash  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "size of hash table for client-side transactions                  " << orq_hash  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "size of hash table for dialogs                                   " << leg_hash  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of server-side transactions in the hash table             " << irq_used  ;
+       snapshot->addCount("size of hash table for server-side transactions                  ", irq_hash) ;
+       snapshot->addCount("size of hash table for client-side transactions                  ", orq_hash) ;
+       snapshot->addCount("size of hash table for dialogs                                   ", leg_hash) ;
+       snapshot->addCount("number of server-side transactions in the hash table             ", irq_used) ;
        if (bDetail && irq_used > 0) {
            nta_incoming_t* irq = NULL;
-           std::deque<nta_incoming_t*> aged;
            do {
                irq = nta_get_next_server_txn_from_hash(m_nta, irq);
                if (irq) {
-                   const char* method = nta_incoming_method_name(irq);
-                   const char* tag = nta_incoming_gettag(irq);
-                   uint32_t seq = nta_incoming_cseq(irq);
-                   sip_time_t secsSinceReceived = now - nta_incoming_received(irq, NULL);
-                   if (secsSinceReceived > 3600) aged.push_back(irq);
-                   DR_LOG(bMemoryDebug ? log_info : log_debug) << "    nta_incoming_t*: " << std::hex << (void *) irq  <<
-                    " " << method << " " << std::dec << seq << " remote tag: " << tag << 
-                    " alive " << secsSinceReceived << " secs";
+                   std::ostringstream o ;
+                   o << "    nta_incoming_t*: " << std::hex << (void *) irq << " " << nta_incoming_method_name(irq) << " " << 
+                    std::dec << nta_incoming_cseq(irq) << " remote tag: " << nta_incoming_gettag(irq) << 
+                    " alive " << now - nta_incoming_received(irq, NULL) << " secs";
+                   snapshot->addDetail(o.str()) ;
                }
            } while (irq) ;
-           /*
-           std::for_each(aged.begin(), aged.end(), [](nta_incoming_t* irq) {
-               DR_LOG(bMemoryDebug ? log_info : log_debug) << "        destroying very old nta_incoming_t*: " <<  std::hex << (void *) irq ;
-               nta_incoming_destroy(irq);
-           });
-           */
        }
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of client-side transactions in the hash table             " << orq_used  ;
+       snapshot->addCount("number of client-side transactions in the hash table             ", orq_used) ;
        if (bDetail && orq_used > 0) {
            nta_outgoing_t* orq = NULL;
            do {
                orq = nta_get_next_client_txn_from_hash(m_nta, orq);
                if (orq) {
-                   const char* method = nta_outgoing_method_name(orq);
-                   const char* callId = nta_outgoing_call_id(orq);
-                   uint32_t seq = nta_outgoing_cseq(orq);
-                   DR_LOG(bMemoryDebug ? log_info : log_debug) << "    nta_outgoing_t*: " << std::hex << (void *) orq  <<
-                    " " << method << " " << callId << std::dec << " CSeq: " << seq;
+                   std::ostringstream o ;
+                   o << "    nta_outgoing_t*: " << std::hex << (void *) orq << " " << nta_outgoing_method_name(orq) << " " << 
+                    nta_outgoing_call_id(orq) << std::dec << " CSeq: " << nta_outgoing_cseq(orq);
+                   snapshot->addDetail(o.str()) ;
                }
            } while (orq) ;
        }
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of dialogs in the hash table                              " << leg_used  ;
+       snapshot->addCount("number of dialogs in the hash table                              ", leg_used) ;
        if (bDetail && leg_used > 0) {
            nta_leg_t* leg = NULL;
            do {
                leg = nta_get_next_dialog_from_hash(m_nta, leg);
                if (leg) {
-                   const char* localTag = nta_leg_get_tag(leg);
-                   DR_LOG(bMemoryDebug ? log_info : log_debug) << "    nta_leg_t*: " << std::hex << (void *) leg  << 
-                    " local tag: " << localTag ;
+                   std::ostringstream o ;
+                   o << "    nta_leg_t*: " << std::hex << (void *) leg << " local tag: " << nta_leg_get_tag(leg) ;
+                   snapshot->addDetail(o.str()) ;
                }
            } while (leg) ;
        }
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of sip messages received                                  " << recv_msg  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of sip messages sent                                      " << sent_msg  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of sip requests received                                  " << recv_request  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of sip requests sent                                      " << sent_request  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of bad sip messages received                              " << bad_message  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of bad sip requests received                              " << bad_request  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of bad sip requests dropped                               " << drop_request  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of bad sip reponses dropped                               " << drop_response  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of client transactions created                            " << client_tr  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of server transactions created                            " << server_tr  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of in-dialog server transactions created                  " << dialog_tr  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of server transactions that have received ack             " << acked_tr  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of server transactions that have received cancel          " << canceled_tr  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of requests that were processed stateless                 " << trless_request  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of requests converted to transactions by message callback " << trless_to_tr  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of responses without matching request                     " << trless_response  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of successful responses missing INVITE client transaction " << trless_200  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of requests merged by UAS                                 " << merged_request  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of SIP responses sent by stack                            " << sent_response  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of SIP requests retransmitted by stack                    " << retry_request  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of SIP responses retransmitted by stack                   " << retry_response  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of retransmitted SIP requests received by stack           " << recv_retry  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of SIP client transactions that has timeout               " << tout_request  ;
-       DR_LOG(bMemoryDebug ? log_info : log_debug) << "number of SIP server transactions that has timeout               " << tout_response  ;
-
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_SERVER_HASH_SIZE, irq_hash)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_CLIENT_HASH_SIZE, orq_hash)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_DIALOG_HASH_SIZE, leg_hash)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_NUM_SERVER_TXNS, irq_used)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_NUM_CLIENT_TXNS, orq_used)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_NUM_DIALOGS, leg_used)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_MSG_RECV, recv_msg)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_MSG_SENT, sent_msg)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_REQ_RECV, recv_request)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_REQ_SENT, sent_request)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_BAD_MSGS, bad_message)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_BAD_REQS, bad_request)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_RETRANS_REQ, retry_request)
-       STATS_GAUGE_SET(STATS_GAUGE_SOFIA_RETRANS_RES, retry_response)
-
-       STATS_GAUGE_SET(STATS_GAUGE_REGISTERED_ENDPOINTS, m_mapUri2InvalidData.size());
+       snapshot->addCount("number of sip messages received                                  ", recv_msg) ;
+       snapshot->addCount("number of sip messages sent                                      ", sent_msg) ;
+       snapshot->addCount("number of sip requests received                                  ", recv_request) ;
+       snapshot->addCount("number of sip requests sent                                      ", sent_request) ;
+       snapshot->addCount("number of bad sip messages received                              ", bad_message) ;
+       snapshot->addCount("number of bad sip requests received                              ", bad_request) ;
+       snapshot->addCount("number of bad sip requests dropped                               ", drop_request) ;
+       snapshot->addCount("number of bad sip reponses dropped                               ", drop_response) ;
+       snapshot->addCount("number of client transactions created                            ", client_tr) ;
+       snapshot->addCount("number of server transactions created                            ", server_tr) ;
+       snapshot->addCount("number of in-dialog server transactions created                  ", dialog_tr) ;
+       snapshot->addCount("number of server transactions that have received ack             ", acked_tr) ;
+       snapshot->addCount("number of server transactions that have received cancel          ", canceled_tr) ;
+       snapshot->addCount("number of requests that were processed stateless                 ", trless_request) ;
+       snapshot->addCount("number of requests converted to transactions by message callback ", trless_to_tr) ;
+       snapshot->addCount("number of responses without matching request                     ", trless_response) ;
+       snapshot->addCount("number of successful responses missing INVITE client transaction ", trless_200) ;
+       snapshot->addCount("number of requests merged by UAS                                 ", merged_request) ;
+       snapshot->addCount("number of SIP responses sent by stack                            ", sent_response) ;
+       snapshot->addCount("number of SIP requests retransmitted by stack                    ", retry_request) ;
+       snapshot->addCount("number of SIP responses retransmitted by stack                   ", retry_response) ;
+       snapshot->addCount("number of retransmitted SIP requests received by stack           ", recv_retry) ;
+       snapshot->addCount("number of SIP client transactions that has timeout               ", tout_request) ;
+       snapshot->addCount("number of SIP server transactions that has timeout               ", tout_response) ;
+
+       snapshot->addGauge(STATS_GAUGE_SOFIA_SERVER_HASH_SIZE, irq_hash) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_CLIENT_HASH_SIZE, orq_hash) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_DIALOG_HASH_SIZE, leg_hash) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_NUM_SERVER_TXNS, irq_used) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_NUM_CLIENT_TXNS, orq_used) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_NUM_DIALOGS, leg_used) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_MSG_RECV, recv_msg) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_MSG_SENT, sent_msg) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_REQ_RECV, recv_request) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_REQ_SENT, sent_request) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_BAD_MSGS, bad_message) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_BAD_REQS, bad_request) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_RETRANS_REQ, retry_request) ;
+       snapshot->addGauge(STATS_GAUGE_SOFIA_RETRANS_RES, retry_response) ;
+
+       // counts from the controllers that are only safe to read on this thread
+       m_pDialogController->snapshotStorageCount(*snapshot) ;
+       m_pProxyController->snapshotStorageCount(*snapshot) ;
+
+       snapshot->addCount("m_mapUri2InvalidData size:                                       ", m_mapUri2InvalidData.size()) ;
+       snapshot->addCount("registration expiry wheel size:                                  ", m_registrationExpiryWheel.size()) ;
+       snapshot->addGauge(STATS_GAUGE_REGISTERED_ENDPOINTS, m_mapUri2InvalidData.size()) ;
+#ifdef SOFIA_MSG_DEBUG_TRACE
+       snapshot->addCount("number allocated msg_t                                           ", sofia_msg_count()) ;
+#endif
 
+       return snapshot ;
     }
-    void DrachtioController::processWatchdogTimer() {
-        DR_LOG(log_debug) << "DrachtioController::processWatchdogTimer"  ;
-    
-        // expire any UaInvalidData
-        for(  mapUri2InvalidData::iterator it = m_mapUri2InvalidData.begin(); it != m_mapUri2InvalidData.end(); ) {
-            std::shared_ptr<UaInvalidData> p = it->second ;
-            if( p->isExpired() ) {
-                string uri  ;
-                tport_t* tp = p->getTport();
-                p->getUri(uri) ;
-
-                m_mapUri2InvalidData.erase(it++) ;
-                DR_LOG(log_info) << "DrachtioController::processWatchdogTimer expiring registration for webrtc client: "  << 
-                    uri << " " << (void *)tp << ", count is now " << m_mapUri2InvalidData.size()  ;
+
+    void DrachtioController::logStats(std::shared_ptr<WatchdogSnapshot_t> snapshot) {
+        bool bDetail = snapshot->isDetail() ;
+
+        snapshot->log() ;
+        m_pDialogController->logStorageCount(bDetail) ;
+        m_pClientController->logStorageCount(bDetail) ;
+        m_pPendingRequestController->logStorageCount(bDetail) ;
+        m_pProxyController->logStorageCount(bDetail) ;
+
+        if (m_bMemoryDebug) {
+            unsigned int jsonAllocs ;
+            size_t jsonBytes ;
+            getJsonAllocationStats(jsonAllocs, jsonBytes) ;
+            DR_LOG(log_info) << "outstanding json allocations:                                    " << jsonAllocs << " (" << jsonBytes << " bytes)" ;
+        }
+    }
+
+    void DrachtioController::watchdogThreadFunc() {
+        boost::asio::io_context::work work(m_watchdogIoContext);
+        for(;;) {
+            try {
+                m_watchdogIoContext.run() ;
+                break ;
             }
-            else {
-                ++it ;
+            catch( std::exception& e) {
+                DR_LOG(log_error) << "DrachtioController::watchdogThreadFunc - Error in watchdog thread: " << string( e.what() )  ;
             }
         }
+    }
 
-        bool bMemoryDebug = m_bMemoryDebug || m_bDumpMemory;
-        this->printStats(bMemoryDebug) ;
-        m_pDialogController->logStorageCount(bMemoryDebug) ;
-        m_pClientController->logStorageCount(bMemoryDebug) ;
-        m_pPendingRequestController->logStorageCount(bMemoryDebug) ;
-        m_pProxyController->logStorageCount(bMemoryDebug) ;
+    void DrachtioController::processWatchdogTimer() {
+        DR_LOG(log_debug) << "DrachtioController::processWatchdogTimer"  ;
+    
+        // expire any UaInvalidData that has come due; the wheel has already dropped them
+        std::vector<UaInvalidData*> due ;
+        m_registrationExpiryWheel.advance(time(0), due) ;
+        for (UaInvalidData* pUa : due) {
+            string uri ;
+            pUa->getUri(uri) ;
+            tport_t* tp = pUa->getTport();
+            pUa->setUri(nullptr) ;
+            m_mapUri2InvalidData.erase(uri) ;
+            DR_LOG(log_info) << "DrachtioController::processWatchdogTimer expiring registration for webrtc client: "  << 
+                uri << " " << (void *)tp << ", count is now " << m_mapUri2InvalidData.size()  ;
+        }
+
+        // only take the counts here; logging them, which may mean walking every dialog, is done on the watchdog thread
+        std::shared_ptr<WatchdogSnapshot_t> snapshot = snapshotStats(m_bMemoryDebug || m_bDumpMemory) ;
         m_bDumpMemory = false;
+        m_watchdogIoContext.post(std::bind(&DrachtioController::logStats, this, snapshot)) ;
+    }
+
+    void DrachtioController::configureOverloadControl() {
+        OverloadController::Thresholds_t overloadThresholds ;
+        m_Config->getOverloadThresholds(overloadThresholds) ;
+        m_overloadController.configure(overloadThresholds) ;
+        if (m_overloadController.enabled()) {
+            DR_LOG(log_notice) << "overload control enabled: max pending requests " << overloadThresholds.maxPendingRequests <<
+                ", max loop lag " << overloadThresholds.maxLoopLagMsecs << "ms, max app write backlog " << overloadThresholds.maxAppWriteBacklog <<
+                " bytes, max app transactions " << overloadThresholds.maxAppTransactions ;
+        }
+        else {
+            DR_LOG(log_notice) << "overload control disabled" ;
+        }
+    }
 
-        DR_LOG(bMemoryDebug ? log_info : log_debug) << "m_mapUri2InvalidData size:                                       " << m_mapUri2InvalidData.size()  ;
+    void DrachtioController::processLoopTimer() {
+        // a SIGHUP reload only flags the change; the overload controller belongs to this thread
+        if (m_bReloadOverloadThresholds.exchange(false)) configureOverloadControl() ;
 
-#ifdef SOFIA_MSG_DEBUG_TRACE
-        DR_LOG(bMemoryDebug ? log_info : log_debug) << "number allocated msg_t                                           " << sofia_msg_count()  ;
-#endif
+        auto now = std::chrono::steady_clock::now() ;
+        std::chrono::duration<double> lag = now - m_loopTimerExpires ;
+        STATS_HISTOGRAM_OBSERVE(STATS_HISTOGRAM_SOFIA_LOOP_LAG, lag.count() > 0 ? lag.count() : 0.0)
+        STATS_GAUGE_SET(STATS_GAUGE_SOFIA_MSG_BACKLOG, m_suMsgBacklog.load())
+        if (m_pClientController) {
+            STATS_GAUGE_SET(STATS_GAUGE_APP_QUEUE_DEPTH, m_pClientController->getQueueDepth())
+        }
+        if (m_overloadController.enabled()) {
+            m_overloadController.update(
+                m_pPendingRequestController ? m_pPendingRequestController->getCountOfPendingRequests() : 0,
+                lag.count(),
+                m_pClientController ? m_pClientController->getPendingWriteBytes() : 0,
+                m_pClientController ? m_pClientController->getMaxOutstandingTransactions() : 0) ;
+        }
+
+        m_loopTimerExpires = now + std::chrono::milliseconds(1000) ;
+        su_timer_set(m_loopTimer, loopTimerHandler, this) ;
     }
 
     void DrachtioController::initStats() {
-        STATS_COUNTER_CREATE(STATS_COUNTER_SIP_REQUESTS_IN, "count of sip requests received")
-        STATS_COUNTER_CREATE(STATS_COUNTER_SIP_REQUESTS_OUT, "count of sip requests sent")
-        STATS_COUNTER_CREATE(STATS_COUNTER_SIP_RESPONSES_IN, "count of sip responses received")
-        STATS_COUNTER_CREATE(STATS_COUNTER_SIP_RESPONSES_OUT, "count of sip responses sent")
+        STATS_COUNTER_CREATE_SIP(SIP_REQUESTS_IN, STATS_COUNTER_SIP_REQUESTS_IN, "count of sip requests received")
+        STATS_COUNTER_CREATE_SIP(SIP_REQUESTS_OUT, STATS_COUNTER_SIP_REQUESTS_OUT, "count of sip requests sent")
+        STATS_COUNTER_CREATE_SIP(SIP_RESPONSES_IN, STATS_COUNTER_SIP_RESPONSES_IN, "count of sip responses received")
+        STATS_COUNTER_CREATE_SIP(SIP_RESPONSES_OUT, STATS_COUNTER_SIP_RESPONSES_OUT, "count of sip responses sent")
         STATS_COUNTER_CREATE(STATS_COUNTER_BUILD_INFO, "drachtio version running")
 
         STATS_GAUGE_CREATE(STATS_GAUGE_START_TIME, "drachtio start time")
@@ -2323,6 +2580,38 @@ namespace drachtio {
         STATS_HISTOGRAM_CREATE(STATS_HISTOGRAM_INVITE_PDD_OUT, "call post-dial delay seconds for calls received", 
             {1.0, 2.0, 3.0, 5.0, 7.0, 10.0, 15.0, 20.0})
 
+        // event loops and queues
+        STATS_HISTOGRAM_CREATE(STATS_HISTOGRAM_SOFIA_LOOP_LAG, "delay in seconds beyond the expected time for a 1 second timer in the sofia event loop", 
+            {0.001, 0.005, 0.01, 0.05, 0.1, 0.25, 0.5, 1.0})
+        STATS_HISTOGRAM_CREATE(STATS_HISTOGRAM_SOFIA_CALLBACK_TIME, "time in seconds spent handling a callback in the sofia event loop", 
+            {0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5})
+        STATS_GAUGE_CREATE(STATS_GAUGE_SOFIA_MSG_BACKLOG, "count of messages queued to the sofia event loop from other threads")
+        STATS_HISTOGRAM_CREATE(STATS_HISTOGRAM_APP_HANDLER_TIME, "time in seconds spent executing a handler posted to the application thread", 
+            {0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5})
+        STATS_GAUGE_CREATE(STATS_GAUGE_APP_QUEUE_DEPTH, "count of handlers posted to the application thread that have not yet run")
+        STATS_GAUGE_CREATE(STATS_GAUGE_HTTP_REQUESTS_IN_FLIGHT, "count of http routing requests in progress")
+        STATS_GAUGE_CREATE(STATS_GAUGE_HTTP_EASY_HANDLE_CACHE, "count of idle curl handles in the http request cache")
+        STATS_COUNTER_CREATE(STATS_COUNTER_HTTP_ROUTE_CACHE, "count of http routing decision cache lookups, by result")
+        STATS_GAUGE_CREATE(STATS_GAUGE_HTTP_WORKER_QUEUE_DEPTH, "count of http routing requests assigned to a worker thread that have not completed")
+        STATS_COUNTER_CREATE(STATS_COUNTER_APP_OUTBOUND_POOL, "count of outbound app connections requested, by whether a pooled connection was available")
+        STATS_GAUGE_CREATE(STATS_GAUGE_APP_OUTBOUND_POOL_IDLE, "count of authenticated outbound app connections waiting for a request")
+        STATS_COUNTER_CREATE(STATS_COUNTER_APP_TLS_HANDSHAKES, "count of TLS handshakes on app connections, by direction and whether the session was resumed")
+        STATS_HISTOGRAM_CREATE(STATS_HISTOGRAM_APP_TLS_HANDSHAKE_TIME, "time in seconds to complete a TLS handshake on an app connection",
+            {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0})
+        STATS_HISTOGRAM_CREATE(STATS_HISTOGRAM_APP_WRITE_BATCH, "count of messages sent to an app in a single write when batching is enabled",
+            {1.0, 2.0, 4.0, 8.0, 16.0, 32.0, 64.0, 128.0})
+        STATS_COUNTER_CREATE(STATS_COUNTER_OPTIONS_AUTO_ANSWERED, "count of OPTIONS requests answered without involving an app, by options-responder rule")
+        STATS_COUNTER_CREATE(STATS_COUNTER_HEP_PACKETS, "count of sip messages handled by the HEP capture exporter, by result")
+
+        // overload control
+        STATS_GAUGE_CREATE(STATS_GAUGE_OVERLOAD_ADMIT_RATIO, "share of new requests outside of a dialog currently being accepted")
+        STATS_GAUGE_CREATE(STATS_GAUGE_OVERLOAD_SIGNAL, "latest readings checked by the overload controller, by signal")
+        STATS_COUNTER_CREATE(STATS_COUNTER_OVERLOAD_REJECTED, "count of new requests rejected with 503 due to overload, by method")
+
+        // per-request latency
+        STATS_HISTOGRAM_CREATE(STATS_HISTOGRAM_REQUEST_STAGE_TIME, "time in seconds a new incoming request or its response spent reaching each pipeline stage from the previous one", 
+            {0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0, 5.0})
+
         STATS_COUNTER_INCREMENT(STATS_COUNTER_BUILD_INFO, {{"version", DRACHTIO_VERSION}})
         STATS_GAUGE_SET_TO_CURRENT_TIME(STATS_GAUGE_START_TIME)
     }
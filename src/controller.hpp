@@ -46,6 +46,8 @@ THE SOFTWARE.
 #include <unordered_map>
 #include <unordered_set>
 #include <mutex>
+#include <atomic>
+#include <chrono>
 
 #if defined(__clang__)
     #pragma clang diagnostic push
@@ -75,6 +77,10 @@ THE SOFTWARE.
 #include "sip-transports.hpp"
 #include "request-router.hpp"
 #include "stats-collector.hpp"
+#include "request-tracer.hpp"
+#include "overload-controller.hpp"
+#include "cdr.hpp"
+#include "hep-exporter.hpp"
 #include "blacklist.hpp"
 
 using namespace std ;
@@ -122,11 +128,13 @@ namespace drachtio {
     std::shared_ptr<DrachtioConfig> getConfig(void) { return m_Config; }
     std::shared_ptr<SipDialogController> getDialogController(void) { return m_pDialogController ; }
     std::shared_ptr<ClientController> getClientController(void) { return m_pClientController ; }
+    std::shared_ptr<CdrWriter> getCdrWriter(void) { return m_pCdrWriter ; }
     std::shared_ptr<RequestHandler> getRequestHandler(void) { return m_pRequestHandler ; }
     std::shared_ptr<PendingRequestController> getPendingRequestController(void) { return m_pPendingRequestController ; }
     std::shared_ptr<SipProxyController> getProxyController(void) { return m_pProxyController ; }
     su_root_t* getRoot(void) { return m_root; }
     Blacklist* getBlacklist() { return m_pBlacklist; }
+    HepExporter* getHepExporter() { return m_pHepExporter; }
   
     enum severity_levels getCurrentLoglevel() { return m_current_severity_threshold; }
 
@@ -153,8 +161,15 @@ namespace drachtio {
 
     bool getMySipAddress( const char* proto, string& host, string& port, bool ipv6 = false ) ;
 
-    void printStats(bool bDetail) ;
+    std::shared_ptr<WatchdogSnapshot_t> snapshotStats(bool bDetail) ;
+    void logStats(std::shared_ptr<WatchdogSnapshot_t> snapshot) ;
     void processWatchdogTimer(void) ;
+    void processLoopTimer(void) ;
+    void configureOverloadControl(void) ;
+
+    /* su_msg's sent into the sofia event loop from other threads that have not yet been handled */
+    void suMsgQueued(void) { m_suMsgBacklog++; }
+    void suMsgDequeued(void) { m_suMsgBacklog--; }
 
     const tport_t* getTportForProtocol( const string& remoteHost, const char* proto ) ;
 
@@ -171,6 +186,8 @@ namespace drachtio {
 
     RequestRouter& getRequestRouter(void) { return m_requestRouter; }
     StatsCollector& getStatsCollector(void) { return m_statsCollector; }
+    RequestTracer& getRequestTracer(void) { return m_requestTracer; }
+    OverloadController& getOverloadController(void) { return m_overloadController; }
 
     void makeOutboundConnection(const string& transactionId, const string& uri);
     void makeConnectionForTag(const string& transactionId, const string& tag);
@@ -180,6 +197,17 @@ namespace drachtio {
     bool isNatDetectionDisabled(void) { return m_bDisableNatDetection; }
 
     unsigned int getTcpKeepaliveInterval() { return m_tcpKeepaliveSecs; }
+    unsigned int getHttpMaxConnectionsPerHost() { return m_httpMaxConnectionsPerHost; }
+    unsigned int getHttpRouteCacheTtl() { return m_httpRouteCacheTtl > 0 ? m_httpRouteCacheTtl : 0; }
+    unsigned int getHttpHandlerThreads() { return m_httpHandlerThreads; }
+    unsigned int getOutboundDnsCacheTtl() { return m_outboundDnsCacheTtl > 0 ? m_outboundDnsCacheTtl : 0; }
+    unsigned int getOutboundDnsTimeout() { return m_outboundDnsTimeout; }
+    unsigned int getOutboundPoolMin() { return m_outboundPoolMin; }
+    unsigned int getOutboundPoolMax() { return m_outboundPoolMax; }
+    unsigned int getOutboundPoolIdleTimeout() { return m_outboundPoolIdleTimeout; }
+    unsigned int getAppBatchWindow() { return m_appBatchWindow; }
+    unsigned int getAppBatchMaxBytes() { return m_appBatchMaxBytes; }
+    const string& getAppSelectionPolicy() { return m_strAppSelectionPolicy; }
 
 	private:
 
@@ -196,6 +224,7 @@ namespace drachtio {
   	void logConfig() ;
     int validateSipMessage( sip_t const *sip ) ;
     void initStats(void);
+    void watchdogThreadFunc(void) ;
 
     void processRejectInstruction(const string& transactionId, unsigned int status, const char* reason = NULL) ;
     void processRedirectInstruction(const string& transactionId, vector<string>& vecContact) ;
@@ -236,6 +265,7 @@ namespace drachtio {
     string m_strHomerAddress;
     unsigned int m_nHomerPort;
     uint32_t m_nHomerId;
+    string m_strHomerSample;
     string m_secret;
     string m_adminAddress;
     string m_redisAddress;
@@ -245,13 +275,16 @@ namespace drachtio {
     string m_redisKey;
     unsigned int m_redisPort;
     unsigned int m_redisRefreshSecs;
+    string m_redisChannel;
 
     std::shared_ptr<ClientController> m_pClientController ;
+    std::shared_ptr<CdrWriter> m_pCdrWriter ;
     std::shared_ptr<RequestHandler> m_pRequestHandler ;
     std::shared_ptr<SipDialogController> m_pDialogController ;
     std::shared_ptr<SipProxyController> m_pProxyController ;
     std::shared_ptr<PendingRequestController> m_pPendingRequestController ;
     Blacklist *m_pBlacklist ;
+    HepExporter *m_pHepExporter ;
 
     std::shared_ptr<StackMsg> m_lastSentMsg ;
     std::shared_ptr<StackMsg> m_lastRecvMsg ;
@@ -259,6 +292,12 @@ namespace drachtio {
     su_home_t* 	m_home ;
     su_root_t* 	m_root ;
     su_timer_t*     m_timer ;
+    boost::asio::io_context m_watchdogIoContext ;
+    std::thread     m_watchdogThread ;
+    su_timer_t*     m_loopTimer ;
+    std::chrono::time_point<std::chrono::steady_clock> m_loopTimerExpires ;
+    std::atomic<int> m_suMsgBacklog ;
+    std::atomic<bool> m_bReloadOverloadThresholds ;
     nta_agent_t*	m_nta ;
     nta_leg_t*      m_defaultLeg ;
   	su_clone_r 	m_clone ;
@@ -267,13 +306,28 @@ namespace drachtio {
     
     typedef std::unordered_map<string, std::shared_ptr<UaInvalidData> > mapUri2InvalidData ;
     mapUri2InvalidData m_mapUri2InvalidData ;
+    UaInvalidExpiryWheel m_registrationExpiryWheel ;
 
     bool    m_bIsOutbound ;
     string  m_strRequestServer ;
     string  m_strRequestPath ;
+    unsigned int m_httpMaxConnectionsPerHost ;
+    int m_httpRouteCacheTtl ;
+    unsigned int m_httpHandlerThreads ;
+    int m_outboundDnsCacheTtl ;
+    unsigned int m_outboundDnsTimeout ;
+    unsigned int m_outboundPoolMin ;
+    unsigned int m_outboundPoolMax ;
+    unsigned int m_outboundPoolIdleTimeout ;
+    unsigned int m_appBatchWindow ;
+    unsigned int m_appBatchMaxBytes ;
+    string m_strAppSelectionPolicy ;
 
     RequestRouter   m_requestRouter ;
     StatsCollector  m_statsCollector;
+    RequestTracer   m_requestTracer;
+    OverloadController m_overloadController;
+    unsigned int    m_requestTraceSampleRate;
 
     bool    m_bAggressiveNatDetection;
     string m_strPrometheusAddress;
@@ -297,6 +351,26 @@ namespace drachtio {
     string  m_strUserAgentAutoAnswerOptions;
   } ;
 
+  /* observes the time spent handling a callback in the sofia event loop, when metrics are enabled */
+  class SofiaCallbackTimer {
+  public:
+    SofiaCallbackTimer(const char* callback) : m_callback(callback),
+      m_enabled(theOneAndOnlyController->getStatsCollector().enabled()) {
+      if (m_enabled) m_start = std::chrono::steady_clock::now();
+    }
+    ~SofiaCallbackTimer() {
+      if (m_enabled) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+        STATS_HISTOGRAM_OBSERVE_NOCHECK(STATS_HISTOGRAM_SOFIA_CALLBACK_TIME, elapsed.count(), {{"callback", m_callback}})
+      }
+    }
+
+  private:
+    const char* m_callback;
+    bool m_enabled;
+    std::chrono::time_point<std::chrono::steady_clock> m_start;
+  } ;
+
 } ;
 
 
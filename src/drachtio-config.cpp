@@ -42,7 +42,11 @@ namespace drachtio {
     public:
         Impl( const char* szFilename, bool isDaemonized) : m_bIsValid(false), m_adminTcpPort(0), m_adminTlsPort(0), m_bDaemon(isDaemonized), 
         m_bConsoleLogger(false), m_captureHepVersion(3), m_mtu(0), m_bAggressiveNatDetection(false), 
-        m_prometheusPort(0), m_prometheusAddress("0.0.0.0"), m_tcpKeepalive(45), m_minTlsVersion(0) {
+        m_prometheusPort(0), m_prometheusAddress("0.0.0.0"), m_requestTraceSampleRate(0),
+        m_httpMaxConnectionsPerHost(0), m_httpRouteCacheTtl(0), m_httpHandlerThreads(1),
+        m_outboundDnsCacheTtl(30), m_outboundDnsTimeout(2000),
+        m_outboundPoolMin(0), m_outboundPoolMax(8), m_outboundPoolIdleTimeout(60),
+        m_appBatchWindow(0), m_appBatchMaxBytes(65536), m_tcpKeepalive(45), m_minTlsVersion(0) {
 
             // default timers
             m_nTimerT1 = 500 ;
@@ -70,6 +74,9 @@ namespace drachtio {
                     m_adminAddress = pt.get<string>("drachtio.admin") ;
                     string tlsValue =  pt.get<string>("drachtio.admin.<xmlattr>.tls", "false") ;
                     m_tcpKeepalive = pt.get<unsigned int>("drachtio.admin.<xmlattr>.tcp-keepalive", 45);
+                    m_appBatchWindow = pt.get<unsigned int>("drachtio.admin.<xmlattr>.batch-window", 0);
+                    m_appBatchMaxBytes = pt.get<unsigned int>("drachtio.admin.<xmlattr>.batch-max-bytes", 65536);
+                    m_appSelectionPolicy = pt.get<string>("drachtio.admin.<xmlattr>.selection-policy", "round-robin");
                 } catch( boost::property_tree::ptree_bad_path& e ) {
                     cerr << "XML tag <admin> not found; this is required to provide admin socket details" << endl ;
                     return ;
@@ -123,6 +130,7 @@ namespace drachtio {
                     m_captureServerPort = pt.get<unsigned int>("drachtio.sip.capture-server.<xmlattr>.port", 9060) ;
                     m_captureServerAgentId = pt.get<uint32_t>("drachtio.sip.capture-server.<xmlattr>.id", 0) ;
                     m_captureHepVersion = pt.get<unsigned int>("drachtio.sip.capture-server.<xmlattr>.hep-version", 3) ;
+                    m_captureSample = pt.get<string>("drachtio.sip.capture-server.<xmlattr>.sample", "") ;
                     m_captureServerAddress = pt.get<string>("drachtio.sip.capture-server") ;
 
                     if (0 == m_captureServerAddress.length() || 0 == m_captureServerAgentId) {
@@ -149,6 +157,7 @@ namespace drachtio {
                     m_redisPort = pt.get<unsigned int>("drachtio.sip.blacklist.redis-port", 6379) ;
                     m_redisKey = pt.get<string>("drachtio.sip.blacklist.redis-key", "") ;
                     m_redisRefreshSecs = pt.get<unsigned int>("drachtio.sip.blacklist.refresh-secs", 0) ;
+                    m_redisChannel = pt.get<string>("drachtio.sip.blacklist.redis-channel", "") ;
 
                     if ( (m_redisAddress.empty() && m_redisSentinels.empty())) {
                         cerr << "invalid blacklist config: either redis-address or redis-sentinels must be specified" << endl;
@@ -182,6 +191,14 @@ namespace drachtio {
                 m_tlsChainFile = pt.get<string>("drachtio.sip.tls.chain-file", "") ;
                 m_dhParam = pt.get<string>("drachtio.sip.tls.dh-param", "") ;
 
+                m_httpMaxConnectionsPerHost = pt.get<unsigned int>("drachtio.request-handlers.<xmlattr>.max-connections-per-host", 0) ;
+                m_httpRouteCacheTtl = pt.get<unsigned int>("drachtio.request-handlers.<xmlattr>.route-cache-ttl", 0) ;
+                m_httpHandlerThreads = pt.get<unsigned int>("drachtio.request-handlers.<xmlattr>.threads", 1) ;
+                m_outboundDnsCacheTtl = pt.get<unsigned int>("drachtio.request-handlers.<xmlattr>.outbound-dns-cache-ttl", 30) ;
+                m_outboundDnsTimeout = pt.get<unsigned int>("drachtio.request-handlers.<xmlattr>.outbound-dns-timeout", 2000) ;
+                m_outboundPoolMin = pt.get<unsigned int>("drachtio.request-handlers.<xmlattr>.outbound-pool-min", 0) ;
+                m_outboundPoolMax = pt.get<unsigned int>("drachtio.request-handlers.<xmlattr>.outbound-pool-max", 8) ;
+                m_outboundPoolIdleTimeout = pt.get<unsigned int>("drachtio.request-handlers.<xmlattr>.outbound-pool-idle-timeout", 60) ;
                 try {
                      BOOST_FOREACH(ptree::value_type &v, pt.get_child("drachtio.request-handlers")) {
                         if( 0 == v.first.compare("request-handler") ) {
@@ -214,6 +231,9 @@ namespace drachtio {
                 } catch( boost::property_tree::ptree_bad_path& e ) {
                 }
 
+                /* request tracing */
+                m_requestTraceSampleRate = pt.get<unsigned int>("drachtio.monitoring.request-trace.<xmlattr>.sample-rate", 0) ;
+
                 /* logging configuration  */
  
                 m_nSofiaLogLevel = pt.get<unsigned int>("drachtio.logging.sofia-loglevel", 1) ;
@@ -281,6 +301,9 @@ namespace drachtio {
                                 }
                                 std::transform(header.begin(), header.end(), header.begin(), ::tolower) ;
                                 m_mapSpammers.insert( make_pair( header,vec ) ) ;
+                                if( !m_spammerMatcher.add( header, vec ) ) {
+                                    cerr << "spammer checking is not supported for header " << header << ", ignoring" << endl ;
+                                }
                             }
                         }
                         m_actionSpammer = pt.get<string>("drachtio.sip.spammers.<xmlattr>.action", "discard") ;
@@ -289,12 +312,39 @@ namespace drachtio {
                 } catch( boost::property_tree::ptree_bad_path& e ) {
                     //no spammer config...its optional
                 }
+                m_spammerMatcher.compile() ;
+
+                // OPTIONS pings we answer without involving an app
+                try {
+                    BOOST_FOREACH(ptree::value_type &v, pt.get_child("drachtio.sip.options-responder")) {
+                        if( 0 == v.first.compare("rule") ) {
+                            string name = v.second.get<string>("<xmlattr>.name", "") ;
+                            string source = v.second.get<string>("<xmlattr>.source", "") ;
+                            string userAgent = v.second.get<string>("<xmlattr>.user-agent", "") ;
+                            string requestUriUser = v.second.get<string>("<xmlattr>.request-uri-user", "") ;
+                            if( name.empty() ) name = "rule" + std::to_string( m_optionsResponder.size() ) ;
+                            if( !m_optionsResponder.add( name, source, userAgent, requestUriUser ) ) {
+                                cerr << "invalid options-responder rule " << name << 
+                                    ": it needs a source, user-agent or request-uri-user to match on, and source must be a valid network; ignoring" << endl ;
+                            }
+                        }
+                    }
+                } catch( boost::property_tree::ptree_bad_path& e ) {
+                    //no options responder config...its optional
+                }
 
                 string cdrs = pt.get<string>("drachtio.cdrs", "") ;
                 transform(cdrs.begin(), cdrs.end(), cdrs.begin(), ::tolower);
                 m_bGenerateCdrs = ( 0 == cdrs.compare("true") || 0 == cdrs.compare("yes") ) ;
+                m_cdrFile = pt.get<string>("drachtio.cdrs.<xmlattr>.file", "") ;
 
                 m_mtu = pt.get<unsigned int>("drachtio.sip.udp-mtu", 0);
+
+                m_overloadThresholds.maxPendingRequests = pt.get<unsigned int>("drachtio.sip.overload.<xmlattr>.max-pending-requests", 0) ;
+                m_overloadThresholds.maxLoopLagMsecs = pt.get<unsigned int>("drachtio.sip.overload.<xmlattr>.max-loop-lag", 0) ;
+                m_overloadThresholds.maxAppWriteBacklog = pt.get<uint64_t>("drachtio.sip.overload.<xmlattr>.max-app-write-backlog", 0) ;
+                m_overloadThresholds.maxAppTransactions = pt.get<unsigned int>("drachtio.sip.overload.<xmlattr>.max-app-transactions", 0) ;
+                m_overloadThresholds.retryAfter = pt.get<unsigned int>("drachtio.sip.overload.<xmlattr>.retry-after", 5) ;
                 
                 fb.close() ;
                                                
@@ -386,6 +436,10 @@ namespace drachtio {
             return m_bGenerateCdrs ;
         }
 
+        const string& getCdrFile(void) const {
+            return m_cdrFile ;
+        }
+
         void getTimers( unsigned int& t1, unsigned int& t2, unsigned int& t4, unsigned int& t1x64 ) {
             t1 = m_nTimerT1 ;
             t2 = m_nTimerT2 ;
@@ -401,6 +455,22 @@ namespace drachtio {
             return m_mapSpammers ;
         }
 
+        const OptionsResponder& getOptionsResponder( void ) {
+            return m_optionsResponder ;
+        }
+
+        void getOverloadThresholds( OverloadController::Thresholds_t& thresholds ) {
+            thresholds = m_overloadThresholds ;
+        }
+
+        const SpammerMatcher& getSpammerMatcher( string& action, string& tcpAction ) {
+            if( !m_spammerMatcher.empty() ) {
+                action = m_actionSpammer ;
+                tcpAction = m_tcpActionSpammer ;
+            }
+            return m_spammerMatcher ;
+        }
+
         void getTransports(std::vector< std::shared_ptr<SipTransport> >& transports) const {
             transports = m_vecTransports ;
         }
@@ -430,6 +500,12 @@ namespace drachtio {
             return true;
         }
 
+        bool getBlacklistChannel(string& redisChannel) {
+            if (m_redisChannel.empty()) return false;
+            redisChannel = m_redisChannel;
+            return true;
+        }
+
         bool getAutoAnswerOptionsUserAgent(string& userAgent) {
             if (0 == m_autoAnswerOptionsUserAgent.length()) return false;
             userAgent = m_autoAnswerOptionsUserAgent;
@@ -455,6 +531,57 @@ namespace drachtio {
             return m_tcpKeepalive;
         }
 
+        unsigned int getRequestTraceSampleRate() {
+            return m_requestTraceSampleRate;
+        }
+
+        unsigned int getHttpMaxConnectionsPerHost() {
+            return m_httpMaxConnectionsPerHost;
+        }
+
+        unsigned int getHttpRouteCacheTtl() {
+            return m_httpRouteCacheTtl;
+        }
+
+        unsigned int getHttpHandlerThreads() {
+            return m_httpHandlerThreads;
+        }
+
+        unsigned int getOutboundDnsCacheTtl() {
+            return m_outboundDnsCacheTtl;
+        }
+
+        unsigned int getOutboundDnsTimeout() {
+            return m_outboundDnsTimeout;
+        }
+
+        unsigned int getOutboundPoolMin() {
+            return m_outboundPoolMin;
+        }
+
+        unsigned int getOutboundPoolMax() {
+            return m_outboundPoolMax;
+        }
+
+        unsigned int getOutboundPoolIdleTimeout() {
+            return m_outboundPoolIdleTimeout;
+        }
+
+        unsigned int getAppBatchWindow() {
+            return m_appBatchWindow;
+        }
+
+        unsigned int getAppBatchMaxBytes() {
+            return m_appBatchMaxBytes;
+        }
+
+        const string& getAppSelectionPolicy() {
+            return m_appSelectionPolicy;
+        }
+        const string& getCaptureSample() {
+            return m_captureSample;
+        }
+
         bool getMinTlsVersion(float& minTlsVersion) {
             if (m_minTlsVersion > 0) {
                 minTlsVersion = m_minTlsVersion;
@@ -505,22 +632,39 @@ namespace drachtio {
         unsigned int m_adminTlsPort ;
         string m_secret ;
         bool m_bGenerateCdrs ;
+        string m_cdrFile ;
         bool m_bDaemon;
         bool m_bConsoleLogger ;
         unsigned int m_nTimerT1, m_nTimerT2, m_nTimerT4, m_nTimerT1x64 ;
         string m_actionSpammer ;
         string m_tcpActionSpammer ;
         mapHeader2Values m_mapSpammers ;
+        SpammerMatcher m_spammerMatcher ;
+        OptionsResponder m_optionsResponder ;
+        OverloadController::Thresholds_t m_overloadThresholds ;
         std::vector< std::shared_ptr<SipTransport> >  m_vecTransports;
         RequestRouter m_router ;
         string m_captureServerAddress ;
         unsigned int m_captureServerPort;
         uint32_t m_captureServerAgentId ;
         unsigned int m_captureHepVersion ;
+        string m_captureSample ;
         unsigned int m_mtu;
         bool m_bAggressiveNatDetection;
         string m_prometheusAddress;
         unsigned int m_prometheusPort;
+        unsigned int m_requestTraceSampleRate;
+        unsigned int m_httpMaxConnectionsPerHost;
+        unsigned int m_httpRouteCacheTtl;
+        unsigned int m_httpHandlerThreads;
+        unsigned int m_outboundDnsCacheTtl;
+        unsigned int m_outboundDnsTimeout;
+        unsigned int m_outboundPoolMin;
+        unsigned int m_outboundPoolMax;
+        unsigned int m_outboundPoolIdleTimeout;
+        unsigned int m_appBatchWindow;
+        unsigned int m_appBatchMaxBytes;
+        string m_appSelectionPolicy;
         unsigned int m_tcpKeepalive;
         float m_minTlsVersion;
         string m_redisAddress;
@@ -530,6 +674,7 @@ namespace drachtio {
         unsigned int m_redisPort;
         string m_redisKey;
         unsigned int m_redisRefreshSecs;
+        string m_redisChannel;
         string m_autoAnswerOptionsUserAgent;
         bool m_bRejectRegisterWithNoRealm;
 
@@ -594,12 +739,24 @@ namespace drachtio {
     bool DrachtioConfig::generateCdrs(void) const {
         return m_pimpl->generateCdrs() ;
     }
+    const string& DrachtioConfig::getCdrFile(void) const {
+        return m_pimpl->getCdrFile() ;
+    }
     void DrachtioConfig::getTimers( unsigned int& t1, unsigned int& t2, unsigned int& t4, unsigned int& t1x64 ) {
         return m_pimpl->getTimers( t1, t2, t4, t1x64 ) ;
     }
     DrachtioConfig::mapHeader2Values& DrachtioConfig::getSpammers( string& action, string& tcpAction ) {
         return m_pimpl->getSpammers( action, tcpAction ) ;
     }
+    const SpammerMatcher& DrachtioConfig::getSpammerMatcher( string& action, string& tcpAction ) {
+        return m_pimpl->getSpammerMatcher( action, tcpAction ) ;
+    }
+    const OptionsResponder& DrachtioConfig::getOptionsResponder( void ) {
+        return m_pimpl->getOptionsResponder() ;
+    }
+    void DrachtioConfig::getOverloadThresholds( OverloadController::Thresholds_t& thresholds ) const {
+        m_pimpl->getOverloadThresholds( thresholds ) ;
+    }
     void DrachtioConfig::getTransports(std::vector< std::shared_ptr<SipTransport> >& transports) const {
         return m_pimpl->getTransports(transports) ;
     }
@@ -622,6 +779,57 @@ namespace drachtio {
     unsigned int DrachtioConfig::getTcpKeepalive() const {
         return m_pimpl->getTcpKeepalive();
     }
+
+    unsigned int DrachtioConfig::getRequestTraceSampleRate() const {
+        return m_pimpl->getRequestTraceSampleRate();
+    }
+
+    unsigned int DrachtioConfig::getHttpMaxConnectionsPerHost() const {
+        return m_pimpl->getHttpMaxConnectionsPerHost();
+    }
+
+    unsigned int DrachtioConfig::getHttpRouteCacheTtl() const {
+        return m_pimpl->getHttpRouteCacheTtl();
+    }
+
+    unsigned int DrachtioConfig::getHttpHandlerThreads() const {
+        return m_pimpl->getHttpHandlerThreads();
+    }
+
+    unsigned int DrachtioConfig::getOutboundDnsCacheTtl() const {
+        return m_pimpl->getOutboundDnsCacheTtl();
+    }
+
+    unsigned int DrachtioConfig::getOutboundDnsTimeout() const {
+        return m_pimpl->getOutboundDnsTimeout();
+    }
+
+    unsigned int DrachtioConfig::getOutboundPoolMin() const {
+        return m_pimpl->getOutboundPoolMin();
+    }
+
+    unsigned int DrachtioConfig::getOutboundPoolMax() const {
+        return m_pimpl->getOutboundPoolMax();
+    }
+
+    unsigned int DrachtioConfig::getOutboundPoolIdleTimeout() const {
+        return m_pimpl->getOutboundPoolIdleTimeout();
+    }
+
+    unsigned int DrachtioConfig::getAppBatchWindow() const {
+        return m_pimpl->getAppBatchWindow();
+    }
+
+    unsigned int DrachtioConfig::getAppBatchMaxBytes() const {
+        return m_pimpl->getAppBatchMaxBytes();
+    }
+
+    const string& DrachtioConfig::getAppSelectionPolicy() const {
+        return m_pimpl->getAppSelectionPolicy();
+    }
+    const string& DrachtioConfig::getCaptureSample() const {
+        return m_pimpl->getCaptureSample();
+    }
         
     bool DrachtioConfig::getMinTlsVersion(float& minTlsVersion) const {
         return m_pimpl->getMinTlsVersion(minTlsVersion);
@@ -631,6 +839,10 @@ namespace drachtio {
         return m_pimpl->getBlacklistServer(redisAddress, redisSentinels, redisMaster, redisPort, redisKey, redisRefreshSecs);
     }
 
+    bool DrachtioConfig::getBlacklistChannel(string& redisChannel) const {
+        return m_pimpl->getBlacklistChannel(redisChannel);
+    }
+
     bool DrachtioConfig::getAutoAnswerOptionsUserAgent(string& userAgent) const {
         return m_pimpl->getAutoAnswerOptionsUserAgent(userAgent);
     }
@@ -31,6 +31,9 @@ THE SOFTWARE.
 #include "drachtio.h"
 #include "sip-transports.hpp"
 #include "request-router.hpp"
+#include "spammer-matcher.hpp"
+#include "options-responder.hpp"
+#include "overload-controller.hpp"
 
 using namespace std ;
 
@@ -73,10 +76,18 @@ namespace drachtio {
 
         bool generateCdrs(void) const ;
 
+        const string& getCdrFile(void) const ;
+
         void getTimers( unsigned int& t1, unsigned int& t2, unsigned int& t4, unsigned int& t1x64 ) ;
 
         mapHeader2Values& getSpammers( string& action, string& tcpAction ) ;
 
+        const SpammerMatcher& getSpammerMatcher( string& action, string& tcpAction ) ;
+
+        const OptionsResponder& getOptionsResponder( void ) ;
+
+        void getOverloadThresholds( OverloadController::Thresholds_t& thresholds ) const ;
+
         void getRequestRouter( RequestRouter& router ) ;
 
         bool getCaptureServer(string& address, unsigned int& port, uint32_t& agentId, unsigned int& version);
@@ -87,10 +98,37 @@ namespace drachtio {
 
         unsigned int getTcpKeepalive() const;
 
+        unsigned int getRequestTraceSampleRate() const;
+
+        unsigned int getHttpMaxConnectionsPerHost() const;
+
+        unsigned int getHttpRouteCacheTtl() const;
+
+        unsigned int getHttpHandlerThreads() const;
+
+        unsigned int getOutboundDnsCacheTtl() const;
+
+        unsigned int getOutboundDnsTimeout() const;
+
+        unsigned int getOutboundPoolMin() const;
+
+        unsigned int getOutboundPoolMax() const;
+
+        unsigned int getOutboundPoolIdleTimeout() const;
+
+        unsigned int getAppBatchWindow() const;
+
+        unsigned int getAppBatchMaxBytes() const;
+
+        const string& getAppSelectionPolicy() const;
+        const string& getCaptureSample() const;
+
         bool getMinTlsVersion(float& minTlsVersion) const;
 
         bool getBlacklistServer(string& redisAddress, string& redisSentinels, string& redisMaster, string& redisPassword, unsigned int& redisPort, string& redisKey, unsigned int& redisRefreshSecs) const;
 
+        bool getBlacklistChannel(string& redisChannel) const;
+
         bool getAutoAnswerOptionsUserAgent(string& userAgent) const;
 
         bool rejectRegisterWithNoRealm() const;
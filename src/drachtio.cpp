@@ -30,6 +30,8 @@ THE SOFTWARE.
 #include <unordered_map>
 #include <unordered_set>
 #include <mutex>
+#include <atomic>
+#include <cstddef>
 #include <algorithm>
 #include <regex>
 
@@ -61,9 +63,12 @@ THE SOFTWARE.
 using namespace std ;
  
 namespace {
-    unsigned int json_allocs = 0 ;
-    unsigned int json_bytes = 0 ;
-    std::mutex  json_lock ;
+    // jansson allocation accounting; counters only, so no lock is needed
+    std::atomic<unsigned int> json_allocs(0) ;
+    std::atomic<size_t> json_bytes(0) ;
+
+    // size is stored ahead of each block, padded so the block keeps malloc's alignment
+    const size_t JSON_ALLOC_HEADER = alignof(std::max_align_t) ;
 } ;
 
 namespace drachtio {
@@ -532,33 +537,32 @@ namespace drachtio {
     }
 
     void* my_json_malloc( size_t bytes ) {
-        std::lock_guard<std::mutex> l( json_lock ) ;
-
-        json_allocs++ ;
-        json_bytes += bytes ;
-        //DR_LOG(log_debug) << "my_json_malloc: alloc'ing " << bytes << " bytes; outstanding allocations: " << json_allocs << ", outstanding memory size: " << json_bytes << endl ;
-
         /* store size at the beginnng of the block */
-        void *ptr = malloc( bytes + 8 ) ;
+        void *ptr = malloc( bytes + JSON_ALLOC_HEADER ) ;
+        if( !ptr ) return NULL ;
         *((size_t *)ptr) = bytes ;
+
+        json_allocs.fetch_add( 1, std::memory_order_relaxed ) ;
+        json_bytes.fetch_add( bytes, std::memory_order_relaxed ) ;
  
-        return (void*) ((char*) ptr + 8);
+        return (void*) ((char*) ptr + JSON_ALLOC_HEADER);
     }
 
     void my_json_free( void* ptr ) {
-       std::lock_guard<std::mutex> l( json_lock ) ;
+        if( !ptr ) return ;
 
-        size_t size;
-        ptr = (void *) ((char *) ptr - 8) ;
-        size = *((size_t *)ptr);
+        ptr = (void *) ((char *) ptr - JSON_ALLOC_HEADER) ;
+        size_t size = *((size_t *)ptr);
 
-        json_allocs-- ;
-        json_bytes -= size ;
-        //DR_LOG(log_debug) << "my_json_free: freeing " << size << " bytes; outstanding allocations: " << json_allocs << ", outstanding memory size: " << json_bytes << endl ;
+        json_allocs.fetch_sub( 1, std::memory_order_relaxed ) ;
+        json_bytes.fetch_sub( size, std::memory_order_relaxed ) ;
 
-        /* zero memory in debug mode */
-        memset( ptr, 0, size + 8 ) ;
+        free( ptr ) ;
+    }
 
+    void getJsonAllocationStats( unsigned int& allocs, size_t& bytes ) {
+        allocs = json_allocs.load( std::memory_order_relaxed ) ;
+        bytes = json_bytes.load( std::memory_order_relaxed ) ;
     }
 
     void splitLines( const string& s, vector<string>& vec ) {
@@ -578,9 +582,12 @@ namespace drachtio {
             return ;
         }
         meta = msg.substr(0, pos) ;
-        string chunk = msg.substr(pos+DR_CRLF.length()) ;
+        splitSipMsg( msg.substr(pos+DR_CRLF.length()), startLine, headers, body ) ;
+    }
 
-        pos = chunk.find( DR_CRLF2 ) ;
+    void splitSipMsg( const string& sipMsg, string& startLine, string& headers, string& body ) {
+        string chunk = sipMsg ;
+        size_t pos = chunk.find( DR_CRLF2 ) ;
         if( string::npos != pos  ) {
             body = chunk.substr( pos + DR_CRLF2.length() ) ;
             chunk = chunk.substr( 0, pos ) ;
@@ -1043,6 +1050,22 @@ namespace drachtio {
         m_bytes.assign( szTmp ) ;
     }
 
+    void WatchdogSnapshot_t::log(void) const {
+        for (const Line_t& line : m_lines) {
+            if (line.label) {
+                DR_LOG(m_bDetail ? log_info : log_debug) << line.label << line.value ;
+            }
+            else {
+                DR_LOG(m_bDetail ? log_info : log_debug) << line.detail ;
+            }
+        }
+        if (theOneAndOnlyController->getStatsCollector().enabled()) {
+            for (const auto& gauge : m_gauges) {
+                STATS_GAUGE_SET_NOCHECK(*gauge.first, gauge.second)
+            }
+        }
+    }
+
      int ackResponse( msg_t* msg ) {
         nta_agent_t* nta = theOneAndOnlyController->getAgent() ;
         sip_t *sip = sip_object(msg);
@@ -32,6 +32,7 @@ THE SOFTWARE.
 #include <iostream>
 #include <unordered_map>
 #include <chrono>
+#include <vector>
 
 #if defined(__clang__)
     #pragma clang diagnostic push
@@ -103,6 +104,32 @@ const string STATS_HISTOGRAM_INVITE_RESPONSE_TIME_OUT = "drachtio_call_answer_se
 const string STATS_HISTOGRAM_INVITE_PDD_IN = "drachtio_call_pdd_seconds_in";
 const string STATS_HISTOGRAM_INVITE_PDD_OUT = "drachtio_call_pdd_seconds_out";
 
+// event loops and queues
+const string STATS_HISTOGRAM_SOFIA_LOOP_LAG = "drachtio_sofia_loop_lag_seconds";
+const string STATS_HISTOGRAM_SOFIA_CALLBACK_TIME = "drachtio_sofia_callback_seconds";
+const string STATS_GAUGE_SOFIA_MSG_BACKLOG = "drachtio_sofia_msg_backlog";
+const string STATS_HISTOGRAM_APP_HANDLER_TIME = "drachtio_app_handler_seconds";
+const string STATS_GAUGE_APP_QUEUE_DEPTH = "drachtio_app_queue_depth";
+const string STATS_GAUGE_HTTP_REQUESTS_IN_FLIGHT = "drachtio_http_requests_in_flight";
+const string STATS_GAUGE_HTTP_EASY_HANDLE_CACHE = "drachtio_http_easy_handle_cache_size";
+const string STATS_COUNTER_HTTP_ROUTE_CACHE = "drachtio_http_route_cache_total";
+const string STATS_GAUGE_HTTP_WORKER_QUEUE_DEPTH = "drachtio_http_worker_queue_depth";
+const string STATS_COUNTER_APP_OUTBOUND_POOL = "drachtio_app_outbound_pool_total";
+const string STATS_GAUGE_APP_OUTBOUND_POOL_IDLE = "drachtio_app_outbound_pool_idle";
+const string STATS_COUNTER_APP_TLS_HANDSHAKES = "drachtio_app_tls_handshakes_total";
+const string STATS_HISTOGRAM_APP_TLS_HANDSHAKE_TIME = "drachtio_app_tls_handshake_seconds";
+const string STATS_HISTOGRAM_APP_WRITE_BATCH = "drachtio_app_write_batch_messages";
+const string STATS_COUNTER_OPTIONS_AUTO_ANSWERED = "drachtio_options_auto_answered_total";
+const string STATS_COUNTER_HEP_PACKETS = "drachtio_hep_packets_total";
+
+// overload control
+const string STATS_GAUGE_OVERLOAD_ADMIT_RATIO = "drachtio_overload_admit_ratio";
+const string STATS_GAUGE_OVERLOAD_SIGNAL = "drachtio_overload_signal";
+const string STATS_COUNTER_OVERLOAD_REJECTED = "drachtio_overload_rejected_total";
+
+// per-request latency, by pipeline stage
+const string STATS_HISTOGRAM_REQUEST_STAGE_TIME = "drachtio_request_stage_seconds";
+
 #define TIMER_C_MSECS (185000)
 #define TIMER_B_MSECS (NTA_SIP_T1 * 64)
 #define TIMER_D_MSECS (32500)
@@ -170,12 +197,16 @@ namespace drachtio {
 
 	void my_json_free( void* ptr ) ;
 
+	void getJsonAllocationStats( unsigned int& allocs, size_t& bytes ) ;
+
 	void splitLines( const std::string& s, std::vector<std::string>& vec ) ;
 
 	void splitTokens( const std::string& s, std::vector<std::string>& vec ) ;
 
 	void splitMsg( const string& msg, string& meta, string& startLine, string& headers, string& body ) ;
 
+	void splitSipMsg( const string& sipMsg, string& startLine, string& headers, string& body ) ;
+
 	sip_method_t parseStartLine( const string& startLine, string& methodName, string& requestUri ) ;
 
 	bool FindValueForHeader( const string& headers, const char* hdrName, string& hdrValue) ;
@@ -242,6 +273,36 @@ namespace drachtio {
 		string		m_destAddress;
 		string		m_destPort;
 	} ;
+
+	/* 
+	 * counts gathered on the sofia thread by the watchdog timer; these are cheap to take, 
+	 * while logging them and updating the metrics is left to the watchdog thread 
+	 */
+	class WatchdogSnapshot_t {
+	public:
+		WatchdogSnapshot_t(bool detail) : m_bDetail(detail) {}
+
+		bool isDetail(void) const { return m_bDetail; }
+		void addCount(const char* label, size_t value) { m_lines.push_back(Line_t(label, value)); }
+		void addDetail(string&& line) { m_lines.push_back(Line_t(std::move(line))); }
+		void addGauge(const string& name, double value) { m_gauges.push_back(make_pair(&name, value)); }
+
+		void log(void) const ;
+
+	private:
+		struct Line_t {
+			Line_t(const char* l, size_t v) : label(l), value(v) {}
+			Line_t(string&& d) : label(nullptr), value(0), detail(std::move(d)) {}
+
+			const char* label ;
+			size_t value ;
+			string detail ;
+		} ;
+
+		bool m_bDetail ;
+		vector<Line_t> m_lines ;
+		vector< pair<const string*, double> > m_gauges ;
+	} ;
  }
 
 typedef boost::tokenizer<boost::char_separator<char> > tokenizer ;
@@ -270,6 +331,20 @@ extern drachtio::DrachtioController* theOneAndOnlyController ;
 }
 #define STATS_COUNTER_INCREMENT_NOCHECK(...) theOneAndOnlyController->getStatsCollector().counterIncrement(__VA_ARGS__) ;
 
+#define STATS_COUNTER_CREATE_SIP(which, name, desc) \
+{ \
+	if (theOneAndOnlyController->getStatsCollector().enabled()) { \
+		theOneAndOnlyController->getStatsCollector().sipCounterCreate(drachtio::StatsCollector::which, name, desc); \
+	} \
+}
+
+#define STATS_COUNTER_INCREMENT_SIP(which, ...) \
+{ \
+	if (theOneAndOnlyController->getStatsCollector().enabled()) { \
+		theOneAndOnlyController->getStatsCollector().sipCounterIncrement(drachtio::StatsCollector::which, __VA_ARGS__) ;\
+	} \
+}
+
 #define STATS_COUNTER_INCREMENT_BY(...) \
 { \
 	if (theOneAndOnlyController->getStatsCollector().enabled()) { \
@@ -0,0 +1,352 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <netdb.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <strings.h>
+
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <functional>
+
+#include "hep-exporter.hpp"
+#include "controller.hpp"
+
+#define HEP_BATCH_SIZE (32)
+#define HEP_MAX_PACKET (65507)            // largest udp payload
+#define HEP_CAPTURE_RCVBUF (4 * 1024 * 1024)
+#define HEP_RECV_TIMEOUT_MSECS (100)
+#define HEP_INVITE_CALL_IDLE_SECS (3600)
+#define HEP_SWEEP_INTERVAL_SECS (60)
+
+namespace {
+
+  // HEPv3 chunk types (vendor 0)
+  const uint16_t HEP_CHUNK_PAYLOAD = 0x000f ;
+  const uint16_t HEP_CHUNK_CORRELATION_ID = 0x0011 ;
+
+  uint16_t get16( const uint8_t* p ) {
+    uint16_t val ;
+    memcpy( &val, p, sizeof(val) ) ;
+    return ntohs( val ) ;
+  }
+  void put16( uint8_t* p, uint16_t val ) {
+    val = htons( val ) ;
+    memcpy( p, &val, sizeof(val) ) ;
+  }
+
+  bool isBlank( char c ) {
+    return ' ' == c || '\t' == c ;
+  }
+
+  /* finds a header value in an encoded sip message, by full name or compact form */
+  bool findHeader( const string& msg, const char* name, char compact, string& value ) {
+    size_t nameLen = strlen( name ) ;
+    size_t pos = msg.find( "\r\n" ) ;
+    while( string::npos != pos ) {
+      size_t start = pos + 2 ;
+      if( start >= msg.length() || '\r' == msg[start] ) return false ;  // end of headers
+
+      size_t end = msg.find( "\r\n", start ) ;
+      if( string::npos == end ) end = msg.length() ;
+      const char* line = msg.data() + start ;
+      size_t lineLen = end - start ;
+
+      size_t i = 0 ;
+      if( lineLen > nameLen && 0 == strncasecmp( line, name, nameLen ) ) i = nameLen ;
+      else if( compact && lineLen > 1 && compact == tolower( line[0] ) ) i = 1 ;
+      if( i ) {
+        while( i < lineLen && isBlank( line[i] ) ) i++ ;
+        if( i < lineLen && ':' == line[i] ) {
+          i++ ;
+          while( i < lineLen && isBlank( line[i] ) ) i++ ;
+          size_t j = lineLen ;
+          while( j > i && isBlank( line[j-1] ) ) j-- ;
+          value.assign( line + i, j - i ) ;
+          return true ;
+        }
+      }
+      pos = end < msg.length() ? end : string::npos ;
+    }
+    return false ;
+  }
+}
+
+namespace drachtio {
+
+  HepExporter::HepExporter( const string& address, unsigned int port, uint32_t agentId, const string& sample ) :
+    m_address(address), m_port(port), m_agentId(agentId), m_sampleMode(sample_all), m_sampleN(1), m_sock(-1), m_captureSock(-1),
+    m_buffers(HEP_BATCH_SIZE * HEP_MAX_PACKET), m_control(HEP_BATCH_SIZE * CMSG_SPACE(sizeof(uint32_t))), 
+    m_recvMsgs(HEP_BATCH_SIZE), m_recvIovs(HEP_BATCH_SIZE), m_msgs(HEP_BATCH_SIZE), m_iovs(HEP_BATCH_SIZE), 
+    m_lastSweep(0), m_sendErrors(0), m_droppedReported(0), m_bStop(false) {
+
+    if( sample.empty() || 0 == sample.compare("all") ) {
+      m_sampleMode = sample_all ;
+    }
+    else if( 0 == sample.compare("invite") ) {
+      m_sampleMode = sample_invite_dialogs ;
+    }
+    else {
+      int n = ::atoi( sample.c_str() ) ;
+      if( n > 1 ) {
+        m_sampleMode = sample_one_in_n ;
+        m_sampleN = n ;
+      }
+      else if( n != 1 ) {
+        DR_LOG(log_error) << "HepExporter::HepExporter - invalid sampling '" << sample << 
+          "', must be 'all', 'invite' or a number N to capture 1 in N calls; capturing all messages" ;
+      }
+    }
+
+    // captures are relayed from the buffer they were received into; both sockets are connected or bound, so no addresses
+    memset( m_recvMsgs.data(), 0, m_recvMsgs.size() * sizeof(struct mmsghdr) ) ;
+    memset( m_msgs.data(), 0, m_msgs.size() * sizeof(struct mmsghdr) ) ;
+    for( unsigned int i = 0; i < HEP_BATCH_SIZE; i++ ) {
+      m_recvIovs[i].iov_base = m_buffers.data() + i * HEP_MAX_PACKET ;
+      m_recvIovs[i].iov_len = HEP_MAX_PACKET ;
+      m_recvMsgs[i].msg_hdr.msg_iov = &m_recvIovs[i] ;
+      m_recvMsgs[i].msg_hdr.msg_iovlen = 1 ;
+      m_msgs[i].msg_hdr.msg_iov = &m_iovs[i] ;
+      m_msgs[i].msg_hdr.msg_iovlen = 1 ;
+    }
+  }
+
+  HepExporter::~HepExporter() {
+    stop() ;
+  }
+
+  bool HepExporter::start(void) {
+    struct addrinfo hints, *res = NULL ;
+    memset( &hints, 0, sizeof(hints) ) ;
+    hints.ai_family = AF_UNSPEC ;
+    hints.ai_socktype = SOCK_DGRAM ;
+
+    int rc = getaddrinfo( m_address.c_str(), std::to_string(m_port).c_str(), &hints, &res ) ;
+    if( 0 != rc ) {
+      DR_LOG(log_error) << "HepExporter::start - unable to resolve " << m_address << ": " << gai_strerror(rc) ;
+      return false ;
+    }
+    for( struct addrinfo* ai = res; ai && -1 == m_sock; ai = ai->ai_next ) {
+      m_sock = socket( ai->ai_family, ai->ai_socktype, ai->ai_protocol ) ;
+      if( -1 == m_sock ) continue ;
+      if( 0 != connect( m_sock, ai->ai_addr, ai->ai_addrlen ) ) {
+        close( m_sock ) ;
+        m_sock = -1 ;
+      }
+    }
+    freeaddrinfo( res ) ;
+    if( -1 == m_sock ) {
+      DR_LOG(log_error) << "HepExporter::start - unable to open a socket to " << m_address << ":" << m_port << ": " << strerror(errno) ;
+      return false ;
+    }
+
+    // the loopback socket sofia captures to; SO_RXQ_OVFL has the kernel tell us how many captures it dropped
+    struct sockaddr_in local ;
+    socklen_t localLen = sizeof(local) ;
+    memset( &local, 0, sizeof(local) ) ;
+    local.sin_family = AF_INET ;
+    local.sin_addr.s_addr = htonl( INADDR_LOOPBACK ) ;
+    int rcvbuf = HEP_CAPTURE_RCVBUF, on = 1 ;
+    struct timeval timeout = { 0, HEP_RECV_TIMEOUT_MSECS * 1000 } ;
+    m_captureSock = socket( AF_INET, SOCK_DGRAM, 0 ) ;
+    if( -1 == m_captureSock || 
+      0 != bind( m_captureSock, (struct sockaddr *) &local, sizeof(local) ) ||
+      0 != getsockname( m_captureSock, (struct sockaddr *) &local, &localLen ) ) {
+      DR_LOG(log_error) << "HepExporter::start - unable to open a loopback socket for capture: " << strerror(errno) ;
+      stop() ;
+      return false ;
+    }
+    setsockopt( m_captureSock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf) ) ;
+    setsockopt( m_captureSock, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on) ) ;
+    setsockopt( m_captureSock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout) ) ;
+
+    m_captureString = "udp:127.0.0.1:" + std::to_string( ntohs( local.sin_port ) ) + ";hep=3;capture_id=" + std::to_string( m_agentId ) ;
+
+    DR_LOG(log_notice) << "HepExporter::start - relaying HEPv3 to " << m_address << ":" << m_port << " with agent id " << m_agentId <<
+      (sample_all == m_sampleMode ? ", all messages" : 
+        (sample_invite_dialogs == m_sampleMode ? ", INVITE dialogs only" : ", 1 in " + std::to_string(m_sampleN) + " calls")) ;
+
+    std::thread t(&HepExporter::threadFunc, this) ;
+    m_thread.swap( t ) ;
+    return true ;
+  }
+
+  void HepExporter::stop(void) {
+    m_bStop = true ;
+    if( m_thread.joinable() ) m_thread.join() ;
+    if( -1 != m_sock ) {
+      close( m_sock ) ;
+      m_sock = -1 ;
+    }
+    if( -1 != m_captureSock ) {
+      close( m_captureSock ) ;
+      m_captureSock = -1 ;
+    }
+  }
+
+  void HepExporter::threadFunc(void) {
+    string callId, cseq ;
+    const size_t controlLen = CMSG_SPACE(sizeof(uint32_t)) ;
+    while( !m_bStop ) {
+      for( unsigned int i = 0; i < HEP_BATCH_SIZE; i++ ) {
+        m_recvMsgs[i].msg_hdr.msg_control = m_control.data() + i * controlLen ;
+        m_recvMsgs[i].msg_hdr.msg_controllen = controlLen ;
+      }
+
+      // wait (up to the receive timeout) for the first capture, then take whatever else is already queued
+      int received = recvmmsg( m_captureSock, m_recvMsgs.data(), HEP_BATCH_SIZE, MSG_WAITFORONE, NULL ) ;
+      if( received <= 0 ) continue ;
+
+      unsigned int count = 0, sampledOut = 0, notRelayed = 0 ;
+      uint32_t dropped = m_droppedReported ;
+      for( int i = 0; i < received; i++ ) {
+        struct msghdr& hdr = m_recvMsgs[i].msg_hdr ;
+        for( struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg) ) {
+          if( SOL_SOCKET == cmsg->cmsg_level && SO_RXQ_OVFL == cmsg->cmsg_type ) memcpy( &dropped, CMSG_DATA(cmsg), sizeof(dropped) ) ;
+        }
+
+        uint8_t* pkt = (uint8_t *) m_recvIovs[i].iov_base ;
+        size_t len = relay( pkt, m_recvMsgs[i].msg_len, callId, cseq ) ;
+        if( 0 == len ) {
+          notRelayed++ ;
+          continue ;
+        }
+        size_t sp = cseq.find_last_of( ' ' ) ;
+        if( !sampled( callId, string::npos == sp ? cseq : cseq.substr( sp + 1 ), time(NULL) ) ) {
+          sampledOut++ ;
+          continue ;
+        }
+        m_iovs[count].iov_base = pkt ;
+        m_iovs[count++].iov_len = len ;
+      }
+
+      if( count ) flush( count ) ;
+      if( sampledOut ) STATS_COUNTER_INCREMENT_BY(STATS_COUNTER_HEP_PACKETS, (double) sampledOut, {{"result", "sampled_out"}})
+      if( notRelayed ) STATS_COUNTER_INCREMENT_BY(STATS_COUNTER_HEP_PACKETS, (double) notRelayed, {{"result", "invalid"}})
+      reportDropped( dropped ) ;
+    }
+  }
+
+  /* 
+    checks a capture from sofia and pulls the Call-ID and CSeq out of its payload; adds the Call-ID as the
+    correlation id if sofia did not.  Returns the length of the packet to send, or 0 if it is not a HEPv3 packet
+  */
+  size_t HepExporter::relay( uint8_t* pkt, size_t len, string& callId, string& cseq ) {
+    callId.clear() ;
+    cseq.clear() ;
+    if( len < 6 || 0 != memcmp( pkt, "HEP3", 4 ) || get16( pkt + 4 ) != len ) return 0 ;
+
+    bool hasCorrelationId = false ;
+    const uint8_t* payload = NULL ;
+    size_t payloadLen = 0 ;
+    for( size_t pos = 6; pos < len; ) {
+      if( pos + 6 > len ) return 0 ;
+      uint16_t type = get16( pkt + pos + 2 ) ;
+      uint16_t chunkLen = get16( pkt + pos + 4 ) ;
+      if( chunkLen < 6 || pos + chunkLen > len ) return 0 ;
+      if( 0 == get16( pkt + pos ) ) {
+        if( HEP_CHUNK_PAYLOAD == type ) {
+          payload = pkt + pos + 6 ;
+          payloadLen = chunkLen - 6 ;
+        }
+        else if( HEP_CHUNK_CORRELATION_ID == type ) hasCorrelationId = true ;
+      }
+      pos += chunkLen ;
+    }
+    if( !payload ) return len ;
+
+    // only the headers are searched, so a body with NULs in it is fine
+    m_payload.assign( (const char *) payload, payloadLen ) ;
+    findHeader( m_payload, "call-id", 'i', callId ) ;
+    findHeader( m_payload, "cseq", 0, cseq ) ;
+
+    size_t total = len + 6 + callId.length() ;
+    if( !hasCorrelationId && !callId.empty() && total <= HEP_MAX_PACKET ) {
+      put16( pkt + len, 0 ) ;
+      put16( pkt + len + 2, HEP_CHUNK_CORRELATION_ID ) ;
+      put16( pkt + len + 4, (uint16_t) (6 + callId.length()) ) ;
+      memcpy( pkt + len + 6, callId.data(), callId.length() ) ;
+      put16( pkt + 4, (uint16_t) total ) ;
+      return total ;
+    }
+    return len ;
+  }
+
+  bool HepExporter::sampled( const string& callId, const string& cseqMethod, time_t now ) {
+    switch( m_sampleMode ) {
+      case sample_one_in_n:
+        return callId.empty() || 0 == std::hash<string>()( callId ) % m_sampleN ;
+
+      case sample_invite_dialogs:
+      {
+        if( now - m_lastSweep >= HEP_SWEEP_INTERVAL_SECS ) {
+          for( auto it = m_mapInviteCalls.begin(); it != m_mapInviteCalls.end(); ) {
+            if( now - it->second > HEP_INVITE_CALL_IDLE_SECS ) it = m_mapInviteCalls.erase( it ) ;
+            else ++it ;
+          }
+          m_lastSweep = now ;
+        }
+        if( callId.empty() ) return false ;
+        if( 0 == cseqMethod.compare("INVITE") ) {
+          m_mapInviteCalls[callId] = now ;
+          return true ;
+        }
+        auto it = m_mapInviteCalls.find( callId ) ;
+        if( m_mapInviteCalls.end() == it ) return false ;
+        it->second = now ;
+        return true ;
+      }
+
+      default:
+        return true ;
+    }
+  }
+
+  void HepExporter::flush( unsigned int count ) {
+    unsigned int sent = 0 ;
+    while( sent < count ) {
+      int rv = sendmmsg( m_sock, &m_msgs[sent], count - sent, 0 ) ;
+      if( rv < 0 ) {
+        if( EINTR == errno ) continue ;
+        if( 0 == m_sendErrors++ % 1000 ) {
+          DR_LOG(log_error) << "HepExporter::flush - error sending to " << m_address << ":" << m_port << ": " << strerror(errno) ;
+        }
+        STATS_COUNTER_INCREMENT_BY(STATS_COUNTER_HEP_PACKETS, (double) (count - sent), {{"result", "send_error"}})
+        break ;
+      }
+      sent += rv ;
+    }
+    if( sent ) STATS_COUNTER_INCREMENT_BY(STATS_COUNTER_HEP_PACKETS, (double) sent, {{"result", "sent"}})
+  }
+
+  /* dropped is the kernel's running count of captures it had no room for in the loopback socket's buffer */
+  void HepExporter::reportDropped( uint32_t dropped ) {
+    if( dropped == m_droppedReported ) return ;
+
+    if( 0 == m_droppedReported ) {
+      DR_LOG(log_error) << "HepExporter::reportDropped - capture socket buffer is full, dropping messages" ;
+    }
+    STATS_COUNTER_INCREMENT_BY(STATS_COUNTER_HEP_PACKETS, (double) (uint32_t) (dropped - m_droppedReported), {{"result", "queue_full"}})
+    m_droppedReported = dropped ;
+  }
+}
@@ -0,0 +1,103 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __HEP_EXPORTER_HPP__
+#define __HEP_EXPORTER_HPP__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <ctime>
+#include <cstdint>
+
+using std::string ;
+
+namespace drachtio {
+
+  /**
+   * Relays the HEPv3 capture of each sip message we send or receive to a Homer/sipcapture server.
+   * 
+   * Sofia still encodes the capture from the message buffer, so the payload is exactly what went over 
+   * the wire, but it sends it to a socket on the loopback interface that we own instead of to Homer.  That
+   * socket's receive buffer is the queue: a send to it never blocks the sofia thread, and if it is full the
+   * kernel drops the packet.  A dedicated thread reads the captures in batches, applies sampling, adds the
+   * Call-ID as the correlation id and sends whatever it has to Homer with a single sendmmsg.
+   */
+  class HepExporter {
+  public:
+    enum SampleMode_t {
+      sample_all,                 // every message
+      sample_invite_dialogs,      // only messages belonging to a call that was set up with an INVITE
+      sample_one_in_n             // every message of one in N calls, chosen by Call-ID
+    } ;
+
+    HepExporter( const HepExporter& ) = delete;
+
+    HepExporter( const string& address, unsigned int port, uint32_t agentId, const string& sample ) ;
+    ~HepExporter() ;
+
+    bool start(void) ;
+    void stop(void) ;
+
+    /* the TPTAG_CAPT value that points sofia's capture at our loopback socket; valid once started */
+    const string& getCaptureString(void) const { return m_captureString; }
+
+  private:
+    void threadFunc(void) ;
+    bool sampled( const string& callId, const string& cseqMethod, time_t now ) ;
+    size_t relay( uint8_t* pkt, size_t len, string& callId, string& cseq ) ;
+    void flush( unsigned int count ) ;
+    void reportDropped( uint32_t dropped ) ;
+
+    string m_address ;
+    unsigned int m_port ;
+    uint32_t m_agentId ;
+    SampleMode_t m_sampleMode ;
+    unsigned int m_sampleN ;
+    int m_sock ;                      // connected to Homer
+    int m_captureSock ;               // bound to the loopback interface, sofia sends here
+    string m_captureString ;
+
+    // only accessed on the capture thread
+    std::vector<uint8_t> m_buffers ;
+    std::vector<uint8_t> m_control ;
+    std::vector<struct mmsghdr> m_recvMsgs ;
+    std::vector<struct iovec> m_recvIovs ;
+    std::vector<struct mmsghdr> m_msgs ;
+    std::vector<struct iovec> m_iovs ;
+    string m_payload ;
+    std::unordered_map<string, time_t> m_mapInviteCalls ;
+    time_t m_lastSweep ;
+    uint64_t m_sendErrors ;
+    uint32_t m_droppedReported ;
+
+    std::thread m_thread ;
+    std::atomic<bool> m_bStop ;
+  } ;
+}
+
+#endif
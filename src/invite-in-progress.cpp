@@ -4,6 +4,7 @@
 #define MAX_CANCEL_DURATION (32000)
 
 #include <mutex>
+#include <vector>
 namespace {
     void cancel_timer_handler( su_root_magic_t* magic, su_timer_t* timer, su_timer_arg_t* args) {
       std::weak_ptr<drachtio::IIP> *p = reinterpret_cast< std::weak_ptr<drachtio::IIP> *>( args ) ;
@@ -185,10 +186,15 @@ namespace drachtio {
     size_t count = IIP_Size(iips);
     DR_LOG(log_debug) << "IIP size:                                                        " << count;
     if (full && count) {
-      std::lock_guard<std::mutex> lock(iip_mutex) ;
-      auto &idx = iips.get<TimeTag>();
-      for (auto it = idx.begin(); it != idx.end(); ++it) {
-        std::shared_ptr<IIP> p = *it;
+
+      // take references under the lock, but do the (slow) logging after releasing it
+      std::vector< std::shared_ptr<IIP> > entries;
+      {
+        std::lock_guard<std::mutex> lock(iip_mutex) ;
+        auto &idx = iips.get<TimeTag>();
+        entries.assign(idx.begin(), idx.end());
+      }
+      for (const auto& p : entries) {
         DR_LOG(log_info) << *p;
       }
     }
@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <cstring>
+#include <cstdlib>
+
+#include <arpa/inet.h>
+
+#include "options-responder.hpp"
+
+namespace {
+  bool prefixMatches(const uint8_t* a, const uint8_t* b, unsigned int bits) {
+    unsigned int bytes = bits / 8;
+    if (bytes && 0 != memcmp(a, b, bytes)) return false;
+    unsigned int rem = bits % 8;
+    if (0 == rem) return true;
+    uint8_t mask = 0xff << (8 - rem);
+    return (a[bytes] & mask) == (b[bytes] & mask);
+  }
+}
+
+namespace drachtio {
+
+  OptionsResponder::OptionsResponder() : 
+    m_responseHeaders("Allow: INVITE, ACK, CANCEL, BYE, OPTIONS, INFO, UPDATE, PRACK, REFER, NOTIFY, SUBSCRIBE, MESSAGE\r\n"
+      "Accept: application/sdp") {
+  }
+
+  bool OptionsResponder::add(const std::string& name, const std::string& source, const std::string& userAgentPrefix, 
+    const std::string& requestUriUser) {
+    if (source.empty() && userAgentPrefix.empty() && requestUriUser.empty()) return false;
+
+    Rule_t rule;
+    rule.name = name;
+    rule.family = 0;
+    rule.prefixLen = 0;
+    memset(rule.network, 0, sizeof(rule.network));
+    rule.userAgentPrefix = userAgentPrefix;
+    rule.requestUriUser = requestUriUser;
+
+    if (!source.empty()) {
+      std::string network = source;
+      size_t pos = source.find('/');
+      if (std::string::npos != pos) network = source.substr(0, pos);
+
+      if (1 == inet_pton(AF_INET, network.c_str(), rule.network)) {
+        rule.family = AF_INET;
+        rule.prefixLen = 32;
+      }
+      else if (1 == inet_pton(AF_INET6, network.c_str(), rule.network)) {
+        rule.family = AF_INET6;
+        rule.prefixLen = 128;
+      }
+      else return false;
+
+      if (std::string::npos != pos) {
+        int bits = ::atoi(source.c_str() + pos + 1);
+        if (bits < 0 || bits > (int) rule.prefixLen) return false;
+        rule.prefixLen = bits;
+      }
+    }
+
+    m_rules.push_back(rule);
+    return true;
+  }
+
+  const OptionsResponder::Rule_t* OptionsResponder::match(const su_sockaddr_t* su, const sip_t* sip) const {
+    for (const auto& rule : m_rules) {
+      if (rule.family) {
+        if (!su || su->su_family != rule.family) continue;
+        const uint8_t* addr = AF_INET == rule.family ? 
+          reinterpret_cast<const uint8_t*>(&su->su_sin.sin_addr) : reinterpret_cast<const uint8_t*>(&su->su_sin6.sin6_addr);
+        if (!prefixMatches(addr, rule.network, rule.prefixLen)) continue;
+      }
+      if (!rule.userAgentPrefix.empty()) {
+        if (!sip->sip_user_agent || !sip->sip_user_agent->g_string || 
+          0 != strncmp(sip->sip_user_agent->g_string, rule.userAgentPrefix.c_str(), rule.userAgentPrefix.length())) continue;
+      }
+      if (!rule.requestUriUser.empty()) {
+        const char* user = sip->sip_request->rq_url->url_user;
+        if (!user || 0 != rule.requestUriUser.compare(user)) continue;
+      }
+      return &rule;
+    }
+    return NULL;
+  }
+}
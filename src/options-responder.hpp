@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __OPTIONS_RESPONDER_HPP__
+#define __OPTIONS_RESPONDER_HPP__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <sofia-sip/su.h>
+#include <sofia-sip/sip.h>
+
+namespace drachtio {
+
+  /**
+   * rules for answering OPTIONS pings ourselves, without involving an app; built once when 
+   * the config is loaded (or reloaded on SIGHUP)
+   */
+  class OptionsResponder {
+  public:
+    struct Rule_t {
+      std::string name;
+      int family;                   // AF_INET or AF_INET6 to match on source network, otherwise 0
+      uint8_t network[16];
+      unsigned int prefixLen;
+      std::string userAgentPrefix;
+      std::string requestUriUser;
+    };
+
+    OptionsResponder();
+
+    /* 
+      all of the criteria provided must match; returns false if none are provided (a rule would otherwise 
+      answer every OPTIONS), or if the source network is not in CIDR format 
+    */
+    bool add(const std::string& name, const std::string& source, const std::string& userAgentPrefix, 
+      const std::string& requestUriUser);
+
+    bool empty(void) const { return m_rules.empty(); }
+    size_t size(void) const { return m_rules.size(); }
+
+    /* returns the first rule matching an OPTIONS request received from the given address, or NULL */
+    const Rule_t* match(const su_sockaddr_t* su, const sip_t* sip) const;
+
+    /* headers added to every 200 OK we send */
+    const std::string& getResponseHeaders(void) const { return m_responseHeaders; }
+
+  private:
+    std::vector<Rule_t> m_rules;
+    std::string m_responseHeaders;
+  };
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <algorithm>
+
+#include "overload-controller.hpp"
+#include "controller.hpp"
+
+namespace {
+  const double MIN_ADMIT_RATIO = 0.05 ;
+  const double ADMIT_RATIO_DECREASE = 0.5 ;
+  const double ADMIT_RATIO_INCREASE = 0.1 ;
+}
+
+namespace drachtio {
+
+  OverloadController::OverloadController() : m_bEnabled(false), m_admitRatio(1.0), m_credit(0.0) {
+  }
+
+  void OverloadController::configure( const Thresholds_t& thresholds ) {
+    m_thresholds = thresholds ;
+    m_bEnabled = thresholds.maxPendingRequests || thresholds.maxLoopLagMsecs || 
+      thresholds.maxAppWriteBacklog || thresholds.maxAppTransactions ;
+    m_strRetryAfter = std::to_string( thresholds.retryAfter ) ;
+    m_admitRatio = 1.0 ;
+    m_credit = 0.0 ;
+  }
+
+  void OverloadController::update( unsigned int pendingRequests, double loopLagSecs, uint64_t appWriteBacklog, 
+    unsigned int maxAppTransactions ) {
+
+    if( !m_bEnabled ) return ;
+
+    unsigned int lagMsecs = loopLagSecs > 0 ? (unsigned int) (loopLagSecs * 1000) : 0 ;
+    bool pendingOver = m_thresholds.maxPendingRequests && pendingRequests > m_thresholds.maxPendingRequests ;
+    bool lagOver = m_thresholds.maxLoopLagMsecs && lagMsecs > m_thresholds.maxLoopLagMsecs ;
+    bool backlogOver = m_thresholds.maxAppWriteBacklog && appWriteBacklog > m_thresholds.maxAppWriteBacklog ;
+    bool transactionsOver = m_thresholds.maxAppTransactions && maxAppTransactions > m_thresholds.maxAppTransactions ;
+
+    double previous = m_admitRatio ;
+    if( pendingOver || lagOver || backlogOver || transactionsOver ) {
+      m_admitRatio = std::max( MIN_ADMIT_RATIO, m_admitRatio * ADMIT_RATIO_DECREASE ) ;
+    }
+    else {
+      m_admitRatio = std::min( 1.0, m_admitRatio + ADMIT_RATIO_INCREASE ) ;
+    }
+
+    if( m_admitRatio < previous ) {
+      DR_LOG(log_warning) << "OverloadController::update - overloaded, admitting " << (int) (m_admitRatio * 100) << "% of new requests; " <<
+        "pending requests: " << pendingRequests << ", loop lag: " << lagMsecs << "ms, app write backlog: " << appWriteBacklog << 
+        " bytes, max app transactions: " << maxAppTransactions ;
+    }
+    else if( m_admitRatio >= 1.0 && previous < 1.0 ) {
+      DR_LOG(log_notice) << "OverloadController::update - no longer overloaded, admitting all new requests" ;
+    }
+
+    STATS_GAUGE_SET(STATS_GAUGE_OVERLOAD_ADMIT_RATIO, m_admitRatio)
+    STATS_GAUGE_SET(STATS_GAUGE_OVERLOAD_SIGNAL, pendingRequests, {{"signal", "pending_requests"}})
+    STATS_GAUGE_SET(STATS_GAUGE_OVERLOAD_SIGNAL, lagMsecs, {{"signal", "loop_lag_msecs"}})
+    STATS_GAUGE_SET(STATS_GAUGE_OVERLOAD_SIGNAL, appWriteBacklog, {{"signal", "app_write_backlog_bytes"}})
+    STATS_GAUGE_SET(STATS_GAUGE_OVERLOAD_SIGNAL, maxAppTransactions, {{"signal", "max_app_transactions"}})
+  }
+
+  bool OverloadController::admit(void) {
+    if( m_admitRatio >= 1.0 ) return true ;
+
+    // spread the requests we accept evenly, rather than in bursts
+    m_credit += m_admitRatio ;
+    if( m_credit >= 1.0 ) {
+      m_credit -= 1.0 ;
+      return true ;
+    }
+    return false ;
+  }
+}
@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __OVERLOAD_CONTROLLER_HPP__
+#define __OVERLOAD_CONTROLLER_HPP__
+
+#include <string>
+#include <cstdint>
+
+using std::string ;
+
+namespace drachtio {
+
+  /**
+   * Decides whether to accept new requests arriving outside of a dialog.  The readings are sampled once 
+   * a second; while any of them is over its threshold the share of new requests admitted is cut in half 
+   * each second, and once they are all back under it recovers a tenth at a time.  Requests that are not 
+   * admitted are rejected with 503 and a Retry-After.  Requests within a dialog are never affected.
+   *
+   * Only accessed on the sofia thread.
+   */
+  class OverloadController {
+  public:
+    // a zero threshold means the reading is not checked
+    struct Thresholds_t {
+      Thresholds_t() : maxPendingRequests(0), maxLoopLagMsecs(0), maxAppWriteBacklog(0), maxAppTransactions(0), retryAfter(5) {}
+
+      unsigned int maxPendingRequests ;     // requests waiting on an app or http route decision
+      unsigned int maxLoopLagMsecs ;        // delay of the sofia event loop timer
+      uint64_t maxAppWriteBacklog ;         // bytes queued for writing to all apps
+      unsigned int maxAppTransactions ;     // outstanding incoming transactions held by any one app
+      unsigned int retryAfter ;             // seconds
+    } ;
+
+    OverloadController( const OverloadController& ) = delete;
+
+    OverloadController() ;
+    ~OverloadController() {}
+
+    void configure( const Thresholds_t& thresholds ) ;
+    bool enabled(void) const { return m_bEnabled; }
+
+    void update( unsigned int pendingRequests, double loopLagSecs, uint64_t appWriteBacklog, unsigned int maxAppTransactions ) ;
+
+    /* whether to accept a new request outside of a dialog */
+    bool admit(void) ;
+
+    const char* getRetryAfter(void) const { return m_strRetryAfter.c_str(); }
+    double getAdmitRatio(void) const { return m_admitRatio; }
+
+  private:
+    Thresholds_t m_thresholds ;
+    bool m_bEnabled ;
+    string m_strRetryAfter ;
+
+    double m_admitRatio ;
+    double m_credit ;
+  } ;
+}
+
+#endif
@@ -92,9 +92,7 @@ namespace drachtio {
       client = m_pClientController->selectClientForRequestOutsideDialog( sip->sip_request->rq_method_name ) ;
       if( !client ) {
         DR_LOG(log_error) << "processNewRequest - No providers available for " << sip->sip_request->rq_method_name  ;
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {
-          {"method", sip->sip_request->rq_method_name},
-          {"code", "503"}})
+        STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name, 503)
         generateUuid( transactionId ) ;
         return 503 ;
       }
@@ -102,6 +100,7 @@ namespace drachtio {
 
     std::shared_ptr<PendingRequest_t> p = add( msg, sip ) ;
     transactionId = p->getTransactionId() ;      
+    m_pController->getRequestTracer().begin( transactionId ) ;
 
     msg_destroy( msg ) ;  //our PendingRequest_t is now the holder of the message
 
@@ -121,7 +120,7 @@ namespace drachtio {
       m_pClientController->addNetTransaction( client, p->getTransactionId() ) ;
 
       void (BaseClient::*fn)(const string&, const string&, const SipMsgData_t&) = &BaseClient::sendSipMessageToClient;
-      m_pClientController->getIOService().post( std::bind(fn, client, p->getTransactionId(), encodedMessage, meta ) ) ;
+      m_pClientController->post( std::bind(fn, client, p->getTransactionId(), encodedMessage, meta ) ) ;
     }
     else {
       // using outbound connection for this call
@@ -178,8 +177,22 @@ namespace drachtio {
         }
       }
       
+      // routing decisions may be cached by method, request uri and source address
+      string cacheKey ;
+      if (m_pController->getHttpRouteCacheTtl() > 0) {
+        cacheKey = sip->sip_request->rq_method_name ;
+        cacheKey.append(" ") ;
+        if (sip->sip_request->rq_url->url_user) {
+          cacheKey.append(sip->sip_request->rq_url->url_user) ;
+          cacheKey.append("@") ;
+        }
+        if (sip->sip_request->rq_url->url_host) cacheKey.append(sip->sip_request->rq_url->url_host) ;
+        cacheKey.append(" ") ;
+        cacheKey.append(meta.getAddress()) ;
+      }
+
       std::shared_ptr<RequestHandler> pHandler = RequestHandler::getInstance();
-      pHandler->makeRequestForRoute(transactionId, httpMethod, httpUrl, encodedMessage) ;
+      pHandler->makeRequestForRoute(transactionId, httpMethod, httpUrl, encodedMessage, cacheKey) ;
     }
     return 0 ;
   }
@@ -193,7 +206,7 @@ namespace drachtio {
     m_pClientController->addNetTransaction( client, p->getTransactionId() ) ;
 
     void (BaseClient::*fn)(const string&, const string&, const SipMsgData_t&) = &BaseClient::sendSipMessageToClient;
-    m_pClientController->getIOService().post( std::bind(fn, client, p->getTransactionId(), 
+    m_pClientController->post( std::bind(fn, client, p->getTransactionId(), 
         p->getEncodedMsg(), p->getMeta() ) ) ;
     return 0 ;
   }
@@ -124,6 +124,11 @@ namespace drachtio {
       return p ;
    }
 
+  size_t getCountOfPendingRequests(void) {
+    std::lock_guard<std::mutex> lock(m_mutex) ;
+    return m_mapTxnId2Invite.size() ;
+  }
+
   bool getMethodForRequest(const string& transactionId, string& method);
   void timeout(const string& transactionId) ;
 
@@ -21,6 +21,7 @@ THE SOFTWARE.
 */
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
 #include <boost/bind/bind.hpp>
 #include <boost/tokenizer.hpp>
@@ -48,10 +49,9 @@ namespace {
 namespace drachtio {
 
   unsigned int RequestHandler::easyHandleCacheSize = 4 ;
+  unsigned int RequestHandler::routeCacheMaxSize = 10000 ;
   bool RequestHandler::instanceFlag = false;
   std::shared_ptr<RequestHandler> RequestHandler::single ;
-  std::deque<CURL*> RequestHandler::m_cacheEasyHandles ;
-  boost::object_pool<RequestHandler::ConnInfo> RequestHandler::m_pool(16, 256) ;
 
   static int multi_timer_cb(CURLM *multi, long timeout_ms, drachtio::RequestHandler::GlobalInfo *g);
   static int sock_cb(CURL *e, curl_socket_t s, int what, void *cbp, void *sockp);
@@ -76,8 +76,7 @@ namespace drachtio {
     RequestHandler::ConnInfo *conn);
 
   int sock_cb(CURL *e, curl_socket_t s, int what, void *cbp, void *sockp) {
-    std::shared_ptr<RequestHandler> p = RequestHandler::getInstance() ;
-    RequestHandler::GlobalInfo *g = &(p->getGlobal()) ;
+    RequestHandler::GlobalInfo *g = (RequestHandler::GlobalInfo *) cbp ;
 
     int *actionp = (int *) sockp;
     static const char *whatstr[] = { "none", "IN", "OUT", "INOUT", "REMOVE"};
@@ -110,8 +109,7 @@ namespace drachtio {
   }
 
   void setsock(int *fdp, curl_socket_t s, CURL *e, int act, int oldact, drachtio::RequestHandler::GlobalInfo *g) {
-    std::shared_ptr<RequestHandler> p = RequestHandler::getInstance() ;
-    std::map<curl_socket_t, boost::asio::ip::tcp::socket *>& socket_map = p->getSocketMap() ;
+    std::map<curl_socket_t, boost::asio::ip::tcp::socket *>& socket_map = g->worker->getSocketMap() ;
 
     std::map<curl_socket_t, boost::asio::ip::tcp::socket *>::iterator it =
       socket_map.find(s);
@@ -153,8 +151,7 @@ namespace drachtio {
   }
 
   int multi_timer_cb(CURLM *multi, long timeout_ms, drachtio::RequestHandler::GlobalInfo *g) {
-    std::shared_ptr<RequestHandler> p = RequestHandler::getInstance() ;
-    boost::asio::deadline_timer& timer = p->getTimer() ;
+    boost::asio::deadline_timer& timer = g->worker->getTimer() ;
 
     /* cancel running timer */
     timer.cancel();
@@ -238,23 +235,29 @@ namespace drachtio {
         //notify controller
         theOneAndOnlyController->httpCallRoutingComplete(conn->transactionId, response_code, conn->response) ;
 
+        if( !conn->cacheKey.empty() && CURLE_OK == res && 200 == response_code ) {
+          g->worker->getHandler().cacheRoute(conn->cacheKey, response_code, conn->response) ;
+        }
+
         // return easy handle to cache
         {
           //alloc and free happen in the same thread
-          //std::lock_guard<std::mutex> l( m_lock ) ;
-          RequestHandler::m_cacheEasyHandles.push_back(easy) ;
+          std::deque<CURL*>& cache = g->worker->getEasyHandleCache() ;
+          cache.push_back(easy) ;
           DR_LOG(log_debug) << "RequestHandler::makeRequestForRoute - after returning handle  in thread" << 
             std::this_thread::get_id() << " " << dec <<
-            RequestHandler::m_cacheEasyHandles.size() << " handles are available in cache";
+            cache.size() << " handles are available in cache";
         }
 
         curl_multi_remove_handle(g->multi, easy);
         
         if( conn->hdr_list ) curl_slist_free_all(conn->hdr_list);
 
-        memset(conn, 0, sizeof(RequestHandler::ConnInfo));
-        RequestHandler::m_pool.destroy(conn) ;
+        g->worker->getPool().destroy(conn) ;
         //free(conn);
+
+        g->in_flight-- ;
+        g->worker->finishRequest() ;
       }
     }
   }
@@ -270,9 +273,8 @@ namespace drachtio {
       remsock(fdp, g);
       return;
     }
-    std::shared_ptr<RequestHandler> p = RequestHandler::getInstance() ;
-    std::map<curl_socket_t, boost::asio::ip::tcp::socket *>& socket_map = p->getSocketMap() ;
-    boost::asio::deadline_timer& timer = p->getTimer() ;
+    std::map<curl_socket_t, boost::asio::ip::tcp::socket *>& socket_map = g->worker->getSocketMap() ;
+    boost::asio::deadline_timer& timer = g->worker->getTimer() ;
 
     if(socket_map.find(s) == socket_map.end()) {
       DR_LOG(log_error) << "event_cb: socket already closed";
@@ -344,15 +346,19 @@ namespace drachtio {
   /* CURLOPT_WRITEFUNCTION */
   size_t write_cb(void *ptr, size_t size, size_t nmemb, RequestHandler::ConnInfo *conn) {
     size_t written = size * nmemb;
-    size_t needed = strlen(conn->response) + written ;
-    if( needed > HTTP_BODY_LEN ) {
+    size_t needed = conn->response.size() + written ;
+    if( needed > HTTP_RESPONSE_MAX_LEN ) {
       DR_LOG(log_error) << "RequestHandler::write_cb total length of response " << needed << 
-        " exceeds buffer size";
+        " exceeds max allowed size";
       return 0 ;
     }
-    else {
-      strncat( conn->response, (const char *) ptr, written) ;
+    if( conn->response.empty() ) {
+      // size the buffer once from the Content-Length, if the server sent one
+      curl_off_t contentLength = -1 ;
+      curl_easy_getinfo(conn->easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength);
+      if( contentLength > 0 && contentLength <= HTTP_RESPONSE_MAX_LEN ) conn->response.reserve( (size_t) contentLength ) ;
     }
+    conn->response.append( (const char *) ptr, written ) ;
     return written;
   }
 
@@ -366,9 +372,9 @@ namespace drachtio {
   /* CURLOPT_OPENSOCKETFUNCTION */
   curl_socket_t opensocket(void *clientp, curlsocktype purpose,
                                   struct curl_sockaddr *address) {
-    std::shared_ptr<RequestHandler> p = drachtio::RequestHandler::getInstance() ;
-    std::map<curl_socket_t, boost::asio::ip::tcp::socket *>& socket_map = p->getSocketMap() ;
-    boost::asio::io_service& io_service = p->getIOService() ;
+    RequestHandler::Worker* worker = (RequestHandler::Worker *) clientp ;
+    std::map<curl_socket_t, boost::asio::ip::tcp::socket *>& socket_map = worker->getSocketMap() ;
+    boost::asio::io_service& io_service = worker->getIOService() ;
 
     curl_socket_t sockfd = CURL_SOCKET_BAD;
 
@@ -402,8 +408,8 @@ namespace drachtio {
   int close_socket(void *clientp, curl_socket_t item) {
     //DR_LOG(log_debug) <<"close_socket : " << hex << item;
 
-    std::shared_ptr<RequestHandler> p = drachtio::RequestHandler::getInstance() ;
-    std::map<curl_socket_t, boost::asio::ip::tcp::socket *>& socket_map = p->getSocketMap() ;
+    RequestHandler::Worker* worker = (RequestHandler::Worker *) clientp ;
+    std::map<curl_socket_t, boost::asio::ip::tcp::socket *>& socket_map = worker->getSocketMap() ;
 
     std::map<curl_socket_t, boost::asio::ip::tcp::socket *>::iterator it =
       socket_map.find(item);
@@ -421,10 +427,12 @@ namespace drachtio {
     return 0 ;
   }
 
-  RequestHandler::RequestHandler( DrachtioController* pController ) :
-      m_pController( pController ), m_timer(m_ioservice) {
+  RequestHandler::Worker::Worker( RequestHandler& handler, unsigned int index, unsigned int maxConnectionsPerHost ) :
+      m_handler( handler ), m_index( std::to_string(index) ), m_outstanding(0),
+      m_timer(m_ioservice), m_pool(16, 256) {
           
       memset(&m_g, 0, sizeof(GlobalInfo));
+      m_g.worker = this ;
       m_g.multi = curl_multi_init();
 
       assert(m_g.multi);
@@ -434,19 +442,32 @@ namespace drachtio {
       curl_multi_setopt(m_g.multi, CURLMOPT_TIMERFUNCTION, multi_timer_cb);
       curl_multi_setopt(m_g.multi, CURLMOPT_TIMERDATA, &m_g);
 
-      std::thread t(&RequestHandler::threadFunc, this) ;
+      // multiplex concurrent requests over a single HTTP/2 connection per host where the server supports it
+      curl_multi_setopt(m_g.multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+      if( maxConnectionsPerHost > 0 ) {
+        curl_multi_setopt(m_g.multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) maxConnectionsPerHost);
+      }
+
+      for( unsigned int i = 0; i < easyHandleCacheSize; i++ ) {
+        m_cacheEasyHandles.push_back( createEasyHandle() ) ;
+      }
+
+      std::thread t(&RequestHandler::Worker::threadFunc, this) ;
       m_thread.swap( t ) ;
   }
-  RequestHandler::~RequestHandler() {
+  RequestHandler::Worker::~Worker() {
+    m_ioservice.stop() ;
+    if( m_thread.joinable() ) m_thread.join() ;
+
     if (nullptr == m_g.multi) {
-      DR_LOG(log_error) << "RequestHandler::~RequestHandler - multi handle is null; this should only happen during shutdown";
+      DR_LOG(log_error) << "RequestHandler::Worker::~Worker - multi handle is null; this should only happen during shutdown";
     }
     else {
       curl_multi_cleanup(m_g.multi);
       m_g.multi = nullptr;
     }
   }
-  void RequestHandler::threadFunc() {
+  void RequestHandler::Worker::threadFunc() {
                
     /* to make sure the event loop doesn't terminate when there is no work to do */
     boost::asio::io_service::work work(m_ioservice);
@@ -463,12 +484,25 @@ namespace drachtio {
     }
   }
 
-  /* Create a new easy handle, and add it to the global curl_multi */
-  void RequestHandler::startRequest(const string& transactionId, 
-    const string& httpMethod, const string& url, const string& body, bool verifyPeer) {
+  void RequestHandler::Worker::finishRequest() {
+    m_outstanding-- ;
+    reportQueueStats() ;
+  }
+
+  /* always called from the worker thread, which owns the easy handle cache */
+  void RequestHandler::Worker::reportQueueStats() {
+    STATS_GAUGE_SET(STATS_GAUGE_HTTP_REQUESTS_IN_FLIGHT, m_g.in_flight, {{"worker", m_index}})
+    STATS_GAUGE_SET(STATS_GAUGE_HTTP_EASY_HANDLE_CACHE, m_cacheEasyHandles.size(), {{"worker", m_index}})
+    STATS_GAUGE_SET(STATS_GAUGE_HTTP_WORKER_QUEUE_DEPTH, m_outstanding.load(), {{"worker", m_index}})
+  }
+
+  /* Create a new easy handle, and add it to the worker's curl_multi */
+  void RequestHandler::Worker::startRequest(const string& transactionId, 
+    const string& httpMethod, const string& url, const string& body, const string& cacheKey, bool verifyPeer) {
 
     RequestHandler::ConnInfo *conn;
     CURLMcode rc;
+    DrachtioController* pController = m_handler.getController() ;
 
     if (0 == url.find("tcp://") || 0 == url.find("tls://")) {
       string json = "{\"action\": \"route\", \"data\": {\"uri\": \"";
@@ -477,18 +511,30 @@ namespace drachtio {
       else json.append(";transport=tls");
       json.append("\"}}");
       DR_LOG(log_info) << "RequestHandler::startRequest: no web callback required, sending directly to " << url << ":" << json.c_str() ;
-      m_pController->httpCallRoutingComplete(transactionId, 200, json);
+      pController->httpCallRoutingComplete(transactionId, 200, json);
+      finishRequest() ;
       return;
     }
 
+    if( m_handler.routeCacheEnabled() && !cacheKey.empty() ) {
+      long responseCode ;
+      string response ;
+      if( m_handler.findCachedRoute( cacheKey, responseCode, response ) ) {
+        DR_LOG(log_info) << "RequestHandler::startRequest: using cached routing decision for " << cacheKey << ": " << response ;
+        STATS_COUNTER_INCREMENT(STATS_COUNTER_HTTP_ROUTE_CACHE, {{"result", "hit"}})
+        pController->httpCallRoutingComplete(transactionId, responseCode, response);
+        finishRequest() ;
+        return;
+      }
+      STATS_COUNTER_INCREMENT(STATS_COUNTER_HTTP_ROUTE_CACHE, {{"result", "miss"}})
+    }
 
-    DR_LOG(log_info) << "RequestHandler::startRequest: sending http " << httpMethod << ": " << url ;
+    DR_LOG(log_info) << "RequestHandler::startRequest: worker " << m_index << " sending http " << httpMethod << ": " << url ;
 
-    conn = m_pool.malloc() ;
+    conn = m_pool.construct() ;
     CURL* easy = NULL ;
     {
       //alloc and free happen in the same thread
-      //std::lock_guard<std::mutex> l( m_lock ) ;
       if( m_cacheEasyHandles.empty() ) {
         m_cacheEasyHandles.push_back(createEasyHandle()) ;
       }
@@ -502,13 +548,13 @@ namespace drachtio {
     conn->easy = easy;
 
     conn->global = &m_g;
-    strncpy(conn->url, url.c_str(), URL_LEN) ;
-    strncpy(conn->body, body.c_str(), HTTP_BODY_LEN);
-    strncpy(conn->transactionId, transactionId.c_str(), TXNID_LEN);
-    conn->hdr_list = NULL ;
-    *conn->response = '\0' ;
+    conn->url = url ;
+    conn->body = body ;
+    conn->transactionId = transactionId ;
+    if( m_handler.routeCacheEnabled() ) conn->cacheKey = cacheKey ;
+    conn->response.reserve( HTTP_RESPONSE_RESERVE ) ;
 
-    curl_easy_setopt(easy, CURLOPT_URL, conn->url);
+    curl_easy_setopt(easy, CURLOPT_URL, conn->url.c_str());
     curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, write_cb);
     curl_easy_setopt(easy, CURLOPT_WRITEDATA, conn);
     curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, conn->error);
@@ -527,9 +573,11 @@ namespace drachtio {
     
     /* call this function to get a socket */
     curl_easy_setopt(easy, CURLOPT_OPENSOCKETFUNCTION, opensocket);
+    curl_easy_setopt(easy, CURLOPT_OPENSOCKETDATA, this);
 
     /* call this function to close a socket */
     curl_easy_setopt(easy, CURLOPT_CLOSESOCKETFUNCTION, close_socket);
+    curl_easy_setopt(easy, CURLOPT_CLOSESOCKETDATA, this);
 
     if( 0 == url.find("https:") ) {
       curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, verifyPeer);
@@ -538,19 +586,51 @@ namespace drachtio {
     conn->hdr_list = curl_slist_append(conn->hdr_list, "Accept: application/json");
     
     if( 0 == httpMethod.compare("POST") ) {
-      curl_easy_setopt(easy, CURLOPT_POSTFIELDS, conn->body);
-      curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, strlen(conn->body));
+      curl_easy_setopt(easy, CURLOPT_POSTFIELDS, conn->body.c_str());
+      curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, (long) conn->body.size());
       conn->hdr_list = curl_slist_append(conn->hdr_list, "Content-Type: text/plain; charset=UTF-8");
     }
     curl_easy_setopt(easy, CURLOPT_HTTPHEADER, conn->hdr_list);
 
     rc = curl_multi_add_handle(m_g.multi, conn->easy);
     mcode_test("new_conn: curl_multi_add_handle", rc);
+    if (CURLM_OK == rc) {
+      m_g.in_flight++ ;
+      reportQueueStats() ;
+    }
+    else {
+      DR_LOG(log_error) << "RequestHandler::startRequest: unable to start http request for transaction " << transactionId ;
+      if( conn->hdr_list ) curl_slist_free_all(conn->hdr_list);
+      m_cacheEasyHandles.push_back(easy) ;
+      m_pool.destroy(conn) ;
+      finishRequest() ;
+    }
 
     /* note that the add_handle() will set a time-out to trigger very soon so
        that the necessary socket_action() call will be called by this app */
   }
 
+  RequestHandler::RequestHandler( DrachtioController* pController ) :
+      m_pController( pController ), m_routeCacheTtl(pController->getHttpRouteCacheTtl()) {
+
+      unsigned int nWorkers = std::max(1U, pController->getHttpHandlerThreads()) ;
+      unsigned int maxConnections = pController->getHttpMaxConnectionsPerHost() ;
+      for( unsigned int i = 0; i < nWorkers; i++ ) {
+        m_workers.push_back( std::unique_ptr<Worker>( new Worker( *this, i, maxConnections ) ) ) ;
+      }
+      DR_LOG(log_notice) << "RequestHandler::RequestHandler - started " << nWorkers << " http worker thread(s)";
+
+      if( maxConnections > 0 ) {
+        DR_LOG(log_notice) << "RequestHandler::RequestHandler - limiting http connections to " << maxConnections << " per host per worker";
+      }
+      if( m_routeCacheTtl.count() > 0 ) {
+        DR_LOG(log_notice) << "RequestHandler::RequestHandler - caching http routing decisions for " << m_routeCacheTtl.count() << " secs";
+      }
+  }
+  RequestHandler::~RequestHandler() {
+    m_workers.clear() ;
+  }
+
   CURL* RequestHandler::createEasyHandle(void) {
     CURL* easy = curl_easy_init();
     if(!easy) {
@@ -564,6 +644,11 @@ namespace drachtio {
     curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
     curl_easy_setopt(easy, CURLOPT_USERAGENT, "Drachtio/" DRACHTIO_VERSION);
 
+    // negotiate HTTP/2 over TLS, and wait for an existing connection to become available for multiplexing 
+    // rather than opening another one
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+
     // set connect timeout to 2 seconds and total timeout to 3 seconds
     curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, 2000L);
     curl_easy_setopt(easy, CURLOPT_TIMEOUT, 3L);
@@ -575,12 +660,6 @@ namespace drachtio {
 
   std::shared_ptr<RequestHandler> RequestHandler::getInstance() {
     if(!instanceFlag) {
-
-      for( int i = 0; i < easyHandleCacheSize; i++ ) {
-        CURL* easy = createEasyHandle() ;
-        m_cacheEasyHandles.push_back( easy ) ;
-      }
-
       single.reset(new RequestHandler(theOneAndOnlyController));
       instanceFlag = true;
       return single;
@@ -591,8 +670,53 @@ namespace drachtio {
   }  
 
   void RequestHandler::makeRequestForRoute(const string& transactionId, const string& httpMethod, 
-    const string& httpUrl, const string& body, bool verifyPeer) {
+    const string& httpUrl, const string& body, const string& cacheKey, bool verifyPeer) {
+
+    // assign to the worker with the fewest outstanding requests
+    Worker* worker = m_workers[0].get() ;
+    int fewest = worker->outstanding().load() ;
+    for( unsigned int i = 1; i < m_workers.size() && fewest > 0; i++ ) {
+      int n = m_workers[i]->outstanding().load() ;
+      if( n < fewest ) {
+        fewest = n ;
+        worker = m_workers[i].get() ;
+      }
+    }
+    worker->outstanding()++ ;
 
-    m_ioservice.post( std::bind(&RequestHandler::startRequest, this, transactionId, httpMethod, httpUrl, body, verifyPeer)) ;
+    worker->getIOService().post( std::bind(&RequestHandler::Worker::startRequest, worker, 
+      transactionId, httpMethod, httpUrl, body, cacheKey, verifyPeer)) ;
+  }
+
+  bool RequestHandler::findCachedRoute(const string& cacheKey, long& responseCode, string& response) {
+    std::lock_guard<std::mutex> lock(m_routeCacheLock) ;
+    auto it = m_routeCache.find( cacheKey ) ;
+    if( m_routeCache.end() == it ) return false ;
+    if( std::chrono::steady_clock::now() >= it->second.expires ) {
+      m_routeCache.erase( it ) ;
+      return false ;
+    }
+    responseCode = it->second.responseCode ;
+    response = it->second.response ;
+    return true ;
+  }
+
+  void RequestHandler::cacheRoute(const string& cacheKey, long responseCode, const string& response) {
+    auto now = std::chrono::steady_clock::now() ;
+    std::lock_guard<std::mutex> lock(m_routeCacheLock) ;
+    if( m_routeCache.size() >= routeCacheMaxSize ) {
+      for( auto it = m_routeCache.begin(); it != m_routeCache.end(); ) {
+        if( now >= it->second.expires ) it = m_routeCache.erase( it ) ;
+        else ++it ;
+      }
+      if( m_routeCache.size() >= routeCacheMaxSize ) {
+        DR_LOG(log_warning) << "RequestHandler::cacheRoute - route cache is full, not caching decision for " << cacheKey ;
+        return ;
+      }
+    }
+    CachedRoute& route = m_routeCache[cacheKey] ;
+    route.responseCode = responseCode ;
+    route.response = response ;
+    route.expires = now + m_routeCacheTtl ;
   }
  }
@@ -23,6 +23,14 @@ THE SOFTWARE.
 #define __REQUEST_HANDLER_H__
 
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <boost/asio.hpp>
@@ -32,9 +40,8 @@ THE SOFTWARE.
 
 #include "drachtio.h"
 
-#define TXNID_LEN (255)
-#define URL_LEN (1024)
-#define HTTP_BODY_LEN (16384)
+#define HTTP_RESPONSE_RESERVE (1024)
+#define HTTP_RESPONSE_MAX_LEN (1048576)
 
 using boost::asio::ip::tcp;
 
@@ -45,68 +52,111 @@ namespace drachtio {
   class RequestHandler : public std::enable_shared_from_this<RequestHandler>  {
   public:
 
+    class Worker ;
+
     typedef struct _GlobalInfo {
         CURLM *multi;
         int still_running;
+        int in_flight;
+        Worker *worker;
     } GlobalInfo;
 
-    /* Information associated with a specific easy handle */
+    /* Information associated with a specific easy handle; buffers are sized to the request and response */
     typedef struct _ConnInfo {
-      _ConnInfo() {
-        memset(this, 0, sizeof(ConnInfo));
+      _ConnInfo() : easy(NULL), hdr_list(NULL), global(NULL) {
+        *error = '\0' ;
       }
 
       CURL *easy;
-      char url[URL_LEN+1];
-      char body[HTTP_BODY_LEN+1];
-      char transactionId[TXNID_LEN+1];
-      char response[HTTP_BODY_LEN+1] ;
+      string url;
+      string body;
+      string transactionId;
+      string cacheKey;
+      string response;
       struct curl_slist *hdr_list;
       GlobalInfo *global;
       char error[CURL_ERROR_SIZE];
     } ConnInfo;
 
+    /* 
+     * An http worker thread, with its own io_service, curl multi handle and easy handle cache.  
+     * Everything here other than the outstanding count is only touched from the worker's own thread.
+     */
+    class Worker {
+    public:
+      Worker( RequestHandler& handler, unsigned int index, unsigned int maxConnectionsPerHost ) ;
+      ~Worker() ;
+
+      void startRequest(const string& transactionId, const string& httpMethod, 
+        const string& url, const string& body, const string& cacheKey, bool verifyPeer);
+      void finishRequest(void) ;
+      void reportQueueStats(void) ;
+
+      RequestHandler& getHandler(void) { return m_handler; }
+      GlobalInfo& getGlobal(void) { return m_g; }
+      std::map<curl_socket_t, boost::asio::ip::tcp::socket *>& getSocketMap(void) { return m_socket_map; }
+      boost::asio::deadline_timer& getTimer(void) { return m_timer; }
+      boost::asio::io_service& getIOService(void) { return m_ioservice; }
+      std::deque<CURL*>& getEasyHandleCache(void) { return m_cacheEasyHandles; }
+      boost::object_pool<ConnInfo>& getPool(void) { return m_pool; }
+
+      // requests assigned to this worker that have not yet completed, including those not yet started
+      std::atomic<int>& outstanding(void) { return m_outstanding; }
+
+    private:
+      void threadFunc(void) ;
+
+      RequestHandler&             m_handler ;
+      string                      m_index ;
+      std::atomic<int>            m_outstanding ;
+
+      boost::asio::io_service     m_ioservice;
+      boost::asio::deadline_timer m_timer ;
+      std::map<curl_socket_t, boost::asio::ip::tcp::socket *> m_socket_map;
+      std::deque<CURL*>           m_cacheEasyHandles ;
+      boost::object_pool<ConnInfo> m_pool ;
+      GlobalInfo                  m_g ;
+      std::thread                 m_thread ;
+    } ;
+
     static std::shared_ptr<RequestHandler> getInstance();
 
     ~RequestHandler() ;
 
     void makeRequestForRoute(const string& transactionId, const string& httpMethod, 
-      const string& httpUrl, const string& body, bool verifyPeer = true) ;
-
-    void threadFunc(void) ;
-    GlobalInfo& getGlobal(void) { return m_g; }
-    std::map<curl_socket_t, boost::asio::ip::tcp::socket *>& getSocketMap(void) { return m_socket_map; }
-    boost::asio::deadline_timer& getTimer(void) { return m_timer; }
-    boost::asio::io_service& getIOService(void) { return m_ioservice; }
+      const string& httpUrl, const string& body, const string& cacheKey = "", bool verifyPeer = true) ;
 
-    static std::deque<CURL*>   m_cacheEasyHandles ;
-    static boost::object_pool<ConnInfo> m_pool ;
+    // routing decisions are shared by all workers
+    bool findCachedRoute(const string& cacheKey, long& responseCode, string& response) ;
+    void cacheRoute(const string& cacheKey, long responseCode, const string& response) ;
+    bool routeCacheEnabled(void) const { return m_routeCacheTtl.count() > 0; }
 
-  protected:
+    DrachtioController* getController(void) { return m_pController; }
 
-    void startRequest(const string& transactionId, const string& httpMethod, 
-      const string& url, const string& body, bool verifyPeer);
+    static CURL* createEasyHandle(void) ;
 
   private:
     // NB: this is a singleton object, accessed via the static getInstance method
     RequestHandler( DrachtioController* pController ) ;
-    static CURL* createEasyHandle(void) ;
 
     static bool               instanceFlag;
     static std::shared_ptr<RequestHandler> single;
     static unsigned int       easyHandleCacheSize ;
-    //static std::mutex        m_lock ;
+    static unsigned int       routeCacheMaxSize ;
 
     DrachtioController*         m_pController ;
-    std::thread               m_thread ;
-
-    boost::asio::io_service     m_ioservice;
 
-    boost::asio::deadline_timer m_timer ;
-    std::map<curl_socket_t, boost::asio::ip::tcp::socket *> m_socket_map;
+    std::vector< std::unique_ptr<Worker> > m_workers ;
 
+    typedef struct _CachedRoute {
+      long responseCode ;
+      string response ;
+      std::chrono::time_point<std::chrono::steady_clock> expires ;
+    } CachedRoute ;
 
-    GlobalInfo                  m_g ;
+    std::chrono::seconds        m_routeCacheTtl ;
+    std::mutex                  m_routeCacheLock ;
+    std::unordered_map<string, CachedRoute> m_routeCache ;
   } ;
 }  
 
@@ -0,0 +1,253 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <sstream>
+#include <algorithm>
+
+#include "request-tracer.hpp"
+#include "controller.hpp"
+
+#define TRACE_RING_SIZE (4096)            // must be a power of 2
+
+namespace {
+  // time the message currently being handled on this thread arrived
+  thread_local drachtio::RequestTracer::TimePoint_t tlsArrival ;
+
+  const std::chrono::milliseconds DRAIN_INTERVAL(50) ;
+  const std::chrono::seconds PRUNE_INTERVAL(10) ;
+
+  // spans that never see a response (app disconnected, request absorbed, etc) are discarded after this
+  const std::chrono::seconds MAX_SPAN_AGE(60) ;
+
+  // a stage for a request whose start is still sitting in another thread's ring is retried this many times
+  const unsigned int MAX_EVENT_RETRIES = 2 ;
+
+  const char* stageNames[] = {
+    "received",
+    "routed",
+    "dispatched",
+    "sent",
+    "read",
+    "parsed",
+    "handoff",
+    "replied"
+  } ;
+}
+
+namespace drachtio {
+
+  RequestTracer::Ring_t::Ring_t() : retired(false), dropped(0), m_events(TRACE_RING_SIZE), m_head(0), m_tail(0) {
+  }
+
+  bool RequestTracer::Ring_t::push( const string& transactionId, Stage_t stage, const TimePoint_t& t, const TimePoint_t& arrival ) {
+    uint64_t head = m_head.load( std::memory_order_relaxed ) ;
+    if( head - m_tail.load( std::memory_order_acquire ) >= TRACE_RING_SIZE ) {
+      dropped.fetch_add( 1, std::memory_order_relaxed ) ;
+      return false ;
+    }
+
+    // assigning into the slot reuses its string buffer, so once warmed up this does not allocate
+    Event_t& event = m_events[head & (TRACE_RING_SIZE - 1)] ;
+    event.transactionId = transactionId ;
+    event.stage = stage ;
+    event.t = t ;
+    event.arrival = arrival ;
+    event.retries = 0 ;
+    m_head.store( head + 1, std::memory_order_release ) ;
+    return true ;
+  }
+
+  void RequestTracer::Ring_t::drain( std::vector<Event_t>& events ) {
+    uint64_t tail = m_tail.load( std::memory_order_relaxed ) ;
+    uint64_t head = m_head.load( std::memory_order_acquire ) ;
+    for( ; tail != head; tail++ ) {
+      events.push_back( m_events[tail & (TRACE_RING_SIZE - 1)] ) ;
+    }
+    m_tail.store( tail, std::memory_order_release ) ;
+  }
+
+  RequestTracer::RingOwner_t::~RingOwner_t() {
+    // the trace thread frees the ring once it has drained it
+    if( ring ) ring->retired.store( true, std::memory_order_release ) ;
+  }
+
+  RequestTracer::RequestTracer() : m_bEnabled(false), m_bObserve(false), m_sampleRate(0), m_count(0),
+    m_lastPrune(std::chrono::steady_clock::now()), m_droppedReported(0), m_bStop(false) {
+  }
+
+  RequestTracer::~RequestTracer() {
+    m_bStop = true ;
+    if( m_thread.joinable() ) m_thread.join() ;
+  }
+
+  void RequestTracer::enable( bool observeHistograms, unsigned int sampleRate ) {
+    m_bObserve = observeHistograms ;
+    m_sampleRate = sampleRate ;
+    m_bEnabled = m_bObserve || m_sampleRate > 0 ;
+    if( m_bEnabled && !m_thread.joinable() ) {
+      std::thread t(&RequestTracer::threadFunc, this) ;
+      m_thread.swap( t ) ;
+    }
+  }
+
+  void RequestTracer::arrived() {
+    tlsArrival = std::chrono::steady_clock::now() ;
+  }
+
+  const char* RequestTracer::stageName( Stage_t stage ) {
+    return stage < STAGE_COUNT ? stageNames[stage] : "unknown" ;
+  }
+
+  void RequestTracer::begin( const string& transactionId ) {
+    if( !m_bEnabled ) return ;
+    record( transactionId, STAGE_ROUTED ) ;
+  }
+
+  void RequestTracer::mark( const string& transactionId, Stage_t stage ) {
+    if( !m_bEnabled ) return ;
+    record( transactionId, stage ) ;
+  }
+
+  void RequestTracer::record( const string& transactionId, Stage_t stage ) {
+    getRing()->push( transactionId, stage, std::chrono::steady_clock::now(), tlsArrival ) ;
+  }
+
+  RequestTracer::Ring_t* RequestTracer::getRing(void) {
+    static thread_local RingOwner_t owner ;
+    if( !owner.ring ) {
+      owner.ring = new Ring_t() ;
+      std::lock_guard<std::mutex> lock(m_mutex) ;
+      m_rings.push_back( owner.ring ) ;
+    }
+    return owner.ring ;
+  }
+
+  void RequestTracer::threadFunc(void) {
+    std::vector<Ring_t*> rings ;
+    std::vector<Event_t> events ;
+    while( !m_bStop ) {
+      std::this_thread::sleep_for( DRAIN_INTERVAL ) ;
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex) ;
+        rings = m_rings ;
+      }
+
+      events.swap( m_pending ) ;
+      uint64_t dropped = 0 ;
+      for( Ring_t* ring : rings ) {
+        // a retired ring gets no more events once the flag is seen, so this drain is its last
+        bool retired = ring->retired.load( std::memory_order_acquire ) ;
+        ring->drain( events ) ;
+        dropped += ring->dropped.load( std::memory_order_relaxed ) ;
+        if( retired ) {
+          {
+            std::lock_guard<std::mutex> lock(m_mutex) ;
+            m_rings.erase( std::remove( m_rings.begin(), m_rings.end(), ring ), m_rings.end() ) ;
+          }
+          delete ring ;
+        }
+      }
+      if( dropped > m_droppedReported ) {
+        DR_LOG(log_warning) << "RequestTracer::threadFunc - trace buffers full, " << dropped - m_droppedReported << " stages not traced" ;
+        m_droppedReported = dropped ;
+      }
+
+      process( events ) ;
+      events.clear() ;
+    }
+  }
+
+  void RequestTracer::process( std::vector<Event_t>& events ) {
+    // the stages of one request come from different threads' rings; put them back in the order they happened
+    std::stable_sort( events.begin(), events.end(), [](const Event_t& a, const Event_t& b) { return a.t < b.t; } ) ;
+
+    for( Event_t& event : events ) {
+      if( !apply( event ) && STAGE_ROUTED != event.stage && event.retries++ < MAX_EVENT_RETRIES ) {
+        m_pending.push_back( std::move(event) ) ;
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now() ;
+    if( now - m_lastPrune > PRUNE_INTERVAL ) prune( now ) ;
+  }
+
+  bool RequestTracer::apply( const Event_t& event ) {
+    Stage_t stage = event.stage ;
+    if( STAGE_ROUTED == stage ) {
+      Span_t span ;
+      span.t[STAGE_RECEIVED] = TimePoint_t() == event.arrival ? event.t : event.arrival ;
+      span.t[STAGE_ROUTED] = event.t ;
+      span.sampled = m_sampleRate > 0 && 0 == m_count++ % m_sampleRate ;
+      m_spans[event.transactionId] = span ;
+
+      if( m_bObserve ) {
+        std::chrono::duration<double> elapsed = span.t[STAGE_ROUTED] - span.t[STAGE_RECEIVED] ;
+        STATS_HISTOGRAM_OBSERVE_NOCHECK(STATS_HISTOGRAM_REQUEST_STAGE_TIME, elapsed.count(), {{"stage", stageNames[STAGE_ROUTED]}})
+      }
+      return true ;
+    }
+
+    auto it = m_spans.find( event.transactionId ) ;
+    if( m_spans.end() == it ) return false ;
+
+    // only the first response is traced
+    Span_t& span = it->second ;
+    if( TimePoint_t() != span.t[stage] ) return true ;
+
+    if( STAGE_PARSED == stage ) {
+      span.t[STAGE_READ] = TimePoint_t() == event.arrival ? event.t : event.arrival ;
+    }
+    span.t[stage] = event.t ;
+
+    if( m_bObserve ) {
+      int first = STAGE_PARSED == stage ? STAGE_READ : std::max<int>(stage, STAGE_ROUTED) ;
+      for( int i = first; i <= stage; i++ ) {
+        if( TimePoint_t() == span.t[i - 1] ) continue ;
+        std::chrono::duration<double> elapsed = span.t[i] - span.t[i - 1] ;
+        STATS_HISTOGRAM_OBSERVE_NOCHECK(STATS_HISTOGRAM_REQUEST_STAGE_TIME, elapsed.count(), {{"stage", stageNames[i]}})
+      }
+    }
+    if( STAGE_REPLIED == stage ) {
+      if( span.sampled ) logSpan( event.transactionId, span ) ;
+      m_spans.erase( it ) ;
+    }
+    return true ;
+  }
+
+  void RequestTracer::prune( const TimePoint_t& now ) {
+    for( auto it = m_spans.begin(); it != m_spans.end(); ) {
+      if( now - it->second.t[STAGE_ROUTED] > MAX_SPAN_AGE ) it = m_spans.erase( it ) ;
+      else ++it ;
+    }
+    m_lastPrune = now ;
+  }
+
+  void RequestTracer::logSpan( const string& transactionId, const Span_t& span ) {
+    std::ostringstream o ;
+    for( int i = STAGE_RECEIVED; i < STAGE_COUNT; i++ ) {
+      if( TimePoint_t() == span.t[i] ) continue ;
+      auto us = std::chrono::duration_cast<std::chrono::microseconds>(span.t[i] - span.t[STAGE_RECEIVED]).count() ;
+      o << " " << stageNames[i] << " +" << us << "us" ;
+    }
+    DR_LOG(log_info) << "RequestTracer: transaction " << transactionId << o.str() ;
+  }
+}
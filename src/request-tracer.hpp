@@ -0,0 +1,150 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __REQUEST_TRACER_HPP__
+#define __REQUEST_TRACER_HPP__
+
+#include <string>
+#include <array>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+
+using std::string ;
+
+namespace drachtio {
+
+  /**
+   * Follows a new incoming request from the network to the application and the application's
+   * first response back out to the network, keyed by transaction id.  Each stage records the time
+   * elapsed since the stage before it; a sampled subset of requests is also logged in full.
+   *
+   * The sofia and client threads only stamp each stage into a ring of their own; the spans are
+   * put together, observed and logged on a separate thread, so tracing takes no lock on those threads.
+   */
+  class RequestTracer {
+  public:
+    typedef std::chrono::time_point<std::chrono::steady_clock> TimePoint_t ;
+
+    enum Stage_t {
+      // request: sip network -> application
+      STAGE_RECEIVED = 0,     // processMessageStatelessly
+      STAGE_ROUTED,           // processNewRequest selected a client and posted to the client thread
+      STAGE_DISPATCHED,       // posted handler began running on the client thread
+      STAGE_SENT,             // Client::send write completed
+
+      // response: application -> sip network
+      STAGE_READ,             // Client::read_handler read the response
+      STAGE_PARSED,           // processClientMessage handed the response to the dialog controller
+      STAGE_HANDOFF,          // su_msg delivered to the sofia thread
+      STAGE_REPLIED,          // nta_*_treply returned
+      STAGE_COUNT
+    };
+
+    RequestTracer( const RequestTracer& ) = delete;
+
+    RequestTracer() ;
+    ~RequestTracer() ;
+
+    void enable( bool observeHistograms, unsigned int sampleRate ) ;
+    bool enabled(void) const { return m_bEnabled; }
+
+    // note the time a message arrived on the calling thread; it becomes the
+    // start time of STAGE_RECEIVED or STAGE_READ for requests traced from this thread
+    static void arrived(void) ;
+
+    void begin( const string& transactionId ) ;
+    void mark( const string& transactionId, Stage_t stage ) ;
+
+    static const char* stageName( Stage_t stage ) ;
+
+  private:
+    struct Span_t {
+      Span_t() : sampled(false) {}
+      std::array<TimePoint_t, STAGE_COUNT> t ;
+      bool sampled ;
+    } ;
+
+    struct Event_t {
+      Event_t() : stage(STAGE_RECEIVED), retries(0) {}
+      string transactionId ;
+      Stage_t stage ;
+      TimePoint_t t ;
+      TimePoint_t arrival ;   // tlsArrival of the thread that recorded the event
+      unsigned int retries ;
+    } ;
+
+    // single producer (the thread that owns it), single consumer (the trace thread)
+    class Ring_t {
+    public:
+      Ring_t() ;
+      bool push( const string& transactionId, Stage_t stage, const TimePoint_t& t, const TimePoint_t& arrival ) ;
+      void drain( std::vector<Event_t>& events ) ;
+
+      std::atomic<bool> retired ;
+      std::atomic<uint64_t> dropped ;
+
+    private:
+      std::vector<Event_t> m_events ;
+      std::atomic<uint64_t> m_head ;
+      std::atomic<uint64_t> m_tail ;
+    } ;
+
+    class RingOwner_t {
+    public:
+      RingOwner_t() : ring(nullptr) {}
+      ~RingOwner_t() ;
+      Ring_t* ring ;
+    } ;
+
+    void record( const string& transactionId, Stage_t stage ) ;
+    Ring_t* getRing(void) ;
+
+    void threadFunc(void) ;
+    void process( std::vector<Event_t>& events ) ;
+    bool apply( const Event_t& event ) ;
+    void prune( const TimePoint_t& now ) ;
+    void logSpan( const string& transactionId, const Span_t& span ) ;
+
+    bool m_bEnabled ;
+    bool m_bObserve ;
+    unsigned int m_sampleRate ;
+
+    // rings are added the first time a thread records a stage, and freed by the trace thread after that thread exits
+    std::mutex m_mutex ;
+    std::vector<Ring_t*> m_rings ;
+
+    // only accessed on the trace thread
+    unsigned int m_count ;
+    std::unordered_map<string, Span_t> m_spans ;
+    std::vector<Event_t> m_pending ;
+    TimePoint_t m_lastPrune ;
+    uint64_t m_droppedReported ;
+
+    std::thread m_thread ;
+    std::atomic<bool> m_bStop ;
+  } ;
+}
+
+#endif
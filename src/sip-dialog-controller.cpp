@@ -53,52 +53,54 @@ namespace {
 
     void cloneRespondToSipRequest(su_root_magic_t* p, su_msg_r msg, void* arg ) {
         drachtio::DrachtioController* pController = reinterpret_cast<drachtio::DrachtioController*>( p ) ;
+        drachtio::SofiaCallbackTimer t("su_msg") ;
+        pController->suMsgDequeued() ;
         drachtio::SipDialogController::SipMessageData* d = reinterpret_cast<drachtio::SipDialogController::SipMessageData*>( arg ) ;
         pController->getDialogController()->doRespondToSipRequest( d ) ;
     }
     void cloneSendSipRequest(su_root_magic_t* p, su_msg_r msg, void* arg ) {
         drachtio::DrachtioController* pController = reinterpret_cast<drachtio::DrachtioController*>( p ) ;
+        drachtio::SofiaCallbackTimer t("su_msg") ;
+        pController->suMsgDequeued() ;
         drachtio::SipDialogController::SipMessageData* d = reinterpret_cast<drachtio::SipDialogController::SipMessageData*>( arg ) ;
         pController->getDialogController()->doSendRequestOutsideDialog( d ) ;
     }
     void cloneSendSipCancelRequest(su_root_magic_t* p, su_msg_r msg, void* arg ) {
         drachtio::DrachtioController* pController = reinterpret_cast<drachtio::DrachtioController*>( p ) ;
+        drachtio::SofiaCallbackTimer t("su_msg") ;
+        pController->suMsgDequeued() ;
         drachtio::SipDialogController::SipMessageData* d = reinterpret_cast<drachtio::SipDialogController::SipMessageData*>( arg ) ;
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_IN, {{"method", "CANCEL"}})
+        STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_IN, sip_method_cancel, "CANCEL")
         pController->getDialogController()->doSendCancelRequest( d ) ;
     }
     int uacLegCallback( nta_leg_magic_t* p, nta_leg_t* leg, nta_incoming_t* irq, sip_t const *sip) {
-        if( sip && sip->sip_request ) STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_IN, {{"method", sip->sip_request->rq_method_name}})
+        if( sip && sip->sip_request ) STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_IN, sip->sip_request->rq_method, sip->sip_request->rq_method_name)
         drachtio::DrachtioController* pController = reinterpret_cast<drachtio::DrachtioController*>( p ) ;
         return pController->getDialogController()->processRequestInsideDialog( leg, irq, sip) ;
     }
     int uasCancelOrAck( nta_incoming_magic_t* p, nta_incoming_t* irq, sip_t const *sip ) {
-        if( sip && sip->sip_request ) STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_IN, {{"method", sip->sip_request->rq_method_name}})
+        if( sip && sip->sip_request ) STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_IN, sip->sip_request->rq_method, sip->sip_request->rq_method_name)
         drachtio::DrachtioController* pController = reinterpret_cast<drachtio::DrachtioController*>( p ) ;
         return pController->getDialogController()->processCancelOrAck( p, irq, sip) ;
     }
     int uasPrack( drachtio::SipDialogController *pController, nta_reliable_t *rel, nta_incoming_t *prack, sip_t const *sip) {
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_IN, {{"method", "PRACK"}})
+        STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_IN, sip_method_prack, "PRACK")
         return pController->processPrack( rel, prack, sip) ;
     }
    int response_to_request_outside_dialog( nta_outgoing_magic_t* p, nta_outgoing_t* request, sip_t const* sip ) {  
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_IN, {
-            {"method", sip->sip_cseq->cs_method_name},
-            {"code", boost::lexical_cast<std::string>(sip->sip_status->st_status)}
-        }) 
+        STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_IN, sip->sip_cseq->cs_method, sip->sip_cseq->cs_method_name, sip->sip_status->st_status) 
         drachtio::DrachtioController* pController = reinterpret_cast<drachtio::DrachtioController*>( p ) ;
         return pController->getDialogController()->processResponseOutsideDialog( request, sip ) ;
     } 
    int response_to_request_inside_dialog( nta_outgoing_magic_t* p, nta_outgoing_t* request, sip_t const* sip ) {   
         drachtio::DrachtioController* pController = reinterpret_cast<drachtio::DrachtioController*>( p ) ;
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_IN, {
-            {"method", sip->sip_cseq->cs_method_name},
-            {"code", boost::lexical_cast<std::string>(sip->sip_status->st_status)}
-        }) 
+        STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_IN, sip->sip_cseq->cs_method, sip->sip_cseq->cs_method_name, sip->sip_status->st_status) 
         return pController->getDialogController()->processResponseInsideDialog( request, sip ) ;
     } 
     void cloneSendSipRequestInsideDialog(su_root_magic_t* p, su_msg_r msg, void* arg ) {
         drachtio::DrachtioController* pController = reinterpret_cast<drachtio::DrachtioController*>( p ) ;
+        drachtio::SofiaCallbackTimer t("su_msg") ;
+        pController->suMsgDequeued() ;
         drachtio::SipDialogController::SipMessageData* d = reinterpret_cast<drachtio::SipDialogController::SipMessageData*>( arg ) ;
         pController->getDialogController()->doSendRequestInsideDialog( d ) ;
     }
@@ -153,8 +155,10 @@ namespace drachtio {
 
         /* we need to use placement new to allocate the object in a specific address, hence we are responsible for deleting it (below) */
         SipMessageData* msgData = new(place) SipMessageData( clientMsgId, transactionId, "", dialogId, startLine, headers, body ) ;
+        m_pController->suMsgQueued() ;
         rv = su_msg_send(msg);  
         if( rv < 0 ) {
+            m_pController->suMsgDequeued() ;
             m_pController->getClientController()->route_api_response( clientMsgId, "NOK", "Internal server error sending message") ;
             return  false;
         }
@@ -366,7 +370,7 @@ namespace drachtio {
                 msg_t* m = nta_outgoing_getrequest(orq) ;  // adds a reference
                 sip_t* sip = sip_object( m ) ;
 
-                STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_OUT, {{"method", sip->sip_request->rq_method_name}})
+                STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name)
 
                 string encodedMessage ;
                 EncodeStackMessage( sip, encodedMessage ) ;
@@ -436,8 +440,10 @@ namespace drachtio {
 
         /* we need to use placement new to allocate the object in a specific address, hence we are responsible for deleting it (below) */
         SipMessageData* msgData = new(place) SipMessageData( clientMsgId, transactionId, "", dialogId, startLine, headers, body, routeUrl ) ;
+        m_pController->suMsgQueued() ;
         rv = su_msg_send(msg);  
         if( rv < 0 ) {
+            m_pController->suMsgDequeued() ;
             return  false;
         }
         return true ;
@@ -615,7 +621,7 @@ namespace drachtio {
             DR_LOG(log_info) << "SipDialogController::doSendRequestOutsideDialog - created orq " << std::hex << (void *) orq  <<
                 " call-id " << sip->sip_call_id->i_id << " / transaction id: " << pData->getTransactionId();
 
-            STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_OUT, {{"method", sip->sip_request->rq_method_name}})
+            STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name)
 
             if( method == sip_method_invite || method == sip_method_subscribe ) {
                 std::shared_ptr<SipDialog> dlg = std::make_shared<SipDialog>(pData->getTransactionId(), 
@@ -668,8 +674,10 @@ namespace drachtio {
 
         /* we need to use placement new to allocate the object in a specific address, hence we are responsible for deleting it (below) */
         SipMessageData* msgData = new(place) SipMessageData( clientMsgId, transactionId, "", "", startLine, headers, body ) ;
+        m_pController->suMsgQueued() ;
         rv = su_msg_send(msg);  
         if( rv < 0 ) {
+            m_pController->suMsgDequeued() ;
             return  false;
         }
         return true ;
@@ -685,8 +693,10 @@ namespace drachtio {
         /* we need to use placement new to allocate the object in a specific address, hence we are responsible for deleting it (below) */
         string rid ;
         SipMessageData* msgData = new(place) SipMessageData( clientMsgId, transactionId, "", "", startLine, headers, body ) ;
+        m_pController->suMsgQueued() ;
         rv = su_msg_send(msg);  
         if( rv < 0 ) {
+            m_pController->suMsgDequeued() ;
             return  false ;
         }
 
@@ -934,6 +944,7 @@ namespace drachtio {
         std::shared_ptr<IIP> iip;
 
         DR_LOG(log_debug) << "SipDialogController::doRespondToSipRequest thread " << std::this_thread::get_id() ;
+        m_pController->getRequestTracer().mark( transactionId, RequestTracer::STAGE_HANDOFF ) ;
 
         /* search for requests within a dialog first */
         irq = findAndRemoveTransactionIdForIncomingRequest( transactionId ) ;
@@ -1333,6 +1344,8 @@ namespace drachtio {
         }
 
         if( bSentOK ) {
+            m_pController->getRequestTracer().mark( transactionId, RequestTracer::STAGE_REPLIED ) ;
+
             string encodedMessage ;
             msg_t* msg = nta_incoming_getresponse( irq ) ;  // adds a ref
 
@@ -1343,9 +1356,7 @@ namespace drachtio {
                 EncodeStackMessage( sip, encodedMessage ) ;
                 SipMsgData_t meta( msg, irq, "application" ) ;
 
-                STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {
-                    {"method", sip->sip_cseq->cs_method_name},
-                    {"code", boost::lexical_cast<std::string>(code)}})
+                STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_cseq->cs_method, sip->sip_cseq->cs_method_name, code)
 
                 string s ;
                 meta.toMessageFormat(s) ;
@@ -1711,7 +1722,7 @@ namespace drachtio {
             nta_outgoing_destroy( ack_request ) ;
             clearRIP( orq ) ;
 
-            STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_OUT, {{"method", "ACK"}})
+            STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_OUT, sip_method_ack, "ACK")
             return 0;
         }
         nta_outgoing_destroy( orq ) ;
@@ -1859,7 +1870,7 @@ namespace drachtio {
 
             DR_LOG(log_info) << "SipDialogController::notifyRefreshDialog - created orq " << std::hex << (void *) orq;
 
-            STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_OUT, {{"method", "INVITE"}})
+            STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_OUT, sip_method_invite, "INVITE")
 
             //m_pClientController->route_event_inside_dialog( "{\"eventName\": \"refresh\"}",dlg->getTransactionId(), dlg->getDialogId() ) ;
         }
@@ -1896,7 +1907,7 @@ namespace drachtio {
             Cdr::postCdr( std::make_shared<CdrStop>( m, "application", ackbye ? Cdr::ackbye : Cdr::session_expired ) );
             nta_outgoing_destroy(orq) ;
 
-            STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_OUT, {{"method", "BYE"}})
+            STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_OUT, sip_method_bye, "BYE")
         }
         SD_Clear(m_dialogs, dlg) ;
     }
@@ -2018,7 +2029,7 @@ namespace drachtio {
         DR_LOG(log_info) << "SipDialogController::endRetransmitFinalResponse - created orq " << std::hex << (void *) orq 
             << " for BYE on leg " << (void *)leg;
 
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_OUT, {{"method", "BYE"}})
+        STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_OUT, sip_method_bye, "BYE")
 
         string encodedMessage ;
         EncodeStackMessage( sip, encodedMessage ) ;
@@ -2179,32 +2190,36 @@ namespace drachtio {
         return success;
     }
 
-    void SipDialogController::logRIP(bool bDetail) {
-        DR_LOG(bDetail ? log_info : log_debug) << "RIP size:                                                        " <<
-            m_mapOrq2RIP.size();
-        if (bDetail) {
+    // logging / metrics
+
+    /* called on the sofia thread, for the state that is only ever touched there */
+    void SipDialogController::snapshotStorageCount(WatchdogSnapshot_t& snapshot) {
+        snapshot.addCount("number of outgoing transactions held for timerD:                 ", m_timerDHandler.countTimerD()) ;
+        snapshot.addCount("number of outgoing transactions waiting for ACK from app:        ", m_timerDHandler.countPending()) ;
+        snapshot.addCount("RIP size:                                                        ", m_mapOrq2RIP.size()) ;
+        if (snapshot.isDetail()) {
             for (const auto& pair : m_mapOrq2RIP) {
-                nta_outgoing_t* orq = pair.first;
-                std::shared_ptr<RIP> p = pair.second;
-                DR_LOG(log_debug) << "    orq: " << std::hex << (void *) orq << " dialog id " << p->getDialogId() << " txn id " << p->getTransactionId();
+                std::ostringstream o ;
+                o << "    orq: " << std::hex << (void *) pair.first << " dialog id " << pair.second->getDialogId() << 
+                    " txn id " << pair.second->getTransactionId() ;
+                snapshot.addDetail(o.str()) ;
             }
         }
+        m_pTQM->snapshotQueueSizes(snapshot) ;
     }
 
-    // logging / metrics
+    /* called on the watchdog thread; everything here is guarded by a mutex */
     void SipDialogController::logStorageCount(bool bDetail)  {
 
-        DR_LOG(bDetail ? log_info : log_debug) << "SipDiaSD_LoglogController storage counts"  ;
+        DR_LOG(bDetail ? log_info : log_debug) << "SipDialogController storage counts"  ;
         DR_LOG(bDetail ? log_info : log_debug) << "----------------------------------"  ;
         IIP_Log(m_invitesInProgress, bDetail);
         SD_Log(m_dialogs, bDetail);
 
-        std::lock_guard<std::mutex> lock(m_mutex) ;
-        DR_LOG(bDetail ? log_info : log_debug) << "m_mapTransactionId2Irq size:                                     " << m_mapTransactionId2Irq.size()  ;
-        DR_LOG(bDetail ? log_info : log_debug) << "number of outgoing transactions held for timerD:                 " << m_timerDHandler.countTimerD()  ;
-        DR_LOG(bDetail ? log_info : log_debug) << "number of outgoing transactions waiting for ACK from app:        " << m_timerDHandler.countPending()  ;
-        logRIP(bDetail);
-        m_pTQM->logQueueSizes() ;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex) ;
+            DR_LOG(bDetail ? log_info : log_debug) << "m_mapTransactionId2Irq size:                                     " << m_mapTransactionId2Irq.size()  ;
+        }
 
         // stats
         if (theOneAndOnlyController->getStatsCollector().enabled()) {
@@ -196,6 +196,7 @@ namespace drachtio {
 
     void notifyCancelTimeoutReachedIIP( std::shared_ptr<IIP> dlg ) ;
 
+		void snapshotStorageCount(WatchdogSnapshot_t& snapshot) ;
 		void logStorageCount(bool bDetail = false)  ;
 
 		/// IIP helpers 
@@ -282,7 +283,6 @@ namespace drachtio {
 		/* we need to lookup responses to requests sent by the client inside a dialog */
 		typedef std::unordered_map<nta_outgoing_t*, std::shared_ptr<RIP> > mapOrq2RIP ;
 		mapOrq2RIP m_mapOrq2RIP ;
-        void logRIP(bool detail);
         
 		// Requests received from the network
 
@@ -21,6 +21,7 @@ THE SOFTWARE.
 */
 #include <stdexcept>
 #include <mutex>
+#include <vector>
 
 #include <boost/functional/hash.hpp>
 
@@ -396,10 +397,15 @@ namespace drachtio {
     DR_LOG(log_debug) << "StableDialogs uac:                                               " << nUac;
     DR_LOG(log_debug) << "StableDialogs uas:                                               " << nUas;
     if (full && count) {
-      std::lock_guard<std::mutex> lock(sd_mutex) ;
-      auto &idx = dialogs.get<DlgTimeTag>();
-      for (auto it = idx.begin(); it != idx.end(); ++it) {
-				std::shared_ptr<SipDialog> p = *it;
+
+      // take references under the lock, but do the (slow) logging after releasing it
+      std::vector< std::shared_ptr<SipDialog> > entries;
+      {
+        std::lock_guard<std::mutex> lock(sd_mutex) ;
+        auto &idx = dialogs.get<DlgTimeTag>();
+        entries.assign(idx.begin(), idx.end());
+      }
+      for (const auto& p : entries) {
         DR_LOG(log_debug) << *p;
       }
     }
@@ -46,6 +46,8 @@ static drachtio::SipProxyController* theProxyController = NULL ;
 namespace {
     void cloneProxy(su_root_magic_t* p, su_msg_r msg, void* arg ) {
         drachtio::DrachtioController* pController = reinterpret_cast<drachtio::DrachtioController*>( p ) ;
+        drachtio::SofiaCallbackTimer t("su_msg") ;
+        pController->suMsgDequeued() ;
         drachtio::SipProxyController::ProxyData* d = reinterpret_cast<drachtio::SipProxyController::ProxyData*>( arg ) ;
         pController->getProxyController()->doProxy(d) ;
     }
@@ -271,10 +273,7 @@ namespace drachtio {
         // stats
         if (theOneAndOnlyController->getStatsCollector().enabled()) {
             if (m_sipStatus >= 200) {
-                STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {
-                    {"method", sip->sip_cseq->cs_method_name},
-                    {"code", boost::lexical_cast<std::string>(sip->sip_status->st_status)}
-                })
+                STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_cseq->cs_method, sip->sip_cseq->cs_method_name, sip->sip_status->st_status)
             }
             if (sip->sip_cseq->cs_method == sip_method_invite) {
                 auto now = std::chrono::steady_clock::now();
@@ -520,7 +519,7 @@ namespace drachtio {
             return false ;
         }
 
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_OUT, {{"method", "PRACK"}})
+        STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_OUT, sip_method_prack, "PRACK")
 
         return true ;
     }
@@ -620,7 +619,7 @@ namespace drachtio {
             return true ;
         }
 
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_OUT, {{"method", sip->sip_request->rq_method_name}})
+        STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name)
 
         if( 1 == m_transmitCount && this->isInviteTransaction() ) {
             Cdr::postCdr( std::make_shared<CdrAttempt>( msg, "application" ) );
@@ -879,7 +878,7 @@ namespace drachtio {
  
             goto err ;
 
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_OUT, {{"method", "CANCEL"}})
+        STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_OUT, sip_method_cancel, "CANCEL")
 
         m_canceled = true ;
         return 0;
@@ -1220,8 +1219,10 @@ namespace drachtio {
         /* we need to use placement new to allocate the object in a specific address, hence we are responsible for deleting it (below) */
         ProxyData* msgData = new(place) ProxyData( clientMsgId, transactionId, recordRoute, fullResponse, followRedirects, 
             simultaneous, provisionalTimeout, finalTimeout, vecDestinations, headers ) ;
+        m_pController->suMsgQueued() ;
         rv = su_msg_send(m);  
         if( rv < 0 ) {
+            m_pController->suMsgDequeued() ;
             m_pController->getClientController()->route_api_response( clientMsgId, "NOK", "Internal server error sending message") ;
             return  ;
         }
@@ -1313,18 +1314,12 @@ namespace drachtio {
         string callId = sip->sip_call_id->i_id ;
         DR_LOG(log_debug) << "SipProxyController::processResponse " << std::dec << sip->sip_status->st_status << " " << callId ;
 
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_IN, {
-            {"method", sip->sip_cseq->cs_method_name},
-            {"code", boost::lexical_cast<std::string>(sip->sip_status->st_status)}
-        }) 
+        STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_IN, sip->sip_cseq->cs_method, sip->sip_cseq->cs_method_name, sip->sip_status->st_status) 
 
         // responses to PRACKs we forward downstream
         if( sip_method_prack == sip->sip_cseq->cs_method ) {
             DR_LOG(log_debug)<< "processResponse - forwarding response to PRACK downstream " << callId ;
-            STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {
-                {"method", sip->sip_cseq->cs_method_name},
-                {"code", boost::lexical_cast<std::string>(sip->sip_status->st_status)}
-            }) 
+            STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_cseq->cs_method, sip->sip_cseq->cs_method_name, sip->sip_status->st_status) 
             nta_msg_tsend( NTA, msg, NULL, TAG_END() ) ;  
             return true ;                      
         }
@@ -1338,10 +1333,7 @@ namespace drachtio {
         //search for a matching client transaction to handle the response
         if( !p->processResponse( msg, sip ) ) {
             DR_LOG(log_debug)<< "processResponse - forwarding upstream (not handled by client transactions)" << callId ;
-            STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {
-                {"method", sip->sip_cseq->cs_method_name},
-                {"code", boost::lexical_cast<std::string>(sip->sip_status->st_status)}
-            }) 
+            STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_cseq->cs_method, sip->sip_cseq->cs_method_name, sip->sip_status->st_status) 
             nta_msg_tsend( NTA, msg, NULL, TAG_END() ) ;  
             return true ;          
         }
@@ -1367,7 +1359,7 @@ namespace drachtio {
 
         DR_LOG(log_debug) << "SipProxyController::processRequestWithRouteHeader " << callId ;
 
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_IN, {{"method", sip->sip_request->rq_method_name}})
+        STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_IN, sip->sip_request->rq_method, sip->sip_request->rq_method_name)
 
         sip_route_remove( msg, sip) ;
 
@@ -1432,7 +1424,7 @@ namespace drachtio {
             DR_LOG(log_error) << "SipProxyController::processRequestWithRouteHeader failed proxying request " << callId << ": error " << rc ; 
             return false ;
         }
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_OUT, {{"method", sip->sip_request->rq_method_name}})
+        STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name)
 
         if( sip_method_bye == sip->sip_request->rq_method ) {
             Cdr::postCdr( std::make_shared<CdrStop>( msg, "application", Cdr::normal_release ) );            
@@ -1445,7 +1437,7 @@ namespace drachtio {
     bool SipProxyController::processRequestWithoutRouteHeader( msg_t* msg, sip_t* sip ) {
         string callId = sip->sip_call_id->i_id ;
 
-        STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_REQUESTS_IN, {{"method", sip->sip_request->rq_method_name}})
+        STATS_COUNTER_INCREMENT_SIP(SIP_REQUESTS_IN, sip->sip_request->rq_method, sip->sip_request->rq_method_name)
 
         std::shared_ptr<ProxyCore> p = getProxy( sip ) ;
         if( !p ) {
@@ -1475,10 +1467,7 @@ namespace drachtio {
         if(  sip_method_cancel == sip->sip_request->rq_method ) {
             p->setCanceled(true) ;
 
-            STATS_COUNTER_INCREMENT(STATS_COUNTER_SIP_RESPONSES_OUT, {
-                {"method", sip->sip_request->rq_method_name},
-                {"code", "200"}
-            }) 
+            STATS_COUNTER_INCREMENT_SIP(SIP_RESPONSES_OUT, sip->sip_request->rq_method, sip->sip_request->rq_method_name, 200) 
 
             nta_msg_treply( NTA, msg, 200, NULL, TAG_END() ) ;  //200 OK to the CANCEL
             p->generateResponse( 487 ) ;   //487 to INVITE
@@ -1669,10 +1658,12 @@ namespace drachtio {
                 DR_LOG(bDetail ? log_info : log_debug) << "    nonce: " << std::hex << (kv.first).c_str() << ", remote address: " << p->getRemoteAddress().c_str();
             }
         }
-        m_pTQM->logQueueSizes() ;
 
         STATS_GAUGE_SET(STATS_GAUGE_PROXY, m_mapCallId2Proxy.size())
     }
+    void SipProxyController::snapshotStorageCount(WatchdogSnapshot_t& snapshot) {
+        m_pTQM->snapshotQueueSizes(snapshot) ;
+    }
 
 
 } ;
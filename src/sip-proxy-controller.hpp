@@ -411,6 +411,7 @@ namespace drachtio {
 
     bool isProxyingRequest( msg_t* msg, sip_t* sip )  ;
 
+    void snapshotStorageCount(WatchdogSnapshot_t& snapshot) ;
     void logStorageCount(bool bDetail = false) ;
 
     bool isRetransmission( sip_t* sip ) {
@@ -31,6 +31,8 @@ THE SOFTWARE.
 #include "controller.hpp"
 #include "drachtio.h"
 
+#define TRANSPORT_SELECTION_CACHE_SIZE (1024)
+
 namespace {
     /* needed to be able to live in a boost unordered container */
     size_t hash_value( const drachtio::SipTransport& d) {
@@ -340,6 +342,11 @@ namespace drachtio {
 
   SipTransport::mapTport2SipTransport SipTransport::m_mapTport2SipTransport  ;
   std::shared_ptr<SipTransport> SipTransport::m_masterTransport ;
+  SipTransport::mapKey2SelectionTable SipTransport::m_mapSelectionTables ;
+  SipTransport::SelectionLru_t SipTransport::m_selectionLru ;
+  SipTransport::mapDest2Selection SipTransport::m_mapSelectionCache ;
+  std::mutex SipTransport::m_selectionLock ;
+  std::shared_ptr<const SipTransport::LocalAddresses_t> SipTransport::m_localAddresses ;
 
   /**
    * iterate all tport_t* that have been created, and any that are "unassigned" associate
@@ -406,6 +413,90 @@ namespace drachtio {
         }
       }
     }
+
+    buildSelectionTables() ;
+    buildLocalAddresses() ;
+  }
+
+  /**
+   * produce the key a host is stored under in the set of local addresses: the binary address
+   * for ipv4 and ipv6 literals (with or without brackets), otherwise the lowercased name
+   */
+  bool SipTransport::localAddressKey(const char* szHost, string& key) {
+    if (!szHost || !*szHost) return false;
+
+    char buf[INET6_ADDRSTRLEN + 1];
+    const char* host = szHost;
+    size_t len = strlen(szHost);
+    if ('[' == szHost[0] && ']' == szHost[len - 1] && len - 2 < sizeof(buf)) {
+      memcpy(buf, szHost + 1, len - 2);
+      buf[len - 2] = '\0';
+      host = buf;
+    }
+
+    struct in6_addr addr6;
+    struct in_addr addr4;
+    if (1 == inet_pton(AF_INET, host, &addr4)) {
+      key.assign(1, '4');
+      key.append((const char *) &addr4, sizeof(addr4));
+    }
+    else if (1 == inet_pton(AF_INET6, host, &addr6)) {
+      key.assign(1, '6');
+      key.append((const char *) &addr6, sizeof(addr6));
+    }
+    else {
+      key.assign(1, 'n');
+      key.append(szHost);
+      std::transform(key.begin() + 1, key.end(), key.begin() + 1, ::tolower);
+    }
+    return true;
+  }
+
+  void SipTransport::buildLocalAddresses() {
+    auto addresses = std::make_shared<LocalAddresses_t>();
+    string key;
+    for (const auto& kv : m_mapTport2SipTransport) {
+      std::shared_ptr<SipTransport> p = kv.second ;
+      if (localAddressKey(p->getHost(), key)) addresses->insert(key);
+      if (localAddressKey(p->m_contactHostpart.c_str(), key)) addresses->insert(key);
+      if (p->hasExternalIp() && localAddressKey(p->getExternalIp().c_str(), key)) addresses->insert(key);
+      for (const string& name : p->getDnsNames()) {
+        if (localAddressKey(name.c_str(), key)) addresses->insert(key);
+      }
+    }
+    DR_LOG(log_debug) << "SipTransport::buildLocalAddresses - " << dec << addresses->size() << " local hosts, addresses and names";
+    std::atomic_store(&m_localAddresses, std::shared_ptr<const LocalAddresses_t>(addresses));
+  }
+
+  void SipTransport::buildSelectionTables() {
+    std::lock_guard<std::mutex> lock(m_selectionLock) ;
+    m_mapSelectionTables.clear() ;
+    m_mapSelectionCache.clear() ;
+    m_selectionLru.clear() ;
+
+    for (const auto& kv : m_mapTport2SipTransport) {
+      std::shared_ptr<SipTransport> p = kv.second ;
+      SelectionEntry_t entry ;
+      entry.transport = p ;
+      entry.addr = 0 ;
+      entry.range = p->m_range ;
+      entry.netmask = p->m_netmask ;
+
+      struct in_addr addr ;
+      if (1 == inet_pton(AF_INET, p->getHost(), &addr)) entry.addr = ntohl(addr.s_addr) ;
+
+      const char* family = p->isIpV6() ? "/6" : "/4" ;
+      m_mapSelectionTables[string(p->getProtocol()) + family].push_back(entry) ;
+      m_mapSelectionTables[family].push_back(entry) ;
+    }
+
+    // all else being equal, prefer transports with an external address and avoid those bound to localhost
+    for (auto& kv : m_mapSelectionTables) {
+      std::stable_sort(kv.second.begin(), kv.second.end(), [](const SelectionEntry_t& a, const SelectionEntry_t& b) {
+        if (a.transport->hasExternalIp() != b.transport->hasExternalIp()) return a.transport->hasExternalIp() ;
+        return !a.transport->isLocalhost() && b.transport->isLocalhost() ;
+      });
+    }
   }
 
   std::shared_ptr<SipTransport> SipTransport::findTransport(tport_t* tp) {
@@ -420,6 +511,23 @@ namespace drachtio {
   }
 
   std::shared_ptr<SipTransport> SipTransport::findAppropriateTransport(const char* remoteHost, const char* proto) {
+
+    // the choice depends only on the host, transport param and requested protocol, so leave any user part out of the key
+    const char* dest = remoteHost ;
+    const char* at = strchr(remoteHost, '@') ;
+    const char* query = strchr(remoteHost, '?') ;
+    if (at && (!query || at < query)) dest = at + 1 ;
+    string key = (NULL == proto ? "" : proto) ;
+    key.push_back('|') ;
+    key.append(dest) ;
+
+    std::lock_guard<std::mutex> lock(m_selectionLock) ;
+    mapDest2Selection::iterator itCache = m_mapSelectionCache.find(key) ;
+    if (m_mapSelectionCache.end() != itCache) {
+      m_selectionLru.splice(m_selectionLru.begin(), m_selectionLru, itCache->second) ;
+      return itCache->second->second ;
+    }
+
     string scheme, userpart, hostpart, port ;
     vector< pair<string,string> > vecParam ;
     string host = remoteHost ;
@@ -440,81 +548,61 @@ namespace drachtio {
     string desc ;
     bool wantsIpV6 = (NULL != strstr( remoteHost, "[") && NULL != strstr( remoteHost, "]")) ;
 
-    // create vector of candidates, remove those with wrong transport or protocol
-    // then sort from most to least desirable:
+    // from most to least desirable:
     // - transports within the subnet of the remote host
+    // - transports sharing the most leading octets with the remote host
     // - transports that have an external address
     // - ...all others, and finally..
     // - transports bound to localhost
-    std::vector< std::shared_ptr<SipTransport> > candidates;
-    std::pair< tport_t*, boost::shared_ptr<SipTransport> > myPair;
-
-    for (auto pair : m_mapTport2SipTransport) {
-      candidates.push_back(pair.second);
-    }
-
-    // filter by transport
-    auto it = std::remove_if(candidates.begin(), candidates.end(), [wantsIpV6](const std::shared_ptr<SipTransport>& p) {
-      return (wantsIpV6 && !p->isIpV6()) || (!wantsIpV6 && p->isIpV6());
-    });
-    candidates.erase(it, candidates.end());
-    DR_LOG(log_debug) <<  "SipTransport::findAppropriateTransport - after filtering for transport we have " << candidates.size() << " candidates";
-
-    // filter by protocol
-    it = std::remove_if(candidates.begin(), candidates.end(), [requestedProto](const std::shared_ptr<SipTransport>& p) {
-      if (requestedProto.length() == 0) return false;
-      return 0 != strcmp(p->getProtocol(), requestedProto.c_str());
-    });
-    candidates.erase(it, candidates.end());
-    DR_LOG(log_debug) <<  "SipTransport::findAppropriateTransport - after filtering for protocol we have " << candidates.size() << " candidates";
-
-
-    sort(candidates.begin(), candidates.end(), [host](const std::shared_ptr<SipTransport>& pA, const std::shared_ptr<SipTransport>& pB) {
-
-      if (pA->isInNetwork(host.c_str())) {
-        return true;
-      }
-      if (pB->isInNetwork(host.c_str())) {
-        return false;
+    // the last two are already reflected in the order of the table
+    std::shared_ptr<SipTransport> p ;
+    mapKey2SelectionTable::const_iterator itTable = m_mapSelectionTables.find(requestedProto + (wantsIpV6 ? "/6" : "/4")) ;
+    if (m_mapSelectionTables.end() != itTable) {
+      struct in_addr addr ;
+      bool isIpV4 = !wantsIpV6 && 1 == inet_pton(AF_INET, host.c_str(), &addr) ;
+      uint32_t ip = isIpV4 ? ntohl(addr.s_addr) : 0 ;
+
+      int bestScore = -1 ;
+      for (const SelectionEntry_t& entry : itTable->second) {
+        int score = 0 ;
+        if (isIpV4) {
+          if (entry.netmask && (ip & entry.netmask) == (entry.range & entry.netmask)) score = 8 ;
+          else if (entry.addr) {
+            uint32_t diff = ip ^ entry.addr ;
+            while (score < 4 && 0 == (diff & 0xff000000)) {
+              score++ ;
+              diff <<= 8 ;
+            }
+          }
+        }
+        if (score > bestScore) {
+          bestScore = score ;
+          p = entry.transport ;
+        }
       }
-
-      uint32_t a = pA->getOctetMatchCount(host);
-      uint32_t b = pB->getOctetMatchCount(host);
-      if (a > b) return true;
-      if (a < b) return false;
-
-      if (pA->hasExternalIp()) return true;
-      if (pB->hasExternalIp()) return false;
-
-      if (pA->isLocalhost()) return false;
-      if (pB->isLocalhost()) return true;
-
-      return true;
-    });
-
-#ifdef DEBUG 
-    DR_LOG(log_debug) <<  "SipTransport::findAppropriateTransport - in priority order, here are the candidates for sending to  " << host;
-    BOOST_FOREACH(std::shared_ptr<SipTransport>& p, candidates) {
-      string desc;
-      p->getDescription(desc);
-      DR_LOG(log_debug) << "SipTransport::findAppropriateTransport -   " << desc;
     }
-#endif
 
-    if (candidates.empty() && m_masterTransport->hasTportAndTpname()) {
+    if (!p && m_masterTransport && m_masterTransport->hasTportAndTpname()) {
       m_masterTransport->getDescription(desc) ;
       DR_LOG(log_debug) << "SipTransport::findAppropriateTransport: - returning master transport " << hex << m_masterTransport->getTport() << 
         " as we found no better matches: " << desc ;
-      return m_masterTransport ;      
+      p = m_masterTransport ;
     }
-    else if (candidates.empty()) {
+    else if (!p) {
       DR_LOG(log_info) << "SipTransport::findAppropriateTransport: - no transports found ";
       return nullptr;
     }
+    else {
+      p->getDescription(desc);
+      DR_LOG(log_debug) << "SipTransport::findAppropriateTransport: - returning the best match " << hex << p->getTport() << ": " << desc ;
+    }
 
-    std::shared_ptr<SipTransport> p = candidates[0];
-    p->getDescription(desc);
-    DR_LOG(log_debug) << "SipTransport::findAppropriateTransport: - returning the best match " << hex << p->getTport() << ": " << desc ;
+    m_selectionLru.emplace_front(key, p) ;
+    m_mapSelectionCache[key] = m_selectionLru.begin() ;
+    if (m_selectionLru.size() > TRANSPORT_SELECTION_CACHE_SIZE) {
+      m_mapSelectionCache.erase(m_selectionLru.back().first) ;
+      m_selectionLru.pop_back() ;
+    }
     return p ;
   }
 
@@ -564,20 +652,9 @@ namespace drachtio {
      return p->isLocal(szHost); 
     }
 
-    // search all
-    for (mapTport2SipTransport::const_iterator it = m_mapTport2SipTransport.begin(); m_mapTport2SipTransport.end() != it; ++it ) {
-      std::shared_ptr<SipTransport> p = it->second ;
-      if( p->isLocal(szHost) ) {
-        return true ;
-      }
-      for( vector<string>::const_iterator itDns = p->getDnsNames().begin(); itDns != p->getDnsNames().end(); ++itDns ) {
-        if( 0 == (*itDns).compare(szHost) ) {
-          return true;
-        }
-      }
-    }
-
-    return false;
+    std::shared_ptr<const LocalAddresses_t> addresses = std::atomic_load(&m_localAddresses) ;
+    string key ;
+    return addresses && localAddressKey(szHost, key) && addresses->end() != addresses->find(key) ;
   }
 
   void SipTransport::logTransports() {
@@ -23,6 +23,10 @@ THE SOFTWARE.
 #define __SIP_TRANSPORTS_HPP__
 
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <list>
+#include <mutex>
 
 #include <sofia-sip/nta.h>
 #include <sofia-sip/nta_tport.h>
@@ -95,11 +99,39 @@ namespace drachtio {
   protected:
     void init() ;
 
+    static void buildSelectionTables() ;
+    static void buildLocalAddresses() ;
+    static bool localAddressKey(const char* szHost, string& key) ;
+
     typedef std::unordered_map<tport_t*, std::shared_ptr<SipTransport> > mapTport2SipTransport ;
 
     static mapTport2SipTransport m_mapTport2SipTransport ;
     static std::shared_ptr<SipTransport> m_masterTransport ;
 
+    // transports to choose from in findAppropriateTransport, keyed by protocol and address family ("udp/4", "tcp/6", 
+    // and "/4", "/6" for any protocol); each table is in order of preference before looking at the destination
+    struct SelectionEntry_t {
+      std::shared_ptr<SipTransport> transport ;
+      uint32_t addr ;       // ipv4 address the transport is bound to, host byte order, or 0
+      uint32_t range ;
+      uint32_t netmask ;
+    } ;
+    typedef std::vector<SelectionEntry_t> SelectionTable_t ;
+    typedef std::unordered_map<string, SelectionTable_t> mapKey2SelectionTable ;
+    static mapKey2SelectionTable m_mapSelectionTables ;
+
+    // most recently selected transports, keyed by requested protocol and destination
+    typedef std::list< pair<string, std::shared_ptr<SipTransport> > > SelectionLru_t ;
+    typedef std::unordered_map<string, SelectionLru_t::iterator> mapDest2Selection ;
+    static SelectionLru_t m_selectionLru ;
+    static mapDest2Selection m_mapSelectionCache ;
+    static std::mutex m_selectionLock ;
+
+    // every host, address and dns name we answer to; addresses are held in binary form so that any textual
+    // representation matches. Replaced, never modified, whenever transports are added
+    typedef std::unordered_set<string> LocalAddresses_t ;
+    static std::shared_ptr<const LocalAddresses_t> m_localAddresses ;
+
     // these are loaded from config
     string  m_strContact ;
     string  m_strExternalIp ;
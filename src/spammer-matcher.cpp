@@ -0,0 +1,141 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "spammer-matcher.hpp"
+
+namespace drachtio {
+
+  void AhoCorasick::clear(void) {
+    std::array<int32_t, 256> root;
+    root.fill(-1);
+    m_delta.assign(1, root);
+    m_match.assign(1, 0);
+    m_patterns = 0;
+  }
+
+  void AhoCorasick::add(const std::string& pattern) {
+    // an empty pattern marks the root, so like strstr it matches any value that is present
+    int32_t state = 0;
+    for (unsigned char c : pattern) {
+      if (-1 == m_delta[state][c]) {
+        std::array<int32_t, 256> node;
+        node.fill(-1);
+        m_delta.push_back(node);
+        m_match.push_back(0);
+        m_delta[state][c] = m_delta.size() - 1;
+      }
+      state = m_delta[state][c];
+    }
+    m_match[state] = 1;
+    m_patterns++;
+  }
+
+  void AhoCorasick::compile(void) {
+    std::vector<int32_t> fail(m_delta.size(), 0);
+    std::vector<int32_t> queue;
+    queue.reserve(m_delta.size());
+
+    for (int c = 0; c < 256; c++) {
+      int32_t s = m_delta[0][c];
+      if (-1 == s) m_delta[0][c] = 0;
+      else {
+        fail[s] = 0;
+        queue.push_back(s);
+      }
+    }
+
+    // breadth-first, so a node's failure state is always complete before the node itself
+    for (size_t i = 0; i < queue.size(); i++) {
+      int32_t s = queue[i];
+      m_match[s] |= m_match[fail[s]];
+      for (int c = 0; c < 256; c++) {
+        int32_t t = m_delta[s][c];
+        if (-1 == t) m_delta[s][c] = m_delta[fail[s]][c];
+        else {
+          fail[t] = m_delta[fail[s]][c];
+          queue.push_back(t);
+        }
+      }
+    }
+  }
+
+  bool AhoCorasick::search(const char* text) const {
+    if (empty() || !text) return false;
+
+    int32_t state = 0;
+    if (m_match[state]) return true;
+    for (const unsigned char* p = reinterpret_cast<const unsigned char*>(text); *p; p++) {
+      state = m_delta[state][*p];
+      if (m_match[state]) return true;
+    }
+    return false;
+  }
+
+  bool SpammerMatcher::add(const std::string& header, const std::vector<std::string>& patterns) {
+    Header_t hdr;
+    if (0 == header.compare("user-agent")) hdr = hdr_user_agent;
+    else if (0 == header.compare("to")) hdr = hdr_to;
+    else if (0 == header.compare("from")) hdr = hdr_from;
+    else if (0 == header.compare("contact")) hdr = hdr_contact;
+    else if (0 == header.compare("via")) hdr = hdr_via;
+    else return false;
+
+    for (const auto& pattern : patterns) m_automata[hdr].add(pattern);
+    return true;
+  }
+
+  void SpammerMatcher::compile(void) {
+    m_empty = true;
+    for (auto& automaton : m_automata) {
+      automaton.compile();
+      if (!automaton.empty()) m_empty = false;
+    }
+  }
+
+  /**
+   * User-Agent is checked against the full header value, To/From/Contact against the user part 
+   * of the uri, and Via against the sent-by host of each Via header
+   */
+  const char* SpammerMatcher::match(const sip_t* sip) const {
+    if (m_empty) return NULL;
+
+    if (sip->sip_user_agent && m_automata[hdr_user_agent].search(sip->sip_user_agent->g_string)) {
+      return sip->sip_user_agent->g_string;
+    }
+    if (sip->sip_to && m_automata[hdr_to].search(sip->sip_to->a_url->url_user)) {
+      return sip->sip_to->a_url->url_user;
+    }
+    if (sip->sip_from && m_automata[hdr_from].search(sip->sip_from->a_url->url_user)) {
+      return sip->sip_from->a_url->url_user;
+    }
+    if (!m_automata[hdr_contact].empty()) {
+      for (const sip_contact_t* m = sip->sip_contact; m; m = m->m_next) {
+        if (m_automata[hdr_contact].search(m->m_url->url_user)) return m->m_url->url_user;
+      }
+    }
+    if (!m_automata[hdr_via].empty()) {
+      for (const sip_via_t* v = sip->sip_via; v; v = v->v_next) {
+        if (m_automata[hdr_via].search(v->v_host)) return v->v_host;
+      }
+    }
+    return NULL;
+  }
+}
@@ -0,0 +1,86 @@
+/*
+Copyright (c) 2024, FirstFive8, Inc
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPAMMER_MATCHER_HPP__
+#define __SPAMMER_MATCHER_HPP__
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <sofia-sip/sip.h>
+
+namespace drachtio {
+
+  /**
+   * Aho-Corasick automaton over a set of substrings.  All transitions are resolved
+   * when compiled, so a search is a single pass over the text with one table lookup per byte.
+   */
+  class AhoCorasick {
+  public:
+    AhoCorasick() { clear(); }
+
+    void clear(void);
+    void add(const std::string& pattern);
+    void compile(void);
+
+    bool empty(void) const { return 0 == m_patterns; }
+    bool search(const char* text) const;
+
+  private:
+    std::vector< std::array<int32_t, 256> > m_delta;
+    std::vector<uint8_t> m_match;
+    unsigned int m_patterns;
+  };
+
+  /**
+   * spammer patterns compiled per header; built once when the config is loaded (or reloaded on SIGHUP)
+   */
+  class SpammerMatcher {
+  public:
+    enum Header_t {
+      hdr_user_agent = 0,
+      hdr_to,
+      hdr_from,
+      hdr_contact,
+      hdr_via,
+      hdr_count
+    };
+
+    SpammerMatcher() : m_empty(true) {}
+
+    /* returns false if we don't know how to check the named header */
+    bool add(const std::string& header, const std::vector<std::string>& patterns);
+    void compile(void);
+
+    bool empty(void) const { return m_empty; }
+
+    /* returns the header value that matched, or NULL if the message is clean */
+    const char* match(const sip_t* sip) const;
+
+  private:
+    std::array<AhoCorasick, hdr_count> m_automata;
+    bool m_empty;
+  };
+}
+
+#endif
@@ -1,5 +1,10 @@
 #include <assert.h>
 #include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 #include "stats-collector.hpp"
 #include "drachtio.h"
@@ -10,6 +15,8 @@
 #include <prometheus/detail/ckms_quantiles.h>
 #include <prometheus/counter.h>
 #include <prometheus/histogram.h>
+#include <prometheus/collectable.h>
+#include <prometheus/metric_family.h>
 
 using namespace prometheus;
 
@@ -18,6 +25,162 @@ namespace drachtio {
   //using BucketBoundaries = std::vector<double>;
   //typedef std::vector<double> BucketBoundaries ;
 
+  /**
+   * The sip request/response counters are kept in per-thread shards, so the threads that
+   * bump them never write to a shared cache line; the shards are summed when prometheus scrapes.
+   * A shard only allocates rows of counters for the (counter, method, status class) combinations 
+   * its thread actually sees, and is folded into a retired total and freed when its thread exits.
+   */
+  class SipCounterCollector : public Collectable {
+  public:
+    // extension methods (sip_method_unknown) and out-of-range status codes are kept in a locked map instead
+    static const int SIP_METHOD_SLOTS = sip_method_publish + 1;
+    static const int SIP_CLASS_SLOTS = 7;  // class 0 is for requests, then 1xx - 6xx
+    static const int SIP_ROW_SLOTS = 100;
+    static const int SIP_SHARD_ROWS = StatsCollector::SIP_COUNTER_COUNT * SIP_METHOD_SLOTS * SIP_CLASS_SLOTS;
+
+    typedef std::array<std::atomic<uint64_t>, SIP_ROW_SLOTS> Row_t;
+
+    class Shard_t {
+    public:
+      Shard_t() {
+        for (auto& r : rows) r.store(nullptr, std::memory_order_relaxed);
+      }
+      ~Shard_t() {
+        for (auto& r : rows) delete r.load(std::memory_order_relaxed);
+      }
+      Row_t* getRow(int idx) {
+        Row_t* row = rows[idx].load(std::memory_order_relaxed);
+        if (!row) {
+          row = new Row_t();
+          for (auto& c : *row) c.store(0, std::memory_order_relaxed);
+          rows[idx].store(row, std::memory_order_release);
+        }
+        return row;
+      }
+      std::array<std::atomic<Row_t*>, SIP_SHARD_ROWS> rows;
+    };
+    typedef std::map< std::pair<string, int>, uint64_t > mapOther_t;
+
+    SipCounterCollector() {}
+
+    void add(StatsCollector::SipCounter_t which, const string& name, const char* desc) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_names[which] = name;
+      m_help[which] = desc;
+    }
+
+    void increment(StatsCollector::SipCounter_t which, sip_method_t method, const char* methodName, int status) {
+      if (method > sip_method_unknown && method < SIP_METHOD_SLOTS && (0 == status || (status >= 100 && status < 700))) {
+        // only the owning thread writes to its shard, so a relaxed load and store is enough
+        Row_t* row = getShard()->getRow(rowIndex(which, method, status / 100));
+        std::atomic<uint64_t>& c = (*row)[status % 100];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+      }
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_other[which][std::make_pair(string(methodName ? methodName : ""), status)]++;
+    }
+
+    std::vector<MetricFamily> Collect() const override {
+      std::vector<MetricFamily> families;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (int which = 0; which < StatsCollector::SIP_COUNTER_COUNT; which++) {
+        if (m_names[which].empty()) continue;
+
+        MetricFamily family;
+        family.name = m_names[which];
+        family.help = m_help[which];
+        family.type = MetricType::Counter;
+        for (int method = sip_method_unknown + 1; method < SIP_METHOD_SLOTS; method++) {
+          const char* methodName = sip_method_name(static_cast<sip_method_t>(method), "");
+          for (int cls = 0; cls < SIP_CLASS_SLOTS; cls++) {
+            int idx = rowIndex(which, method, cls);
+            std::array<uint64_t, SIP_ROW_SLOTS> sums;
+            sums.fill(0);
+            bool seen = sumRow(m_retired, idx, sums);
+            for (const auto& shard : m_shards) seen = sumRow(*shard, idx, sums) || seen;
+            if (!seen) continue;
+            for (int i = 0; i < SIP_ROW_SLOTS; i++) {
+              if (sums[i]) family.metric.push_back(makeMetric(methodName, cls * 100 + i, sums[i]));
+            }
+          }
+        }
+        for (const auto& kv : m_other[which]) {
+          family.metric.push_back(makeMetric(kv.first.first.c_str(), kv.first.second, kv.second));
+        }
+        families.push_back(std::move(family));
+      }
+      return families;
+    }
+
+  private:
+    class ShardOwner_t {
+    public:
+      ShardOwner_t() : collector(nullptr), shard(nullptr) {}
+      ~ShardOwner_t() {
+        if (shard) collector->retire(shard);
+      }
+      SipCounterCollector* collector;
+      Shard_t* shard;
+    };
+
+    static int rowIndex(int which, int method, int cls) {
+      return (which * SIP_METHOD_SLOTS + method) * SIP_CLASS_SLOTS + cls;
+    }
+
+    /* adds a shard's row into sums; returns false if the shard has never touched that row */
+    static bool sumRow(const Shard_t& shard, int idx, std::array<uint64_t, SIP_ROW_SLOTS>& sums) {
+      const Row_t* row = shard.rows[idx].load(std::memory_order_acquire);
+      if (!row) return false;
+      for (int i = 0; i < SIP_ROW_SLOTS; i++) sums[i] += (*row)[i].load(std::memory_order_relaxed);
+      return true;
+    }
+
+    Shard_t* getShard(void) {
+      // the collector lives for the life of the process, so it is still there when threads exit
+      static thread_local ShardOwner_t owner;
+      if (!owner.shard) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        owner.collector = this;
+        owner.shard = new Shard_t();
+        m_shards.push_back(owner.shard);
+      }
+      return owner.shard;
+    }
+
+    // counts from exited threads are kept so that counters never go backwards
+    void retire(Shard_t* shard) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (int idx = 0; idx < SIP_SHARD_ROWS; idx++) {
+        const Row_t* row = shard->rows[idx].load(std::memory_order_acquire);
+        if (!row) continue;
+        Row_t* retired = m_retired.getRow(idx);
+        for (int i = 0; i < SIP_ROW_SLOTS; i++) {
+          (*retired)[i].store((*retired)[i].load(std::memory_order_relaxed) + (*row)[i].load(std::memory_order_relaxed), 
+            std::memory_order_relaxed);
+        }
+      }
+      m_shards.erase(std::remove(m_shards.begin(), m_shards.end(), shard), m_shards.end());
+      delete shard;
+    }
+
+    static ClientMetric makeMetric(const char* methodName, int status, uint64_t value) {
+      ClientMetric metric;
+      metric.label.push_back(ClientMetric::Label{"method", methodName});
+      if (status) metric.label.push_back(ClientMetric::Label{"code", std::to_string(status)});
+      metric.counter.value = static_cast<double>(value);
+      return metric;
+    }
+
+    mutable std::mutex m_mutex;
+    std::array<string, StatsCollector::SIP_COUNTER_COUNT> m_names;
+    std::array<string, StatsCollector::SIP_COUNTER_COUNT> m_help;
+    std::vector<Shard_t*> m_shards;
+    Shard_t m_retired;
+    std::array<mapOther_t, StatsCollector::SIP_COUNTER_COUNT> m_other;
+  };
+
   class StatsCollector::PromImpl {
   public:
     using Quantiles = std::vector<prometheus::detail::CKMSQuantiles::Quantile>;
@@ -36,7 +199,9 @@ namespace drachtio {
     PromImpl() = delete;
     PromImpl(const char* szHostport) : m_exposer(szHostport) {
       m_registry = std::make_shared<Registry>();
+      m_sipCounters = std::make_shared<SipCounterCollector>();
       m_exposer.RegisterCollectable(m_registry);
+      m_exposer.RegisterCollectable(m_sipCounters);
     }
     ~PromImpl() {}
 
@@ -63,6 +228,14 @@ namespace drachtio {
       }
     }
 
+    void buildSipCounter(SipCounter_t which, const string& name, const char* desc) {
+      m_sipCounters->add(which, name, desc);
+    }
+
+    void sipCounterIncrement(SipCounter_t which, sip_method_t method, const char* methodName, int status) {
+      m_sipCounters->increment(which, method, methodName, status);
+    }
+
     void buildGauge(const string& name, const char* desc) {
       auto& m = BuildGauge()
         .Name(name)
@@ -136,13 +309,13 @@ namespace drachtio {
 
   
   private:
-
     Exposer m_exposer;
     std::shared_ptr<Registry> m_registry;
 
     mapCounter_t  m_mapCounter;
     mapGauge_t  m_mapGauge;
     mapHistogram_t  m_mapHistogram;
+    std::shared_ptr<SipCounterCollector> m_sipCounters;
   };
 
   StatsCollector::StatsCollector() : m_pimpl(nullptr) {
@@ -169,6 +342,13 @@ namespace drachtio {
     if (nullptr != m_pimpl) m_pimpl->counterIncrement(name, val, labels); 
   }
 
+  void StatsCollector::sipCounterCreate(SipCounter_t which, const string& name, const char* desc) {
+    if (nullptr != m_pimpl) m_pimpl->buildSipCounter(which, name, desc);
+  }
+  void StatsCollector::sipCounterIncrement(SipCounter_t which, sip_method_t method, const char* methodName, int status) {
+    if (nullptr != m_pimpl) m_pimpl->sipCounterIncrement(which, method, methodName, status);
+  }
+
   // gauges
   void StatsCollector::gaugeCreate(const string& name, const char* desc) {
     if (nullptr != m_pimpl) m_pimpl->buildGauge(name, desc);    
@@ -26,6 +26,8 @@ THE SOFTWARE.
 #include <map>
 #include <vector>
 
+#include <sofia-sip/sip.h>
+
 using std::string ;
 
 namespace drachtio {
@@ -42,6 +44,15 @@ namespace drachtio {
       SUMMARY
     };
 
+    // the sip request/response counters, which are bumped for nearly every message
+    enum SipCounter_t {
+      SIP_REQUESTS_IN = 0,
+      SIP_REQUESTS_OUT,
+      SIP_RESPONSES_IN,
+      SIP_RESPONSES_OUT,
+      SIP_COUNTER_COUNT
+    };
+
     //static std::shared_ptr<Cdr> postCdr( std::shared_ptr<Cdr> cdr, const string& encodedMsg = "" ) ;
 
     StatsCollector( const StatsCollector& ) = delete;
@@ -57,6 +68,10 @@ namespace drachtio {
     void counterIncrement(const string& name, mapLabels_t labels = {});
     void counterIncrement(const string& name, double val, mapLabels_t labels = {});
 
+    // sip counters are labeled by method and, for responses, status code; counts are kept per-thread and summed at scrape time
+    void sipCounterCreate(SipCounter_t which, const string& name, const char* desc);
+    void sipCounterIncrement(SipCounter_t which, sip_method_t method, const char* methodName, int status = 0);
+
     // gauges
     void gaugeCreate(const string& name, const char* desc);
     void gaugeIncrement(const string& name, mapLabels_t labels = {});
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "app-frame.hpp"
+
+using std::cout ;
+using std::endl ;
+using std::string ;
+using namespace drachtio ;
+
+/*
+ * checks the binary app protocol frame parser against partial headers, oversize lengths
+ * and frames that arrive split across several reads
+ *
+ * usage: test_app_frame
+ */
+
+namespace {
+  int failures = 0 ;
+
+  void check( bool ok, const char* what ) {
+    if( !ok ) {
+      cout << "FAIL: " << what << endl ;
+      failures++ ;
+    }
+  }
+
+  string makeFrame( const string& sip, const string& msgId ) {
+    AppFrame frame( AppFrame::MSG_REQUEST ) ;
+    frame.add( AppFrame::FIELD_MSG_ID, msgId ) ;
+    frame.add( AppFrame::FIELD_TOKEN, string("sip") ) ;
+    frame.add( AppFrame::FIELD_PORT, static_cast<uint64_t>(5060) ) ;
+    frame.add( AppFrame::FIELD_SIP, sip ) ;
+    string data ;
+    frame.encode( data ) ;
+    return data ;
+  }
+
+  // a header with the given payload length and no payload
+  string makeHeader( uint64_t payloadLen ) {
+    string data ;
+    data.push_back( static_cast<char>(AppFrame::MAGIC) ) ;
+    data.push_back( static_cast<char>(AppFrame::VERSION) ) ;
+    data.push_back( static_cast<char>(AppFrame::MSG_SIP) ) ;
+    AppFrame::appendVarint( data, payloadLen ) ;
+    return data ;
+  }
+
+  void testRoundTrip() {
+    // the sip message carries bytes the text protocol would have had to escape
+    string sip = "INVITE sip:alice@example.com SIP/2.0\r\nSubject: a|b\r\n\r\n" ;
+    sip.push_back( '\0' ) ;
+    string data = makeFrame( sip, "1234" ) ;
+
+    AppFrame frame ;
+    size_t frameLen = 0 ;
+    check( AppFrame::PARSE_OK == AppFrame::parse( data.data(), data.length(), frame, frameLen ), "round trip parses" ) ;
+    check( data.length() == frameLen, "round trip consumes the whole frame" ) ;
+    check( AppFrame::MSG_REQUEST == frame.getType(), "round trip keeps the message type" ) ;
+
+    string value ;
+    uint64_t port = 0 ;
+    check( frame.get( AppFrame::FIELD_MSG_ID, value ) && "1234" == value, "round trip keeps the msg id" ) ;
+    check( frame.get( AppFrame::FIELD_SIP, value ) && sip == value, "round trip keeps the sip message byte for byte" ) ;
+    check( frame.get( AppFrame::FIELD_PORT, port ) && 5060 == port, "round trip keeps varint fields" ) ;
+  }
+
+  void testPartialHeader() {
+    string data = makeFrame( string(300, 'x'), "1" ) ;
+    AppFrame frame ;
+    size_t frameLen = 0 ;
+
+    // magic, version and type, then a two byte payload length cut after its first byte
+    for( size_t len = 0; len < 5; len++ ) {
+      check( AppFrame::PARSE_INCOMPLETE == AppFrame::parse( data.data(), len, frame, frameLen ), "partial header is incomplete" ) ;
+    }
+
+    string bad = data ;
+    bad[0] = 'x' ;
+    check( AppFrame::PARSE_ERROR == AppFrame::parse( bad.data(), bad.length(), frame, frameLen ), "bad magic is an error" ) ;
+
+    bad = data ;
+    bad[2] = 9 ;
+    check( AppFrame::PARSE_ERROR == AppFrame::parse( bad.data(), bad.length(), frame, frameLen ), "unknown message type is an error" ) ;
+
+    // a varint that never ends
+    string endless = makeHeader( 0 ).substr( 0, 3 ) + string( 10, '\xff' ) ;
+    check( AppFrame::PARSE_ERROR == AppFrame::parse( endless.data(), endless.length(), frame, frameLen ), "overlong varint is an error" ) ;
+  }
+
+  void testOversize() {
+    AppFrame frame ;
+    size_t frameLen = 0 ;
+
+    string atCap = makeHeader( AppFrame::MAX_PAYLOAD_LEN ) ;
+    check( AppFrame::PARSE_INCOMPLETE == AppFrame::parse( atCap.data(), atCap.length(), frame, frameLen ), "payload at the cap waits for more data" ) ;
+
+    string overCap = makeHeader( AppFrame::MAX_PAYLOAD_LEN + 1 ) ;
+    check( AppFrame::PARSE_ERROR == AppFrame::parse( overCap.data(), overCap.length(), frame, frameLen ), "payload over the cap is an error" ) ;
+
+    string huge = makeHeader( UINT64_MAX ) ;
+    check( AppFrame::PARSE_ERROR == AppFrame::parse( huge.data(), huge.length(), frame, frameLen ), "payload length that would wrap is an error" ) ;
+
+    // a field claiming more bytes than the frame holds
+    string data = makeHeader( 3 ) ;
+    data.push_back( static_cast<char>(AppFrame::FIELD_SIP) ) ;
+    data.push_back( 100 ) ;
+    data.push_back( 'x' ) ;
+    check( AppFrame::PARSE_ERROR == AppFrame::parse( data.data(), data.length(), frame, frameLen ), "field longer than its frame is an error" ) ;
+  }
+
+  // feeds the frames to the parser in reads of the given size, the way Client::read_handler accumulates them
+  void testSplitReads( size_t readSize ) {
+    string sip(2000, 'y') ;
+    string stream = makeFrame( sip, "1" ) + makeFrame( sip, "2" ) + makeFrame( "", "3" ) ;
+
+    string buffer ;
+    std::vector<string> ids ;
+    for( size_t offset = 0; offset < stream.length(); offset += readSize ) {
+      buffer.append( stream, offset, readSize ) ;
+
+      for(;;) {
+        AppFrame frame ;
+        size_t frameLen = 0 ;
+        AppFrame::ParseResult_t rc = AppFrame::parse( buffer.data(), buffer.length(), frame, frameLen ) ;
+        if( AppFrame::PARSE_INCOMPLETE == rc ) break ;
+        if( AppFrame::PARSE_ERROR == rc ) {
+          check( false, "split frames parse without error" ) ;
+          return ;
+        }
+        string id, value ;
+        frame.get( AppFrame::FIELD_MSG_ID, id ) ;
+        frame.get( AppFrame::FIELD_SIP, value ) ;
+        check( value == ( "3" == id ? string() : sip ), "split frames keep their sip message" ) ;
+        ids.push_back( id ) ;
+        buffer.erase( 0, frameLen ) ;
+      }
+    }
+    check( 3 == ids.size() && "1" == ids[0] && "2" == ids[1] && "3" == ids[2], "split frames all arrive, in order" ) ;
+    check( buffer.empty(), "split frames leave nothing behind" ) ;
+  }
+}
+
+int main( int argc, char **argv) {
+  testRoundTrip() ;
+  testPartialHeader() ;
+  testOversize() ;
+  testSplitReads( 1 ) ;
+  testSplitReads( 7 ) ;
+  testSplitReads( 1500 ) ;
+  testSplitReads( 65536 ) ;
+
+  if( failures ) {
+    cout << failures << " checks failed" << endl ;
+    return 1 ;
+  }
+  cout << "all checks passed" << endl ;
+  return 0 ;
+}
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+#include <jansson.h>
+
+using std::cout ;
+using std::endl ;
+
+namespace drachtio {
+  void* my_json_malloc( size_t bytes ) ;
+  void my_json_free( void* ptr ) ;
+}
+
+/*
+ * parses typical http routing responses on multiple threads with jansson using
+ * - the default allocator
+ * - the previous allocator hooks (global mutex, 8-byte header, memset on free)
+ * - the current allocator hooks (atomic counters)
+ *
+ * usage: test_json_alloc [max-threads] [parses-per-thread]
+ */
+
+namespace {
+  const char* payloads[] = {
+    "{\"action\": \"route\", \"data\": {\"uri\": \"sip:+15083084809@10.10.100.1:5060;transport=udp\"}}",
+    "{\"action\": \"reject\", \"data\": {\"status\": 403, \"reason\": \"Forbidden\"}}",
+    "{\"action\": \"redirect\", \"data\": {\"contacts\": [\"sip:alice@192.168.1.10\", \"sip:alice@192.168.1.11\"]}}",
+    "{\"action\": \"route\", \"data\": {\"tag\": \"conference-app\"}}",
+    "{\"action\": \"proxy\", \"data\": {\"destination\": [\"sip:10.10.100.2\", \"sip:10.10.100.3\"], \"recordRoute\": true, \"followRedirects\": false}}"
+  } ;
+  const unsigned int nPayloads = sizeof(payloads) / sizeof(payloads[0]) ;
+
+  std::mutex oldLock ;
+
+  void* old_json_malloc( size_t bytes ) {
+    std::lock_guard<std::mutex> l( oldLock ) ;
+    void *ptr = malloc( bytes + 8 ) ;
+    *((size_t *)ptr) = bytes ;
+    return (void*) ((char*) ptr + 8);
+  }
+
+  void old_json_free( void* ptr ) {
+    std::lock_guard<std::mutex> l( oldLock ) ;
+    ptr = (void *) ((char *) ptr - 8) ;
+    size_t size = *((size_t *)ptr);
+    memset( ptr, 0, size + 8 ) ;
+    free( ptr ) ;
+  }
+}
+
+double run(unsigned int nThreads, unsigned int count) {
+  std::vector<std::thread> threads ;
+  auto start = std::chrono::steady_clock::now() ;
+  for (unsigned int i = 0; i < nThreads; i++) {
+    threads.emplace_back([count]() {
+      json_error_t error ;
+      for (unsigned int j = 0; j < count; j++) {
+        const char* p = payloads[j % nPayloads] ;
+        json_t* root = json_loadb(p, strlen(p), 0, &error) ;
+        if (!root || !json_is_string(json_object_get(root, "action"))) abort() ;
+        json_decref(root) ;
+      }
+    }) ;
+  }
+  for (auto& t : threads) t.join() ;
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start ;
+  return (nThreads * (double) count) / elapsed.count() / 1e3 ;
+}
+
+int main( int argc, char **argv) {
+  unsigned int maxThreads = argc > 1 ? ::atoi(argv[1]) : 8 ;
+  unsigned int count = argc > 2 ? ::atoi(argv[2]) : 200000 ;
+
+  cout << "threads\tdefault (K parses/s)\tmutex hooks (K parses/s)\tatomic hooks (K parses/s)" << endl ;
+  for (unsigned int n = 1; n <= maxThreads; n *= 2) {
+    json_set_alloc_funcs(malloc, free) ;
+    double a = run(n, count) ;
+    json_set_alloc_funcs(old_json_malloc, old_json_free) ;
+    double b = run(n, count) ;
+    json_set_alloc_funcs(drachtio::my_json_malloc, drachtio::my_json_free) ;
+    double c = run(n, count) ;
+    cout << n << "\t" << a << "\t\t\t" << b << "\t\t\t\t" << c << endl ;
+  }
+
+  return 0 ;
+}
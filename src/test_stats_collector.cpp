@@ -0,0 +1,58 @@
+#include <stdlib.h>
+#include <string>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+#include <prometheus/registry.h>
+#include <prometheus/counter.h>
+
+#include "stats-collector.hpp"
+
+using std::cout ;
+using std::endl ;
+using namespace drachtio ;
+
+/*
+ * compares multi-threaded increments of a single shared prometheus counter 
+ * with the per-thread sip counter shards in StatsCollector
+ *
+ * usage: test_stats_collector [max-threads] [increments-per-thread]
+ */
+
+template<typename F>
+double run(unsigned int nThreads, unsigned int count, F f) {
+  std::vector<std::thread> threads ;
+  auto start = std::chrono::steady_clock::now() ;
+  for (unsigned int i = 0; i < nThreads; i++) {
+    threads.emplace_back([count, &f]() {
+      for (unsigned int j = 0; j < count; j++) f() ;
+    }) ;
+  }
+  for (auto& t : threads) t.join() ;
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start ;
+  return (nThreads * (double) count) / elapsed.count() / 1e6 ;
+}
+
+int main( int argc, char **argv) {
+  unsigned int maxThreads = argc > 1 ? ::atoi(argv[1]) : 8 ;
+  unsigned int count = argc > 2 ? ::atoi(argv[2]) : 5000000 ;
+
+  auto registry = std::make_shared<prometheus::Registry>() ;
+  auto& family = prometheus::BuildCounter().Name("shared_counter").Help("shared counter").Register(*registry) ;
+  prometheus::Counter& shared = family.Add({{"method", "INVITE"}}) ;
+
+  StatsCollector stats ;
+  stats.enablePrometheus("127.0.0.1:9099") ;
+  stats.sipCounterCreate(StatsCollector::SIP_REQUESTS_IN, "drachtio_sip_requests_in_total", "count of sip requests received") ;
+
+  cout << "threads\tshared counter (M incr/s)\tsharded counter (M incr/s)" << endl ;
+  for (unsigned int n = 1; n <= maxThreads; n *= 2) {
+    double a = run(n, count, [&shared]() { shared.Increment() ; }) ;
+    double b = run(n, count, [&stats]() { stats.sipCounterIncrement(StatsCollector::SIP_REQUESTS_IN, sip_method_invite, "INVITE") ; }) ;
+    cout << n << "\t" << a << "\t\t\t\t" << b << endl ;
+  }
+
+  return 0 ;
+}
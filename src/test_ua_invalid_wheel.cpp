@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#define DRACHTIO_MAIN
+#include "ua-invalid.hpp"
+
+using std::cout ;
+using std::endl ;
+using namespace drachtio ;
+
+/*
+ * checks the expiry wheel for .invalid registrations against refreshes, removals from the middle
+ * of a slot, registrations longer than a turn of the wheel and gaps longer than a turn between advances
+ *
+ * usage: test_ua_invalid_wheel
+ */
+
+namespace {
+  int failures = 0 ;
+
+  void check( bool ok, const char* what ) {
+    if( !ok ) {
+      cout << "FAIL: " << what << endl ;
+      failures++ ;
+    }
+  }
+
+  bool contains( const std::vector<UaInvalidData*>& due, const UaInvalidData* p ) {
+    return due.end() != std::find( due.begin(), due.end(), p ) ;
+  }
+
+  void testRefresh() {
+    UaInvalidExpiryWheel wheel ;
+    time_t start = time(0) ;
+    UaInvalidData ua( 10, nullptr ) ;
+    wheel.schedule( &ua ) ;
+
+    ua.extendExpires( 100 ) ;
+    wheel.schedule( &ua ) ;
+    check( 1 == wheel.size(), "refresh does not add a second entry" ) ;
+
+    std::vector<UaInvalidData*> due ;
+    wheel.advance( start + 20, due ) ;
+    check( due.empty() && 1 == wheel.size(), "refreshed entry is not due at its old expiry" ) ;
+
+    wheel.advance( start + 105, due ) ;
+    check( 1 == due.size() && contains( due, &ua ), "refreshed entry is due at its new expiry" ) ;
+    check( 0 == wheel.size(), "due entry leaves the wheel" ) ;
+  }
+
+  void testUnscheduleMiddle() {
+    UaInvalidExpiryWheel wheel ;
+    time_t start = time(0) ;
+    UaInvalidData a( 30, nullptr ), b( 30, nullptr ), c( 30, nullptr ), d( 30, nullptr ) ;
+    wheel.schedule( &a ) ;
+    wheel.schedule( &b ) ;
+    wheel.schedule( &c ) ;
+
+    // c is moved into b's place; d then takes the position c used to have
+    wheel.unschedule( &b ) ;
+    check( 2 == wheel.size(), "unschedule from the middle of a slot removes one entry" ) ;
+    wheel.schedule( &d ) ;
+
+    // only works if c's index was fixed up when it was moved
+    wheel.unschedule( &c ) ;
+    check( 2 == wheel.size(), "unschedule of the entry moved into its place" ) ;
+    wheel.unschedule( &c ) ;
+    check( 2 == wheel.size(), "unschedule of an entry not in the wheel does nothing" ) ;
+
+    std::vector<UaInvalidData*> due ;
+    wheel.advance( start + 35, due ) ;
+    check( 2 == due.size() && contains( due, &a ) && contains( due, &d ), "only the remaining entries come due" ) ;
+  }
+
+  void testLongerThanATurn() {
+    UaInvalidExpiryWheel wheel ;
+    time_t start = time(0) ;
+    UaInvalidData ua( 5000, nullptr ) ;
+    wheel.schedule( &ua ) ;
+
+    // visit every slot once per second, all the way around the wheel
+    std::vector<UaInvalidData*> due ;
+    for( time_t t = start + 1; t <= start + 3700; t++ ) wheel.advance( t, due ) ;
+    check( due.empty() && 1 == wheel.size(), "entry more than a turn ahead survives the turn" ) ;
+
+    wheel.advance( start + 5005, due ) ;
+    check( 1 == due.size() && contains( due, &ua ), "entry more than a turn ahead comes due on a later turn" ) ;
+  }
+
+  void testGap() {
+    UaInvalidExpiryWheel wheel ;
+    time_t start = time(0) ;
+    UaInvalidData a( 10, nullptr ), b( 10, nullptr ), c( 2000, nullptr ), d( 3000, nullptr ), e( 9000, nullptr ) ;
+    wheel.schedule( &a ) ;
+    wheel.schedule( &b ) ;
+    wheel.schedule( &c ) ;
+    wheel.schedule( &d ) ;
+    wheel.schedule( &e ) ;
+
+    // nothing advanced the wheel for well over a turn
+    std::vector<UaInvalidData*> due ;
+    wheel.advance( start + 8000, due ) ;
+    check( 4 == due.size() && contains( due, &a ) && contains( due, &b ) && contains( due, &c ) && contains( due, &d ),
+      "advance after a gap longer than a turn finds everything that expired" ) ;
+    check( 1 == wheel.size() && !contains( due, &e ), "advance after a gap keeps what has not expired" ) ;
+
+    // an entry that is already due when scheduled goes in the next slot to be visited
+    UaInvalidData f( -5, nullptr ) ;
+    wheel.schedule( &f ) ;
+    due.clear() ;
+    wheel.advance( start + 8001, due ) ;
+    check( 1 == due.size() && contains( due, &f ), "entry scheduled after a gap, already due, comes due on the next advance" ) ;
+
+    due.clear() ;
+    wheel.advance( start + 9005, due ) ;
+    check( 1 == due.size() && contains( due, &e ) && 0 == wheel.size(), "remaining entry comes due after the gap" ) ;
+  }
+}
+
+int main( int argc, char **argv) {
+  testRefresh() ;
+  testUnscheduleMiddle() ;
+  testLongerThanATurn() ;
+  testGap() ;
+
+  if( failures ) {
+    cout << failures << " checks failed" << endl ;
+    return 1 ;
+  }
+  cout << "all checks passed" << endl ;
+  return 0 ;
+}
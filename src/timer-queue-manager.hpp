@@ -28,11 +28,13 @@ THE SOFTWARE.
 
 namespace drachtio {
 
+  class WatchdogSnapshot_t ;
+
   class TimerQueueManager {
   public:
     virtual TimerEventHandle addTimer( const char* szTimerClass, TimerFunc f, void* functionArgs, uint32_t milliseconds ) = 0 ;
     virtual void removeTimer( TimerEventHandle handle, const char* szTimer ) = 0 ;
-    virtual void logQueueSizes(void) {}
+    virtual void snapshotQueueSizes(WatchdogSnapshot_t& snapshot) {}
   } ;
 
   class SipTimerQueueManager : public TimerQueueManager {
@@ -69,7 +71,7 @@ namespace drachtio {
         else if( 0 == strcmp("timerK", szTimerClass) ) m_queueK.remove( handle ) ;
         else m_queue.remove( handle ) ;
     }
-    void logQueueSizes(void) ;
+    void snapshotQueueSizes(WatchdogSnapshot_t& snapshot) ;
 
   protected:
     TimerQueue      m_queue ;
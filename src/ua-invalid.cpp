@@ -22,24 +22,71 @@ THE SOFTWARE.
 #include "ua-invalid.hpp"
 #include "controller.hpp"
 
+#define EXPIRY_WHEEL_SLOTS (3600)
+
 namespace drachtio {
 
     void UaInvalidData::setTport(tport_t* tp) {
       if (tp == m_tp) return ;
-      string uri;
-      getUri(uri);
 
-      DR_LOG(log_info) << "UaInvalidData::setTport " << uri << " unref old tport " << (void *)m_tp << " ref new tport " << (void *)tp  ;
+      DR_LOG(log_info) << "UaInvalidData::setTport " << (m_uri ? *m_uri : "") << " unref old tport " << (void *)m_tp << " ref new tport " << (void *)tp  ;
       tport_unref(m_tp) ;
       m_tp = tp;
       tport_ref(m_tp) ;
     }
 
-    void UaInvalidData::extendExpires(int expires) {
-      string uri;
-      getUri(uri);
+    UaInvalidExpiryWheel::UaInvalidExpiryWheel() : m_slots(EXPIRY_WHEEL_SLOTS), m_lastAdvanced(time(0)), m_count(0) {
+    }
+
+    void UaInvalidExpiryWheel::schedule(UaInvalidData* p) {
+      if (-1 != p->m_slot) unschedule(p) ;
+
+      // anything already due goes in the next slot to be visited
+      time_t t = std::max(p->m_expires, m_lastAdvanced + 1) ;
+      std::vector<UaInvalidData*>& slot = m_slots[t % EXPIRY_WHEEL_SLOTS] ;
+      p->m_slot = t % EXPIRY_WHEEL_SLOTS ;
+      p->m_slotIndex = slot.size() ;
+      slot.push_back(p) ;
+      m_count++ ;
+    }
+
+    void UaInvalidExpiryWheel::unschedule(UaInvalidData* p) {
+      if (-1 == p->m_slot) return ;
+      removeAt(m_slots[p->m_slot], p->m_slotIndex) ;
+    }
+
+    void UaInvalidExpiryWheel::removeAt(std::vector<UaInvalidData*>& slot, size_t index) {
+      UaInvalidData* p = slot[index] ;
+      p->m_slot = -1 ;
+      if (index != slot.size() - 1) {
+        slot[index] = slot.back() ;
+        slot[index]->m_slotIndex = index ;
+      }
+      slot.pop_back() ;
+      m_count-- ;
+    }
+
+    void UaInvalidExpiryWheel::advance(time_t now, std::vector<UaInvalidData*>& due) {
+      // entries expire once their time is strictly in the past, see UaInvalidData::isExpired
+      time_t last = now - 1 ;
+      if (last <= m_lastAdvanced) return ;
+
+      // after a long gap each slot only needs to be visited once
+      time_t first = std::max(m_lastAdvanced + 1, last - EXPIRY_WHEEL_SLOTS + 1) ;
+      for (time_t t = first; t <= last; t++) {
+        std::vector<UaInvalidData*>& slot = m_slots[t % EXPIRY_WHEEL_SLOTS] ;
 
-      DR_LOG(log_info) << "UaInvalidData::extendExpires " << uri << " by " << expires << "secs" ;
-      m_expires = time(0) + expires ;
+        // entries for later turns of the wheel stay where they are
+        for (size_t i = 0; i < slot.size(); ) {
+          if (slot[i]->m_expires < now) {
+            due.push_back(slot[i]) ;
+            removeAt(slot, i) ;
+          }
+          else {
+            i++ ;
+          }
+        }
+      }
+      m_lastAdvanced = last ;
     }
  }
@@ -2,6 +2,8 @@
 #define __UA_INVALID_DATA_HPP__
 
 #include <algorithm>
+#include <vector>
+#include <string>
 
 #include <time.h>
 
@@ -14,55 +16,83 @@
 
 namespace drachtio {
 
+  class UaInvalidExpiryWheel ;
+
+  /**
+   * The transport a client that registered with a .invalid contact can be reached on.  These are kept 
+   * in a map keyed by "user@host", which is the only copy of the uri; the entry just points at its key.
+   */
   class UaInvalidData {
     public: 
-      UaInvalidData(const char* szUser, const char* szHost, int expires, tport_t* tp ) : m_tp(tp) {
-        memset(m_szUser, 0, URI_LEN);
-        memset(m_szHost, 0, URI_LEN);
-        if (szUser) memcpy( m_szUser, szUser, std::min(URI_LEN - 1, (int) strlen(szUser))) ;
-        if (szHost) memcpy( m_szHost, szHost, std::min(URI_LEN - 1, (int) strlen(szHost))) ;
-        time(&m_expires) ;
-        m_expires += expires ;
+      UaInvalidData(int expires, tport_t* tp ) : m_tp(tp), m_expires(time(0) + expires), m_uri(nullptr), 
+        m_slot(-1), m_slotIndex(0) {
         tport_ref(m_tp) ;
-
       }
       ~UaInvalidData() {
         tport_unref(m_tp) ;
       }
-      UaInvalidData& operator=( const UaInvalidData& ua ) {
-        memset(m_szUser, 0, URI_LEN);
-        memset(m_szHost, 0, URI_LEN);
-        if (::strlen(ua.m_szUser)) strcpy(m_szUser, ua.m_szUser) ;
-        strcpy(m_szHost, ua.m_szHost) ;
-        m_expires = ua.m_expires ;
-        tport_ref(m_tp) ;   
-        return *this ;       
+      UaInvalidData( const UaInvalidData& ) = delete ;
+      UaInvalidData& operator=( const UaInvalidData& ) = delete ;
+
+      static void makeUri( const char* user, const char* host, string& uri ) {
+        uri.clear() ;
+        if (user && *user) {
+          uri.append( user ) ;
+          uri.push_back( '@' ) ;
+        }
+        if (host) uri.append( host ) ;
       }
 
+      /* points at the key of the map entry holding us, or null once removed from the map */
+      void setUri( const string* uri ) { m_uri = uri; }
       void getUri( string& uri ) {
-        uri = "" ;
-        if (::strlen(m_szUser)) {
-          uri.append( m_szUser ) ;
-          uri.append( "@" ) ;
-        }
-        uri.append( m_szHost ) ;
+        if (m_uri) uri = *m_uri ;
+        else uri.clear() ;
       }
       tport_t* getTport(void) { return m_tp; }
       void setTport(tport_t* tp);
       bool isExpired(void) {
         return m_expires < time(0) ;
       }
-      void extendExpires(int expires) ;
+      time_t getExpires(void) const { return m_expires; }
+      void extendExpires(int expires) { m_expires = time(0) + expires; }
+
     private:
-      // not allowed
-      UaInvalidData() {}
+      friend class UaInvalidExpiryWheel ;
 
-      char m_szUser[URI_LEN] ;
-      char m_szHost[URI_LEN] ;
-      time_t m_expires ;
       tport_t* m_tp ;
+      time_t m_expires ;
+      const string* m_uri ;
+
+      // position in the expiry wheel
+      int m_slot ;
+      size_t m_slotIndex ;
   } ;
 
+  /**
+   * Finds the registrations that have expired without visiting all of them: each one is put in 
+   * the slot for the second it expires in, and advancing the wheel only looks at the slots whose 
+   * time has come.  Each entry knows its own position, so a refresh or removal is constant time.
+   */
+  class UaInvalidExpiryWheel {
+    public:
+      UaInvalidExpiryWheel() ;
+
+      void schedule(UaInvalidData* p) ;
+      void unschedule(UaInvalidData* p) ;
+
+      /* removes and hands back the entries that expired before now */
+      void advance(time_t now, std::vector<UaInvalidData*>& due) ;
+
+      size_t size(void) const { return m_count; }
+
+    private:
+      void removeAt(std::vector<UaInvalidData*>& slot, size_t index) ;
+
+      std::vector< std::vector<UaInvalidData*> > m_slots ;
+      time_t m_lastAdvanced ;
+      size_t m_count ;
+  } ;
 }
 
 #endif
\ No newline at end of file
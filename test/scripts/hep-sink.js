@@ -0,0 +1,109 @@
+const Emitter = require('events');
+const dgram = require('dgram');
+const crypto = require('crypto');
+const assert = require('assert');
+const debug = require('debug')('drachtio:server-test');
+
+const HEP_CHUNK_SRC_PORT = 0x0007;
+const HEP_CHUNK_AGENT_ID = 0x000c;
+const HEP_CHUNK_PAYLOAD = 0x000f;
+const HEP_CHUNK_CORRELATION_ID = 0x0011;
+
+/* splits a HEPv3 packet into its chunks, keyed by chunk type */
+function parseHep(buf) {
+  assert.strictEqual(buf.toString('ascii', 0, 4), 'HEP3', 'HEP3 magic');
+  assert.strictEqual(buf.readUInt16BE(4), buf.length, 'HEP3 total length');
+  const chunks = {};
+  let pos = 6;
+  while (pos < buf.length) {
+    const type = buf.readUInt16BE(pos + 2);
+    const len = buf.readUInt16BE(pos + 4);
+    assert(len >= 6 && pos + len <= buf.length, 'HEP3 chunk length');
+    chunks[type] = buf.slice(pos + 6, pos + len);
+    pos += len;
+  }
+  return chunks;
+}
+
+/**
+ * Local udp sink standing in for a Homer server.  Sends sip straight to the server
+ * and checks that the HEPv3 copy relayed by the server carries the message exactly as it went over the wire.
+ */
+class HepSink extends Emitter {
+  connect(port) {
+    this.sink = dgram.createSocket('udp4');
+    this.sip = dgram.createSocket('udp4');
+    this.sink.on('message', (msg) => this.emit('hep', msg));
+    return Promise.all([
+      new Promise((resolve) => this.sink.bind(port || 9060, '127.0.0.1', resolve)),
+      new Promise((resolve) => this.sip.bind(0, '127.0.0.1', resolve))
+    ]);
+  }
+
+  disconnect() {
+    this.sink.close();
+    this.sip.close();
+  }
+
+  /**
+   * an OPTIONS answered by the options-responder, with a folded header and one of these bodies:
+   * - (default) indented text lines, the last one with no crlf
+   * - 'bare-lf': text lines ending in a bare LF
+   * - 'binary': bytes including NULs, as with ISUP on SIP-I trunks
+   */
+  expectVerbatimCapture(target, opts = {}) {
+    const [host, port] = (target || '127.0.0.1:5090').split(':');
+    const localPort = this.sip.address().port;
+    const callId = `${crypto.randomBytes(8).toString('hex')}@hep-sink`;
+    let body = Buffer.from('  indented first line\r\n\tsecond line after a tab\r\nlast line, no crlf');
+    let contentType = 'text/plain';
+    if (opts.body === 'bare-lf') body = Buffer.from('first line\nsecond line\n');
+    else if (opts.body === 'binary') {
+      body = Buffer.from([0x01, 0x00, 0x49, 0x00, 0x0a, 0x03, 0x02, 0x00, 0x0d, 0x0a, 0xff, 0x00]);
+      contentType = 'application/isup';
+    }
+    const request = Buffer.concat([Buffer.from([
+      `OPTIONS sip:carrier-ping@${host}:${port} SIP/2.0`,
+      `Via: SIP/2.0/UDP 127.0.0.1:${localPort};branch=z9hG4bK${crypto.randomBytes(6).toString('hex')}`,
+      `From: <sip:hep-sink@127.0.0.1:${localPort}>;tag=${crypto.randomBytes(4).toString('hex')}`,
+      `To: <sip:carrier-ping@${host}:${port}>`,
+      `Call-ID: ${callId}`,
+      'CSeq: 1 OPTIONS',
+      'Max-Forwards: 70',
+      'Subject: a subject',
+      '   folded onto a second line',
+      `Content-Type: ${contentType}`,
+      `Content-Length: ${body.length}`,
+      '',
+      ''
+    ].join('\r\n')), body]);
+
+    return new Promise((resolve, reject) => {
+      const timer = setTimeout(() => reject(new Error('no HEP capture of the request received')), 5000);
+      const onHep = (msg) => {
+        try {
+          const chunks = parseHep(msg);
+          if (!chunks[HEP_CHUNK_PAYLOAD] || !chunks[HEP_CHUNK_SRC_PORT]) return;
+          if (chunks[HEP_CHUNK_SRC_PORT].readUInt16BE(0) !== localPort) return;
+          debug(`received HEP capture of ${chunks[HEP_CHUNK_PAYLOAD].length} bytes`);
+
+          assert.strictEqual(chunks[HEP_CHUNK_AGENT_ID].readUInt32BE(0), 101, 'agent id');
+          assert.strictEqual(chunks[HEP_CHUNK_CORRELATION_ID].toString(), callId, 'correlation id');
+          assert(chunks[HEP_CHUNK_PAYLOAD].equals(request), 'payload is the request byte for byte');
+
+          clearTimeout(timer);
+          this.removeListener('hep', onHep);
+          resolve();
+        } catch (err) {
+          clearTimeout(timer);
+          this.removeListener('hep', onHep);
+          reject(err);
+        }
+      };
+      this.on('hep', onHep);
+      this.sip.send(request, parseInt(port), host);
+    });
+  }
+}
+
+module.exports = HepSink;